@@ -0,0 +1,827 @@
+// Analysis phase of the interpreter: checks the syntax of each form once and
+// turns it into a tree of Nodes, resolving every local variable to a slot in
+// its frame, so that evaluation never has to look at the source again.
+
+#include <string.h>
+#include "analyzer.h"
+#include "value.h"
+#include "linkedlist.h"
+#include "talloc.h"
+
+// flags of a variable under analysis
+#define CAPTURED 1
+#define ASSIGNED 2
+
+// The variables of a frame under analysis, in slot order, with their flags.
+// owner is the lambda or let node the frame is for; lambda is set if it is
+// the frame of a procedure, whose closure captures the variables of outer
+// scopes that it uses.
+typedef struct Scope {
+    Value **names;
+    char *flags;
+    int count;
+    int capacity;
+    Node *owner;
+    Node *lambda;
+    int freeCapacity;
+    struct Scope *parent;
+} Scope;
+
+// A local or free variable node and the slot it refers to; whether the
+// variable is boxed is only known once the whole form has been analyzed.
+typedef struct Reference {
+    Node *node;
+    Scope *scope;
+    int index;
+} Reference;
+
+Reference *references;
+int referenceCount;
+int referenceCapacity;
+
+// every scope of the form under analysis
+Scope **scopes;
+int scopeCount;
+int scopeCapacity;
+
+Node *analyzeExpr(Value *expr, Scope *scope);
+
+// returns a new node of the given kind
+Node *makeNode(nodeKind kind) {
+    Node *node = talloc(sizeof(Node));
+    node->kind = kind;
+    return node;
+}
+
+// returns a node that reports error code i when evaluated
+Node *makeError(int i) {
+    Node *node = makeNode(ERROR_NODE);
+    node->error = i;
+    return node;
+}
+
+// returns a node that evaluates to value
+Node *makeConst(Value *value) {
+    Node *node = makeNode(CONST_NODE);
+    node->value = value;
+    return node;
+}
+
+// returns array, of count elements of the given size, with room for one
+// more element, copying it into a larger array if it is full
+void *growArray(void *array, int count, int *capacity, size_t size) {
+    if (count < *capacity) {
+        return array;
+    }
+    *capacity = *capacity ? 2 * *capacity : 8;
+    void *larger = talloc(*capacity * size);
+    if (count > 0) {
+        memcpy(larger, array, count * size);
+    }
+    return larger;
+}
+
+// creates an empty scope for a new frame, nested in parent
+Scope *makeScope(Scope *parent) {
+    Scope *scope = talloc(sizeof(Scope));
+    scope->names = NULL;
+    scope->flags = NULL;
+    scope->count = 0;
+    scope->capacity = 0;
+    scope->owner = NULL;
+    scope->lambda = NULL;
+    scope->freeCapacity = 0;
+    scope->parent = parent;
+    scopes = growArray(scopes, scopeCount, &scopeCapacity, sizeof(Scope *));
+    scopes[scopeCount] = scope;
+    scopeCount++;
+    return scope;
+}
+
+// gives symbol the next slot of the scope and returns its index
+int appendName(Scope *scope, Value *symbol) {
+    if (scope->count == scope->capacity) {
+        int capacity = scope->capacity ? 2 * scope->capacity : 4;
+        Value **names = talloc(capacity * sizeof(Value *));
+        char *flags = talloc(capacity);
+        for (int i = 0; i < scope->count; i++) {
+            names[i] = scope->names[i];
+            flags[i] = scope->flags[i];
+        }
+        scope->names = names;
+        scope->flags = flags;
+        scope->capacity = capacity;
+    }
+    scope->names[scope->count] = symbol;
+    scope->flags[scope->count] = 0;
+    scope->count++;
+    return scope->count - 1;
+}
+
+// returns the slot of symbol in this scope alone, or -1; later slots shadow
+// earlier ones with the same name, and slots without a name yet are skipped
+int findName(Scope *scope, Value *symbol) {
+    for (int i = scope->count - 1; i >= 0; i--) {
+        if (scope->names[i] && !strcmp(scope->names[i]->s, symbol->s)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// returns the slot of symbol in the scope, adding it if it is not there yet
+int addName(Scope *scope, Value *symbol) {
+    int index = findName(scope, symbol);
+    if (index < 0) {
+        index = appendName(scope, symbol);
+    }
+    return index;
+}
+
+// gives a slot to every variable that a define will bind in the frame of
+// scope when forms run, so that references anywhere in the frame resolve to
+// it; lambda, let* and letrec bodies run in frames of their own
+void scanDefines(Value *forms, Scope *scope) {
+    while (forms->type == CONS_TYPE) {
+        Value *form = car(forms);
+        if (form->type == CONS_TYPE && car(form)->type == SYMBOL_TYPE) {
+            char *name = car(form)->s;
+            if (!strcmp(name, "let")) {
+                // only the inits of a let are evaluated in this frame
+                if (cdr(form)->type == CONS_TYPE) {
+                    scanDefines(car(cdr(form)), scope);
+                }
+            }
+            else if (strcmp(name, "quote") && strcmp(name, "lambda") &&
+                     strcmp(name, "let*") && strcmp(name, "letrec") &&
+                     strcmp(name, "guard") && strcmp(name, "delay") &&
+                     strcmp(name, "delay-force") &&
+                     strcmp(name, "cons-stream")) {
+                if (!strcmp(name, "define") && cdr(form)->type == CONS_TYPE &&
+                    car(cdr(form))->type == SYMBOL_TYPE) {
+                    addName(scope, car(cdr(form)));
+                }
+                scanDefines(cdr(form), scope);
+            }
+        }
+        else if (form->type == CONS_TYPE) {
+            scanDefines(form, scope);
+        }
+        forms = cdr(forms);
+    }
+}
+
+// returns the scope, at or around scope, whose frame holds the variable
+// symbol, setting *index to its slot; NULL if it is global
+Scope *findScope(Value *symbol, Scope *scope, int *index) {
+    for (; scope != NULL; scope = scope->parent) {
+        *index = findName(scope, symbol);
+        if (*index >= 0) {
+            return scope;
+        }
+    }
+    return NULL;
+}
+
+// returns a new variable node of the given kind, referring to the variable
+// in slot index of scope
+Node *makeVariable(nodeKind kind, Value *symbol, Scope *scope, int index) {
+    Node *node = makeNode(kind);
+    node->var.symbol = symbol;
+    node->var.depth = 0;
+    node->var.index = index;
+    node->var.boxed = 0;
+    node->var.binding = NULL;
+    if (scope != NULL) {
+        references = growArray(references, referenceCount,
+                               &referenceCapacity, sizeof(Reference));
+        references[referenceCount].node = node;
+        references[referenceCount].scope = scope;
+        references[referenceCount].index = index;
+        referenceCount++;
+    }
+    return node;
+}
+
+Node *analyzeVariable(Value *symbol, Scope *scope);
+
+// resolves a variable that is free in the lambda whose frame scope is: its
+// closure captures the variable from the frame the lambda is evaluated in
+Node *analyzeFree(Value *symbol, Scope *scope) {
+    int index;
+    Scope *home = findScope(symbol, scope->parent, &index);
+    if (home == NULL) {
+        return makeVariable(GLOBAL_NODE, symbol, NULL, 0);
+    }
+    home->flags[index] |= CAPTURED;
+    Node *lambda = scope->lambda;
+    int free = 0;
+    while (free < lambda->lambda.freeCount &&
+           strcmp(lambda->lambda.freeVars[free]->var.symbol->s, symbol->s)) {
+        free++;
+    }
+    if (free == lambda->lambda.freeCount) {
+        Node *source = analyzeVariable(symbol, scope->parent);
+        lambda->lambda.freeVars = growArray(lambda->lambda.freeVars, free,
+                                            &scope->freeCapacity,
+                                            sizeof(Node *));
+        lambda->lambda.freeVars[free] = source;
+        lambda->lambda.freeCount++;
+    }
+    Node *node = makeVariable(FREE_NODE, symbol, home, index);
+    node->var.index = free;
+    return node;
+}
+
+// resolves a variable reference to a slot of a frame of the current
+// procedure, to a variable its closure captured, or to the global frame if
+// no enclosing scope binds it
+Node *analyzeVariable(Value *symbol, Scope *scope) {
+    int depth = 0;
+    for (; scope != NULL; scope = scope->parent) {
+        int index = findName(scope, symbol);
+        if (index >= 0) {
+            Node *node = makeVariable(LOCAL_NODE, symbol, scope, index);
+            node->var.depth = depth;
+            return node;
+        }
+        if (scope->lambda != NULL) {
+            return analyzeFree(symbol, scope);
+        }
+        depth++;
+    }
+    return makeVariable(GLOBAL_NODE, symbol, NULL, 0);
+}
+
+// notes that the local variable symbol is assigned after being bound
+void markAssigned(Value *symbol, Scope *scope) {
+    int index;
+    scope = findScope(symbol, scope, &index);
+    if (scope != NULL) {
+        scope->flags[index] |= ASSIGNED;
+    }
+}
+
+// analyzes a list of expressions into a node that evaluates them in order
+Node *analyzeSequence(Value *exprs, Scope *scope, nodeKind kind) {
+    Node *node = makeNode(kind);
+    node->seq.count = length(exprs);
+    node->seq.exprs = talloc(node->seq.count * sizeof(Node *));
+    for (int i = 0; i < node->seq.count; i++) {
+        node->seq.exprs[i] = analyzeExpr(car(exprs), scope);
+        exprs = cdr(exprs);
+    }
+    return node;
+}
+
+// analyzes the body of a lambda, let or cond clause
+Node *analyzeBody(Value *exprs, Scope *scope) {
+    if (exprs->type == CONS_TYPE && cdr(exprs)->type == NULL_TYPE) {
+        return analyzeExpr(car(exprs), scope);
+    }
+    return analyzeSequence(exprs, scope, BEGIN_NODE);
+}
+
+Node *analyzeIf(Value *expr, Scope *scope) {
+    if (expr->type != CONS_TYPE) {
+        return makeError(148);
+    }
+    if (cdr(expr)->type != CONS_TYPE) {
+        return makeError(151);
+    }
+    if (cdr(cdr(expr))->type != CONS_TYPE) {
+        return makeError(150);
+    }
+    if (cdr(cdr(cdr(expr)))->type != NULL_TYPE) {
+        return makeError(149);
+    }
+    Node *node = makeNode(IF_NODE);
+    node->branch.test = analyzeExpr(car(expr), scope);
+    node->branch.conseq = analyzeExpr(car(cdr(expr)), scope);
+    node->branch.alt = analyzeExpr(car(cdr(cdr(expr))), scope);
+    return node;
+}
+
+// returns the error code for a malformed let binding, or 0 if it is a
+// proper (symbol expr) pair
+int checkBinding(Value *assign, int base) {
+    if (assign->type != CONS_TYPE) {
+        return base + 2;
+    }
+    else if (cdr(assign)->type != CONS_TYPE) {
+        return base + 3;
+    }
+    else if (cdr(cdr(assign))->type != NULL_TYPE) {
+        return base + 4;
+    }
+    else if (car(assign)->type != SYMBOL_TYPE) {
+        return base + 5;
+    }
+    return 0;
+}
+
+// returns whether symbol is already one of the first count variables of
+// scope
+int isBound(Value *symbol, Scope *scope, int count) {
+    for (int i = 0; i < count; i++) {
+        if (!strcmp(scope->names[i]->s, symbol->s)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// analyzes let (inits evaluated in the enclosing frame) and let* (inits
+// evaluated in turn in the new frame); a malformed binding still lets the
+// bindings before it be evaluated, as they were before the error is found
+Node *analyzeLet(Value *expr, Scope *scope, nodeKind kind) {
+    if (expr->type != CONS_TYPE || car(expr)->type != CONS_TYPE ||
+        cdr(expr)->type == NULL_TYPE) {
+        return makeError(159);
+    }
+    // the bindings take the first slots, each named only once its init has
+    // been analyzed
+    Scope *newScope = makeScope(scope);
+    int count = length(car(expr));
+    for (int i = 0; i < count; i++) {
+        appendName(newScope, NULL);
+    }
+    if (kind == LETSTAR_NODE) {
+        scanDefines(car(expr), newScope);
+    }
+
+    Node *node = makeNode(kind);
+    newScope->owner = node;
+    node->let.count = 0;
+    node->let.inits = talloc(count * sizeof(Node *));
+    Value *assignList = car(expr);
+    while (assignList->type != NULL_TYPE) {
+        Value *assign = car(assignList);
+        int error = checkBinding(assign, 159);
+        if (!error && isBound(car(assign), newScope, node->let.count)) {
+            error = 165;
+        }
+        if (error) {
+            node->let.body = makeError(error);
+            node->let.frameSize = newScope->count;
+            return node;
+        }
+        Scope *initScope = kind == LET_NODE ? scope : newScope;
+        node->let.inits[node->let.count] = analyzeExpr(car(cdr(assign)),
+                                                       initScope);
+        newScope->names[node->let.count] = car(assign);
+        node->let.count++;
+        assignList = cdr(assignList);
+    }
+    scanDefines(cdr(expr), newScope);
+    node->let.body = analyzeBody(cdr(expr), newScope);
+    node->let.frameSize = newScope->count;
+    return node;
+}
+
+Node *analyzeLetrec(Value *expr, Scope *scope) {
+    if (expr->type != CONS_TYPE || car(expr)->type != CONS_TYPE ||
+        cdr(expr)->type == NULL_TYPE) {
+        return makeError(152);
+    }
+    Scope *newScope = makeScope(scope);
+    Value *assignList = car(expr);
+    while (assignList->type != NULL_TYPE) {
+        Value *assign = car(assignList);
+        int error = checkBinding(assign, 152);
+        if (!error && isBound(car(assign), newScope, newScope->count)) {
+            error = 158;
+        }
+        if (error) {
+            return makeError(error);
+        }
+        // closures made by the inits capture the variables before they are
+        // initialized
+        int index = appendName(newScope, car(assign));
+        newScope->flags[index] |= ASSIGNED;
+        assignList = cdr(assignList);
+    }
+    scanDefines(car(expr), newScope);
+    scanDefines(cdr(expr), newScope);
+
+    Node *node = makeNode(LETREC_NODE);
+    newScope->owner = node;
+    node->let.count = length(car(expr));
+    node->let.inits = talloc(node->let.count * sizeof(Node *));
+    assignList = car(expr);
+    for (int i = 0; i < node->let.count; i++) {
+        node->let.inits[i] = analyzeExpr(car(cdr(car(assignList))), newScope);
+        assignList = cdr(assignList);
+    }
+    node->let.body = analyzeBody(cdr(expr), newScope);
+    node->let.frameSize = newScope->count;
+    return node;
+}
+
+Node *analyzeQuote(Value *expr) {
+    if (expr->type != CONS_TYPE || cdr(expr)->type != NULL_TYPE) {
+        return makeError(166);
+    }
+    if (car(expr)->type == CONS_TYPE && car(car(expr))->type == NULL_TYPE) {
+        return makeConst(car(car(expr)));
+    }
+    return makeConst(car(expr));
+}
+
+Node *analyzeDefine(Value *expr, Scope *scope) {
+    if (length(expr) != 2) {
+        return makeError(167);
+    }
+    if (car(expr)->type != SYMBOL_TYPE) {
+        return makeError(169);
+    }
+    Node *node = makeNode(DEFINE_NODE);
+    if (scope == NULL) {
+        node->assign.var = analyzeVariable(car(expr), NULL);
+    }
+    else {
+        int index = addName(scope, car(expr));
+        scope->flags[index] |= ASSIGNED;
+        node->assign.var = makeVariable(LOCAL_NODE, car(expr), scope, index);
+    }
+    node->assign.expr = analyzeExpr(car(cdr(expr)), scope);
+    return node;
+}
+
+Node *analyzeSetBang(Value *expr, Scope *scope) {
+    if (length(expr) != 2) {
+        return makeError(170);
+    }
+    if (car(expr)->type != SYMBOL_TYPE) {
+        return makeError(172);
+    }
+    Node *node = makeNode(SET_NODE);
+    node->assign.var = analyzeVariable(car(expr), scope);
+    markAssigned(car(expr), scope);
+    node->assign.expr = analyzeExpr(car(cdr(expr)), scope);
+    return node;
+}
+
+Node *analyzeLambda(Value *expr, Scope *scope) {
+    if (expr->type != CONS_TYPE) {
+        return makeError(174);
+    }
+    Scope *newScope = makeScope(scope);
+    Value *current = car(expr);
+    if (current->type == CONS_TYPE && car(current)->type == NULL_TYPE) {
+        current = cdr(current);
+    }
+    while (current->type == CONS_TYPE) {
+        if (car(current)->type != SYMBOL_TYPE) {
+            return makeError(174);
+        }
+        appendName(newScope, car(current));
+        current = cdr(current);
+    }
+    if (current->type != NULL_TYPE) {
+        return makeError(174);
+    }
+
+    Node *node = makeNode(LAMBDA_NODE);
+    node->lambda.paramCount = newScope->count;
+    node->lambda.freeCount = 0;
+    node->lambda.freeVars = NULL;
+    node->lambda.calls = 0;
+    node->lambda.native = NULL;
+    node->lambda.flonum = 0;
+    newScope->owner = node;
+    newScope->lambda = node;
+    scanDefines(cdr(expr), newScope);
+    if (cdr(expr)->type == NULL_TYPE) {
+        // a procedure without a body returns the empty list
+        node->lambda.body = makeConst(cdr(expr));
+    }
+    else {
+        node->lambda.body = analyzeBody(cdr(expr), newScope);
+    }
+    node->lambda.frameSize = newScope->count;
+    return node;
+}
+
+Node *analyzeCond(Value *expr, Scope *scope) {
+    Node *node = makeNode(COND_NODE);
+    node->cond.count = length(expr);
+    node->cond.tests = talloc(node->cond.count * sizeof(Node *));
+    node->cond.bodies = talloc(node->cond.count * sizeof(Node *));
+    for (int i = 0; i < node->cond.count; i++) {
+        Value *clause = car(expr);
+        int isElse = clause->type == CONS_TYPE &&
+                     car(clause)->type == SYMBOL_TYPE &&
+                     !strcmp(car(clause)->s, "else");
+        node->cond.bodies[i] = NULL;
+        if (length(clause) == 0) {
+            node->cond.tests[i] = makeError(181);
+        }
+        else if (cdr(clause)->type == NULL_TYPE) {
+            if (isElse) {
+                node->cond.tests[i] = makeError(182);
+            }
+            else {
+                node->cond.tests[i] = analyzeExpr(car(clause), scope);
+            }
+        }
+        else {
+            if (isElse) {
+                node->cond.tests[i] = NULL;
+            }
+            else {
+                node->cond.tests[i] = analyzeExpr(car(clause), scope);
+            }
+            node->cond.bodies[i] = analyzeBody(cdr(clause), scope);
+        }
+        expr = cdr(expr);
+    }
+    return node;
+}
+
+Node *analyzeCall(Value *expr, Scope *scope) {
+    Node *node = makeNode(CALL_NODE);
+    node->call.fn = analyzeExpr(car(expr), scope);
+    Value *args = cdr(expr);
+    node->call.argc = length(args);
+    node->call.args = talloc(node->call.argc * sizeof(Node *));
+    node->call.primitive = NULL;
+    node->call.deopts = 0;
+    for (int i = 0; i < node->call.argc; i++) {
+        node->call.args[i] = analyzeExpr(car(args), scope);
+        args = cdr(args);
+    }
+    return node;
+}
+
+// (guard (var clause ...) body ...) calls #guard with the body as a thunk
+// and the clauses as a procedure of var that re-raises the condition if none
+// of them applies
+Node *analyzeGuard(Value *expr, Scope *scope) {
+    if (length(expr) < 2 || car(expr)->type != CONS_TYPE ||
+        car(car(expr))->type != SYMBOL_TYPE) {
+        return makeError(190);
+    }
+    Value *var = car(car(expr));
+    Value *clauses = cdr(car(expr));
+    Value *last = NULL;
+    for (Value *c = clauses; c->type == CONS_TYPE; c = cdr(c)) {
+        last = car(c);
+    }
+    if (last == NULL || last->type != CONS_TYPE ||
+        car(last)->type != SYMBOL_TYPE || strcmp(car(last)->s, "else")) {
+        Value *reraise = cons(makeSymbol("#reraise"), cons(var, makeNull()));
+        Value *otherwise = cons(makeSymbol("else"), cons(reraise, makeNull()));
+        clauses = reverse(cons(otherwise, reverse(clauses)));
+    }
+    Value *body = cons(makeSymbol("lambda"), cons(makeNull(), cdr(expr)));
+    Value *handler = cons(makeSymbol("lambda"),
+                          cons(cons(var, makeNull()),
+                               cons(cons(makeSymbol("cond"), clauses),
+                                    makeNull())));
+    Value *call = cons(makeSymbol("#guard"),
+                       cons(body, cons(handler, makeNull())));
+    return analyzeCall(call, scope);
+}
+
+// (delay expr) and (delay-force expr) call maker, #delay or #delay-force,
+// with expr as a thunk
+Node *analyzeDelay(Value *expr, Scope *scope, char *maker) {
+    if (length(expr) != 1) {
+        return makeError(220);
+    }
+    Value *thunk = cons(makeSymbol("lambda"), cons(makeNull(), expr));
+    return analyzeCall(cons(makeSymbol(maker), cons(thunk, makeNull())),
+                       scope);
+}
+
+// (cons-stream a b) is (#cons a (delay b)), #cons being a name for cons that
+// a program cannot shadow or redefine
+Node *analyzeConsStream(Value *expr, Scope *scope) {
+    if (length(expr) != 2) {
+        return makeError(220);
+    }
+    Value *promise = cons(makeSymbol("delay"), cdr(expr));
+    Value *call = cons(makeSymbol("#cons"),
+                       cons(car(expr), cons(promise, makeNull())));
+    return analyzeCall(call, scope);
+}
+
+// analyzes an expression evaluated in the frame described by scope (NULL for
+// the global frame)
+Node *analyzeExpr(Value *expr, Scope *scope) {
+    switch (expr->type) {
+     case INT_TYPE:
+     case BIGNUM_TYPE:
+     case DOUBLE_TYPE:
+     case VECTOR_TYPE:
+     case CHAR_TYPE:
+     case BOOL_TYPE:
+     case STR_TYPE: {
+        return makeConst(expr);
+     }
+     case SYMBOL_TYPE: {
+        return analyzeVariable(expr, scope);
+     }
+     case CONS_TYPE: {
+        Value *first = car(expr);
+        Value *args = cdr(expr);
+
+        if (first->type == NULL_TYPE) {
+            return makeConst(expr);
+        }
+        else if (first->type != SYMBOL_TYPE && first->type != CONS_TYPE) {
+            return makeError(182);
+        }
+        else if (first->type == CONS_TYPE) {
+            return analyzeCall(expr, scope);
+        }
+        else if (!strcmp(first->s, "if")) {
+            return analyzeIf(args, scope);
+        }
+        else if (!strcmp(first->s, "let")) {
+            return analyzeLet(args, scope, LET_NODE);
+        }
+        else if (!strcmp(first->s, "let*")) {
+            return analyzeLet(args, scope, LETSTAR_NODE);
+        }
+        else if (!strcmp(first->s, "letrec")) {
+            return analyzeLetrec(args, scope);
+        }
+        else if (!strcmp(first->s, "quote")) {
+            return analyzeQuote(args);
+        }
+        else if (!strcmp(first->s, "define")) {
+            return analyzeDefine(args, scope);
+        }
+        else if (!strcmp(first->s, "lambda")) {
+            return analyzeLambda(args, scope);
+        }
+        else if (!strcmp(first->s, "and")) {
+            return analyzeSequence(args, scope, AND_NODE);
+        }
+        else if (!strcmp(first->s, "or")) {
+            return analyzeSequence(args, scope, OR_NODE);
+        }
+        else if (!strcmp(first->s, "cond")) {
+            return analyzeCond(args, scope);
+        }
+        else if (!strcmp(first->s, "set!")) {
+            return analyzeSetBang(args, scope);
+        }
+        else if (!strcmp(first->s, "begin")) {
+            return analyzeSequence(args, scope, BEGIN_NODE);
+        }
+        else if (!strcmp(first->s, "guard")) {
+            return analyzeGuard(args, scope);
+        }
+        else if (!strcmp(first->s, "delay")) {
+            return analyzeDelay(args, scope, "#delay");
+        }
+        else if (!strcmp(first->s, "delay-force")) {
+            return analyzeDelay(args, scope, "#delay-force");
+        }
+        else if (!strcmp(first->s, "cons-stream")) {
+            return analyzeConsStream(args, scope);
+        }
+        return analyzeCall(expr, scope);
+     }
+     default: {
+        return makeError(183);
+     }
+    }
+}
+
+// returns which slots of scope hold boxed variables, or NULL if none do
+char *boxedSlots(Scope *scope) {
+    char *boxed = NULL;
+    for (int i = 0; i < scope->count; i++) {
+        if (scope->flags[i] == (CAPTURED | ASSIGNED)) {
+            if (boxed == NULL) {
+                boxed = talloc(scope->count);
+                memset(boxed, 0, scope->count);
+            }
+            boxed[i] = 1;
+        }
+    }
+    return boxed;
+}
+
+// Checks the syntax of a top-level expression and returns the node that
+// evaluates it.
+Node *analyze(Value *expr) {
+    references = NULL;
+    referenceCount = 0;
+    referenceCapacity = 0;
+    scopes = NULL;
+    scopeCount = 0;
+    scopeCapacity = 0;
+    Node *node = analyzeExpr(expr, NULL);
+
+    // only now is it known which variables closures capture and assign
+    for (int i = 0; i < referenceCount; i++) {
+        Reference *ref = &references[i];
+        ref->node->var.boxed = ref->scope->flags[ref->index] ==
+                               (CAPTURED | ASSIGNED);
+    }
+    for (int i = 0; i < scopeCount; i++) {
+        Node *owner = scopes[i]->owner;
+        if (owner == NULL) {
+            continue;
+        }
+        if (owner->kind == LAMBDA_NODE) {
+            owner->lambda.boxed = boxedSlots(scopes[i]);
+        }
+        else {
+            owner->let.boxed = boxedSlots(scopes[i]);
+        }
+    }
+    return node;
+}
+
+// calls visit on each node directly nested in node, in evaluation order
+void visitChildren(Node *node, void (*visit)(Node *, void *), void *data) {
+    switch (node->kind) {
+     case DEFINE_NODE:
+     case SET_NODE: {
+        visit(node->assign.expr, data);
+        break;
+     }
+     case IF_NODE: {
+        visit(node->branch.test, data);
+        visit(node->branch.conseq, data);
+        visit(node->branch.alt, data);
+        break;
+     }
+     case LAMBDA_NODE: {
+        visit(node->lambda.body, data);
+        break;
+     }
+     case LET_NODE:
+     case LETSTAR_NODE:
+     case LETREC_NODE: {
+        for (int i = 0; i < node->let.count; i++) {
+            visit(node->let.inits[i], data);
+        }
+        visit(node->let.body, data);
+        break;
+     }
+     case BEGIN_NODE:
+     case AND_NODE:
+     case OR_NODE: {
+        for (int i = 0; i < node->seq.count; i++) {
+            visit(node->seq.exprs[i], data);
+        }
+        break;
+     }
+     case COND_NODE: {
+        for (int i = 0; i < node->cond.count; i++) {
+            if (node->cond.tests[i] != NULL) {
+                visit(node->cond.tests[i], data);
+            }
+            if (node->cond.bodies[i] != NULL) {
+                visit(node->cond.bodies[i], data);
+            }
+        }
+        break;
+     }
+     case CALL_NODE:
+     case FIXNUM_CALL_NODE:
+     case FLONUM_CALL_NODE:
+     case NUMERIC_CALL_NODE: {
+        visit(node->call.fn, data);
+        for (int i = 0; i < node->call.argc; i++) {
+            visit(node->call.args[i], data);
+        }
+        break;
+     }
+     default: {
+        break;
+     }
+    }
+}
+
+// Returns whether node is a call, specialized or not.
+int isCall(Node *node) {
+    return node->kind >= CALL_NODE && node->kind <= NUMERIC_CALL_NODE;
+}
+
+void addSlots(Node *node, void *data) {
+    int *count = data;
+    if (node->kind == LAMBDA_NODE) {
+        return;
+    }
+    if (node->kind == LET_NODE || node->kind == LETSTAR_NODE ||
+        node->kind == LETREC_NODE) {
+        *count += node->let.frameSize;
+    }
+    visitChildren(node, addSlots, data);
+}
+
+// returns the number of slots the lets of an expression need, not counting
+// those of nested lambdas
+int countSlots(Node *node) {
+    int count = 0;
+    addSlots(node, &count);
+    return count;
+}
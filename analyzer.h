@@ -0,0 +1,130 @@
+#include "value.h"
+
+#ifndef _ANALYZER
+#define _ANALYZER
+
+// The kinds of node produced by analyze(). Every special form is checked and
+// pre-digested once, so evaluating a node never re-examines its syntax.
+// The three kinds after CALL_NODE are calls of a two-argument arithmetic or
+// comparison primitive that the evaluator has specialized, after seeing
+// their operands, to fixnums only, flonums only, or any numbers.
+typedef enum {CONST_NODE,LOCAL_NODE,FREE_NODE,GLOBAL_NODE,DEFINE_NODE,
+              SET_NODE,IF_NODE,LAMBDA_NODE,LET_NODE,LETSTAR_NODE,LETREC_NODE,
+              BEGIN_NODE,AND_NODE,OR_NODE,COND_NODE,CALL_NODE,
+              FIXNUM_CALL_NODE,FLONUM_CALL_NODE,NUMERIC_CALL_NODE,
+              ERROR_NODE} nodeKind;
+
+// the primitives a call node can be specialized to
+typedef enum {ADD_OP,SUB_OP,MULT_OP,LESS_OP,GREATER_OP,LESS_EQ_OP,GR_EQ_OP,
+              EQUAL_OP} arithOp;
+
+typedef struct Node Node;
+
+struct Node {
+    nodeKind kind;
+    union {
+        // CONST_NODE: the value the expression evaluates to
+        Value *value;
+        // LOCAL_NODE: slot index of the variable in the frame depth levels
+        // up from the current one, within the current procedure
+        // FREE_NODE: index of the variable among those the closure of the
+        // current procedure captured
+        // GLOBAL_NODE: (symbol . value) pair of the global frame, looked up
+        // by symbol on first use and cached afterwards
+        // A local or free variable that a closure captures and that is
+        // assigned after being bound is boxed: its slot, and every closure
+        // capturing it, hold a shared BOX_TYPE value holding its value.
+        struct {
+            Value *symbol;
+            int depth;
+            int index;
+            int boxed;
+            Value *binding;
+        } var;
+        // DEFINE_NODE, SET_NODE: the variable assigned and its new value
+        struct {
+            Node *var;
+            Node *expr;
+        } assign;
+        // IF_NODE
+        struct {
+            Node *test;
+            Node *conseq;
+            Node *alt;
+        } branch;
+        // LAMBDA_NODE: frames of the procedure hold the parameters in their
+        // first slots, followed by the body's internal defines; boxed flags
+        // the boxed slots (NULL if there are none). A closure captures the
+        // values of the freeCount variables in freeVars, evaluated where the
+        // lambda is, leaving boxes unopened. calls and native are the JIT's
+        // call count and compiled code, and flonum is set once that code
+        // computes with flonums rather than fixnums (see jit.c)
+        struct {
+            int paramCount;
+            int frameSize;
+            char *boxed;
+            int freeCount;
+            Node **freeVars;
+            Node *body;
+            int calls;
+            void *native;
+            int flonum;
+        } lambda;
+        // LET_NODE, LETSTAR_NODE, LETREC_NODE: one init per binding, laid
+        // out like a procedure frame
+        struct {
+            int count;
+            Node **inits;
+            int frameSize;
+            char *boxed;
+            Node *body;
+        } let;
+        // BEGIN_NODE, AND_NODE, OR_NODE
+        struct {
+            int count;
+            Node **exprs;
+        } seq;
+        // COND_NODE: a test per clause (NULL for else) and the body to run
+        // when it succeeds (NULL to return the value of the test)
+        struct {
+            int count;
+            Node **tests;
+            Node **bodies;
+        } cond;
+        // CALL_NODE and its specializations: primitive is the procedure a
+        // specialized call expects, op what it computes, and deopts how
+        // often its guard has failed
+        struct {
+            Node *fn;
+            int argc;
+            Node **args;
+            Value *primitive;
+            arithOp op;
+            int deopts;
+        } call;
+        // ERROR_NODE: the error reported when the node is evaluated
+        int error;
+    };
+};
+
+// Checks the syntax of a top-level expression and returns the node that
+// evaluates it. Malformed forms become ERROR_NODEs, so that errors are still
+// reported when (and only if) the form is reached.
+Node *analyze(Value *expr);
+
+// Calls visit on each node directly nested in node, in evaluation order.
+void visitChildren(Node *node, void (*visit)(Node *, void *), void *data);
+
+// Returns whether node is a call, specialized or not.
+int isCall(Node *node);
+
+// Returns the number of slots the lets of an expression need, not counting
+// those of nested lambdas.
+int countSlots(Node *node);
+
+// Returns array, of count elements of the given size, with room for one more
+// element, copying it into a larger array if it is full; *capacity is updated
+// to the room the returned array has.
+void *growArray(void *array, int count, int *capacity, size_t size);
+
+#endif
@@ -0,0 +1,578 @@
+// Arbitrary-precision integers. A BIGNUM_TYPE value holds an integer too
+// big for a fixnum as a sign and a magnitude of base-2^32 digits, least
+// significant first, without leading zeros. The functions on magnitudes
+// take a digit array and its length, and put up with leading zeros; only
+// results handed back as values are normalized.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "bignum.h"
+#include "linkedlist.h"
+#include "talloc.h"
+
+typedef unsigned int digit;
+typedef unsigned long wide;
+
+// An integer operated on: a sign and a magnitude, which borrows the digits
+// of a bignum, or holds the at most two digits of a fixnum in small.
+typedef struct Integer {
+    int sign;
+    int length;
+    digit *digits;
+    digit small[2];
+} Integer;
+
+// a power of ten that decimal conversion divides by
+typedef struct Power {
+    digit *digits;
+    int length;
+} Power;
+
+// decimalPowers[k] is 10^(9 * 2^k), once it has been needed
+Power decimalPowers[32];
+
+int isExactInteger(Value *value) {
+    return value->type == INT_TYPE || value->type == BIGNUM_TYPE;
+}
+
+// reads value, an exact integer, into *n
+void readInteger(Value *value, Integer *n) {
+    if (value->type == BIGNUM_TYPE) {
+        n->sign = value->big.sign;
+        n->length = value->big.length;
+        n->digits = value->big.digits;
+        return;
+    }
+    long i = value->i;
+    wide magnitude = i < 0 ? -(wide)i : (wide)i;
+    n->sign = i < 0 ? -1 : 1;
+    n->small[0] = (digit)magnitude;
+    n->small[1] = (digit)(magnitude >> 32);
+    n->digits = n->small;
+    n->length = n->small[1] ? 2 : (n->small[0] ? 1 : 0);
+}
+
+// returns the integer with sign and the magnitude in length digits, which
+// it takes over: a fixnum if it fits in one
+Value *normalize(int sign, digit *digits, int length) {
+    while (length > 0 && digits[length - 1] == 0) {
+        length--;
+    }
+    if (length <= 2) {
+        wide magnitude = 0;
+        for (int i = length - 1; i >= 0; i--) {
+            magnitude = magnitude << 32 | digits[i];
+        }
+        if (magnitude <= LONG_MAX) {
+            return makeInt(sign < 0 ? -(long)magnitude : (long)magnitude);
+        }
+        if (sign < 0 && magnitude == (wide)LONG_MAX + 1) {
+            return makeInt(LONG_MIN);
+        }
+    }
+    Value *value = makeNull();
+    value->type = BIGNUM_TYPE;
+    value->big.sign = sign;
+    value->big.length = length;
+    value->big.digits = digits;
+    return value;
+}
+
+int compareMagnitudes(digit *a, int an, digit *b, int bn) {
+    while (an > 0 && a[an - 1] == 0) {
+        an--;
+    }
+    while (bn > 0 && b[bn - 1] == 0) {
+        bn--;
+    }
+    if (an != bn) {
+        return an < bn ? -1 : 1;
+    }
+    for (int i = an - 1; i >= 0; i--) {
+        if (a[i] != b[i]) {
+            return a[i] < b[i] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+// adds a, of an <= rn digits, to r, of rn digits, returning the carry out
+digit addInto(digit *r, int rn, digit *a, int an) {
+    wide carry = 0;
+    int i = 0;
+    for (; i < an; i++) {
+        carry += (wide)r[i] + a[i];
+        r[i] = (digit)carry;
+        carry >>= 32;
+    }
+    for (; carry && i < rn; i++) {
+        carry += r[i];
+        r[i] = (digit)carry;
+        carry >>= 32;
+    }
+    return (digit)carry;
+}
+
+// subtracts a, of an <= rn digits, from r, of rn digits, which must be at
+// least as large
+void subtractFrom(digit *r, int rn, digit *a, int an) {
+    wide borrow = 0;
+    int i = 0;
+    for (; i < an; i++) {
+        wide difference = (wide)r[i] - a[i] - borrow;
+        r[i] = (digit)difference;
+        borrow = (difference >> 32) & 1;
+    }
+    for (; borrow && i < rn; i++) {
+        wide difference = (wide)r[i] - borrow;
+        r[i] = (digit)difference;
+        borrow = (difference >> 32) & 1;
+    }
+}
+
+void multiplySchoolbook(digit *r, digit *a, int an, digit *b, int bn) {
+    memset(r, 0, (an + bn) * sizeof(digit));
+    for (int i = 0; i < bn; i++) {
+        wide factor = b[i];
+        wide carry = 0;
+        for (int j = 0; j < an; j++) {
+            carry += r[i + j] + factor * a[j];
+            r[i + j] = (digit)carry;
+            carry >>= 32;
+        }
+        r[i + an] = (digit)carry;
+    }
+}
+
+// stores the product of the magnitudes a and b, of an and bn digits, in the
+// an + bn digits of r
+void multiplyMagnitudes(digit *r, digit *a, int an, digit *b, int bn) {
+    if (an < bn) {
+        digit *t = a;
+        a = b;
+        b = t;
+        int tn = an;
+        an = bn;
+        bn = tn;
+    }
+    if (bn < KARATSUBA_THRESHOLD) {
+        multiplySchoolbook(r, a, an, b, bn);
+        return;
+    }
+    if (an >= 2 * bn) {
+        // a lopsided product is the sum of balanced ones, of bn digits of a
+        // at a time
+        memset(r, 0, (an + bn) * sizeof(digit));
+        digit *part = malloc(2 * bn * sizeof(digit));
+        for (int i = 0; i < an; i += bn) {
+            int length = an - i < bn ? an - i : bn;
+            multiplyMagnitudes(part, a + i, length, b, bn);
+            addInto(r + i, an + bn - i, part, length + bn);
+        }
+        free(part);
+        return;
+    }
+
+    // Karatsuba: with a = a1 B^m + a0 and b = b1 B^m + b0, the product is
+    // z2 B^2m + z1 B^m + z0 for z0 = a0 b0, z2 = a1 b1 and
+    // z1 = (a0 + a1)(b0 + b1) - z0 - z2, three half-size products
+    int m = bn / 2;
+    int an1 = an - m;
+    int bn1 = bn - m;
+    multiplyMagnitudes(r, a, m, b, m);
+    multiplyMagnitudes(r + 2 * m, a + m, an1, b + m, bn1);
+    int sn = an1 + 1;
+    int tn = bn1 + 1;
+    digit *s = calloc(2 * (sn + tn), sizeof(digit));
+    digit *t = s + sn;
+    digit *z1 = t + tn;
+    memcpy(s, a, m * sizeof(digit));
+    addInto(s, sn, a + m, an1);
+    memcpy(t, b, m * sizeof(digit));
+    addInto(t, tn, b + m, bn1);
+    multiplyMagnitudes(z1, s, sn, t, tn);
+    subtractFrom(z1, sn + tn, r, 2 * m);
+    subtractFrom(z1, sn + tn, r + 2 * m, an + bn - 2 * m);
+    int zn = sn + tn;
+    while (zn > 0 && z1[zn - 1] == 0) {
+        zn--;
+    }
+    addInto(r + m, an + bn - m, z1, zn);
+    free(s);
+}
+
+// divides the magnitude a by b, of an >= bn digits, the top one of b not
+// zero, storing the an - bn + 1 digits of the quotient in q and the bn
+// digits of the remainder in r; either may be NULL. This is Knuth's
+// algorithm D, which finds each digit of the quotient from the top two
+// digits of the remainder so far
+void divideMagnitudes(digit *q, digit *r, digit *a, int an, digit *b,
+                      int bn) {
+    if (bn == 1) {
+        wide remainder = 0;
+        for (int i = an - 1; i >= 0; i--) {
+            wide current = remainder << 32 | a[i];
+            if (q != NULL) {
+                q[i] = (digit)(current / b[0]);
+            }
+            remainder = current % b[0];
+        }
+        if (r != NULL) {
+            r[0] = (digit)remainder;
+        }
+        return;
+    }
+
+    // shift both so that the top digit of the divisor has its top bit set,
+    // which makes the estimates of the quotient digits off by at most two
+    int shift = __builtin_clz(b[bn - 1]);
+    digit *u = malloc((an + 1 + bn) * sizeof(digit));
+    digit *v = u + an + 1;
+    for (int i = bn - 1; i > 0; i--) {
+        v[i] = b[i] << shift | (shift ? b[i - 1] >> (32 - shift) : 0);
+    }
+    v[0] = b[0] << shift;
+    u[an] = shift ? a[an - 1] >> (32 - shift) : 0;
+    for (int i = an - 1; i > 0; i--) {
+        u[i] = a[i] << shift | (shift ? a[i - 1] >> (32 - shift) : 0);
+    }
+    u[0] = a[0] << shift;
+
+    for (int j = an - bn; j >= 0; j--) {
+        wide top = (wide)u[j + bn] << 32 | u[j + bn - 1];
+        wide qhat = top / v[bn - 1];
+        wide rhat = top % v[bn - 1];
+        while (qhat >> 32 ||
+               qhat * v[bn - 2] > (rhat << 32 | u[j + bn - 2])) {
+            qhat--;
+            rhat += v[bn - 1];
+            if (rhat >> 32) {
+                break;
+            }
+        }
+        // subtract qhat times the divisor
+        long borrow = 0;
+        long difference;
+        for (int i = 0; i < bn; i++) {
+            wide product = qhat * v[i];
+            difference = u[i + j] - borrow - (long)(product & 0xffffffff);
+            u[i + j] = (digit)difference;
+            borrow = (long)(product >> 32) - (difference >> 32);
+        }
+        difference = u[j + bn] - borrow;
+        u[j + bn] = (digit)difference;
+        if (difference < 0) {
+            // qhat was one too big: add the divisor back
+            qhat--;
+            wide carry = 0;
+            for (int i = 0; i < bn; i++) {
+                carry += (wide)u[i + j] + v[i];
+                u[i + j] = (digit)carry;
+                carry >>= 32;
+            }
+            u[j + bn] += (digit)carry;
+        }
+        if (q != NULL) {
+            q[j] = (digit)qhat;
+        }
+    }
+
+    if (r != NULL) {
+        for (int i = 0; i < bn - 1; i++) {
+            r[i] = u[i] >> shift | (shift ? u[i + 1] << (32 - shift) : 0);
+        }
+        r[bn - 1] = u[bn - 1] >> shift;
+    }
+    free(u);
+}
+
+// adds b to a, or with negate set, subtracts it
+Value *addIntegers(Value *a, Value *b, int negate) {
+    Integer x;
+    Integer y;
+    readInteger(a, &x);
+    readInteger(b, &y);
+    if (negate) {
+        y.sign = -y.sign;
+    }
+    int order = compareMagnitudes(x.digits, x.length, y.digits, y.length);
+    Integer *larger = order >= 0 ? &x : &y;
+    Integer *smaller = order >= 0 ? &y : &x;
+    int length = larger->length + 1;
+    digit *r = talloc(length * sizeof(digit));
+    memcpy(r, larger->digits, larger->length * sizeof(digit));
+    r[larger->length] = 0;
+    if (x.sign == y.sign) {
+        addInto(r, length, smaller->digits, smaller->length);
+    }
+    else {
+        subtractFrom(r, length, smaller->digits, smaller->length);
+    }
+    return normalize(larger->sign, r, length);
+}
+
+Value *integerAdd(Value *a, Value *b) {
+    return addIntegers(a, b, 0);
+}
+
+Value *integerSub(Value *a, Value *b) {
+    return addIntegers(a, b, 1);
+}
+
+Value *integerMul(Value *a, Value *b) {
+    Integer x;
+    Integer y;
+    readInteger(a, &x);
+    readInteger(b, &y);
+    if (x.length == 0 || y.length == 0) {
+        return makeInt(0);
+    }
+    digit *r = talloc((x.length + y.length) * sizeof(digit));
+    multiplyMagnitudes(r, x.digits, x.length, y.digits, y.length);
+    return normalize(x.sign * y.sign, r, x.length + y.length);
+}
+
+Value *integerNegate(Value *a) {
+    Integer x;
+    readInteger(a, &x);
+    digit *r = talloc((x.length + 1) * sizeof(digit));
+    memcpy(r, x.digits, x.length * sizeof(digit));
+    return normalize(-x.sign, r, x.length);
+}
+
+// divides a by b, returning the quotient, or with remainder set, the
+// remainder
+Value *divideIntegers(Value *a, Value *b, int remainder) {
+    Integer x;
+    Integer y;
+    readInteger(a, &x);
+    readInteger(b, &y);
+    if (x.length < y.length) {
+        return remainder ? a : makeInt(0);
+    }
+    if (remainder) {
+        digit *r = talloc(y.length * sizeof(digit));
+        divideMagnitudes(NULL, r, x.digits, x.length, y.digits, y.length);
+        return normalize(x.sign, r, y.length);
+    }
+    int length = x.length - y.length + 1;
+    digit *q = talloc(length * sizeof(digit));
+    divideMagnitudes(q, NULL, x.digits, x.length, y.digits, y.length);
+    return normalize(x.sign * y.sign, q, length);
+}
+
+Value *integerQuotient(Value *a, Value *b) {
+    return divideIntegers(a, b, 0);
+}
+
+Value *integerRemainder(Value *a, Value *b) {
+    return divideIntegers(a, b, 1);
+}
+
+int integerSign(Value *a) {
+    if (a->type == BIGNUM_TYPE) {
+        return a->big.sign;
+    }
+    return (a->i > 0) - (a->i < 0);
+}
+
+int integerCompare(Value *a, Value *b) {
+    if (a->type == INT_TYPE && b->type == INT_TYPE) {
+        return (a->i > b->i) - (a->i < b->i);
+    }
+    int sign = integerSign(a);
+    if (sign != integerSign(b)) {
+        return sign < integerSign(b) ? -1 : 1;
+    }
+    Integer x;
+    Integer y;
+    readInteger(a, &x);
+    readInteger(b, &y);
+    return sign * compareMagnitudes(x.digits, x.length, y.digits, y.length);
+}
+
+double integerToDouble(Value *a) {
+    if (a->type == INT_TYPE) {
+        return a->i;
+    }
+    double d = 0.0;
+    for (int i = a->big.length - 1; i >= 0; i--) {
+        d = d * 4294967296.0 + a->big.digits[i];
+    }
+    return a->big.sign * d;
+}
+
+Value *integerFromDouble(double d) {
+    if (d > -9223372036854775808.0 && d < 9223372036854775808.0) {
+        return makeInt((long)d);
+    }
+    // d is mantissa * 2^exponent, for a 53-bit mantissa and exponent > 0
+    wide bits;
+    memcpy(&bits, &d, sizeof(double));
+    int exponent = (int)((bits >> 52) & 0x7ff) - 1075;
+    wide mantissa = (bits & ((1UL << 52) - 1)) | 1UL << 52;
+    int length = exponent / 32 + 3;
+    digit *digits = talloc(length * sizeof(digit));
+    memset(digits, 0, length * sizeof(digit));
+    unsigned __int128 shifted = (unsigned __int128)mantissa << exponent % 32;
+    for (int i = 0; i < 3; i++) {
+        digits[exponent / 32 + i] = (digit)(shifted >> (32 * i));
+    }
+    return normalize(d < 0 ? -1 : 1, digits, length);
+}
+
+Value *integerFromUnsigned(unsigned long n) {
+    if (n <= LONG_MAX) {
+        return makeInt(n);
+    }
+    digit *digits = talloc(2 * sizeof(digit));
+    digits[0] = (digit)n;
+    digits[1] = (digit)(n >> 32);
+    return normalize(1, digits, 2);
+}
+
+int integerToUnsigned(Value *a, unsigned long *n) {
+    if (integerSign(a) < 0) {
+        return 0;
+    }
+    Integer x;
+    readInteger(a, &x);
+    if (x.length > 2) {
+        return 0;
+    }
+    *n = 0;
+    for (int i = x.length - 1; i >= 0; i--) {
+        *n = *n << 32 | x.digits[i];
+    }
+    return 1;
+}
+
+// returns 10^(9 * 2^k)
+Power *decimalPower(int k) {
+    Power *power = &decimalPowers[k];
+    if (power->digits != NULL) {
+        return power;
+    }
+    if (k == 0) {
+        power->digits = talloc(sizeof(digit));
+        power->digits[0] = 1000000000;
+        power->length = 1;
+        return power;
+    }
+    Power *root = decimalPower(k - 1);
+    int length = 2 * root->length;
+    power->digits = talloc(length * sizeof(digit));
+    multiplyMagnitudes(power->digits, root->digits, root->length,
+                       root->digits, root->length);
+    while (power->digits[length - 1] == 0) {
+        length--;
+    }
+    power->length = length;
+    return power;
+}
+
+// stores the count base-10^9 digits of the magnitude a, which is less than
+// 10^(9 count), in chunks, least significant first; count is a power of two.
+// A long magnitude is split by dividing it by 10^(9 count / 2), and the
+// halves converted in turn, so that most of the work is done on short
+// numbers.
+void decimalChunks(digit *a, int an, unsigned int *chunks, int count) {
+    while (an > 0 && a[an - 1] == 0) {
+        an--;
+    }
+    if (an <= DECIMAL_THRESHOLD || count == 1) {
+        digit *n = malloc((an + 1) * sizeof(digit));
+        memcpy(n, a, an * sizeof(digit));
+        for (int i = 0; i < count; i++) {
+            wide remainder = 0;
+            for (int j = an - 1; j >= 0; j--) {
+                wide current = remainder << 32 | n[j];
+                n[j] = (digit)(current / 1000000000);
+                remainder = current % 1000000000;
+            }
+            chunks[i] = (unsigned int)remainder;
+            while (an > 0 && n[an - 1] == 0) {
+                an--;
+            }
+        }
+        free(n);
+        return;
+    }
+    int half = count / 2;
+    Power *power = decimalPower(__builtin_ctz(half));
+    if (compareMagnitudes(a, an, power->digits, power->length) < 0) {
+        decimalChunks(a, an, chunks, half);
+        memset(chunks + half, 0, half * sizeof(unsigned int));
+        return;
+    }
+    int qn = an - power->length + 1;
+    digit *q = malloc((qn + power->length) * sizeof(digit));
+    digit *r = q + qn;
+    divideMagnitudes(q, r, a, an, power->digits, power->length);
+    decimalChunks(r, power->length, chunks, half);
+    decimalChunks(q, qn, chunks + half, half);
+    free(q);
+}
+
+char *integerToString(Value *a) {
+    Integer x;
+    readInteger(a, &x);
+    int k = 0;
+    while (compareMagnitudes(x.digits, x.length, decimalPower(k)->digits,
+                             decimalPower(k)->length) >= 0) {
+        k++;
+    }
+    int count = 1 << k;
+    unsigned int *chunks = malloc(count * sizeof(unsigned int));
+    decimalChunks(x.digits, x.length, chunks, count);
+    int top = count - 1;
+    while (top > 0 && chunks[top] == 0) {
+        top--;
+    }
+    char *text = talloc(9 * (top + 1) + 2);
+    char *end = text;
+    if (x.sign < 0 && x.length > 0) {
+        *end++ = '-';
+    }
+    end += sprintf(end, "%u", chunks[top]);
+    for (int i = top - 1; i >= 0; i--) {
+        end += sprintf(end, "%09u", chunks[i]);
+    }
+    free(chunks);
+    return text;
+}
+
+Value *parseInteger(char *text) {
+    int sign = 1;
+    if (*text == '+' || *text == '-') {
+        sign = *text == '-' ? -1 : 1;
+        text++;
+    }
+    int count = strlen(text);
+    // each nine decimal digits add at most one base-2^32 digit
+    int capacity = count / 9 + 2;
+    digit *digits = talloc(capacity * sizeof(digit));
+    memset(digits, 0, capacity * sizeof(digit));
+    int length = 0;
+    for (int i = 0; i < count;) {
+        wide factor = 1;
+        wide chunk = 0;
+        for (int j = 0; j < 9 && i < count; j++, i++) {
+            factor *= 10;
+            chunk = chunk * 10 + (text[i] - '0');
+        }
+        // digits = digits * factor + chunk
+        wide carry = chunk;
+        for (int j = 0; j < length; j++) {
+            carry += factor * digits[j];
+            digits[j] = (digit)carry;
+            carry >>= 32;
+        }
+        if (carry) {
+            digits[length++] = (digit)carry;
+        }
+    }
+    return normalize(sign, digits, length);
+}
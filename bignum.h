@@ -0,0 +1,54 @@
+#include "value.h"
+
+#ifndef _BIGNUM
+#define _BIGNUM
+
+// operands shorter than this many digits are multiplied by the schoolbook
+// method, longer ones by Karatsuba's
+#define KARATSUBA_THRESHOLD 32
+
+// magnitudes up to this many digits are converted to decimal by repeated
+// short division, longer ones by divide and conquer
+#define DECIMAL_THRESHOLD 64
+
+// Exact integer arithmetic on INT_TYPE and BIGNUM_TYPE values. Results that
+// fit in a fixnum are always INT_TYPE, so the two types never overlap.
+
+// Returns whether value is an exact integer.
+int isExactInteger(Value *value);
+
+Value *integerAdd(Value *a, Value *b);
+Value *integerSub(Value *a, Value *b);
+Value *integerMul(Value *a, Value *b);
+Value *integerNegate(Value *a);
+
+// Divide a by b, which is not zero: the quotient is truncated toward zero,
+// and the remainder has the sign of a.
+Value *integerQuotient(Value *a, Value *b);
+Value *integerRemainder(Value *a, Value *b);
+
+// Returns -1, 0 or 1 as a is less than, equal to or greater than b.
+int integerCompare(Value *a, Value *b);
+
+// Returns -1, 0 or 1 as a is negative, zero or positive.
+int integerSign(Value *a);
+
+// Returns the double nearest to a.
+double integerToDouble(Value *a);
+
+// Returns the integral double d as an exact integer.
+Value *integerFromDouble(double d);
+
+// Returns n as an exact integer.
+Value *integerFromUnsigned(unsigned long n);
+
+// Stores a in *n and returns 1 if it is from 0 to 2^64 - 1, or returns 0.
+int integerToUnsigned(Value *a, unsigned long *n);
+
+// Returns the decimal digits of a, after a minus sign if it is negative.
+char *integerToString(Value *a);
+
+// Parses a decimal integer literal, which may start with a sign.
+Value *parseInteger(char *text);
+
+#endif
@@ -0,0 +1,189 @@
+// Bytevectors, and the loads and stores of multi-byte integers and floats
+// in them, which compile to single moves, with a byte swap when the order
+// asked for is not the machine's.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "bytevector.h"
+#include "linkedlist.h"
+#include "talloc.h"
+
+// whether the machine stores the most significant byte first
+#define HOST_BIG_ENDIAN (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+
+Value *makeBytevector(long length) {
+    Value *value = makeNull();
+    value->type = BYTEVECTOR_TYPE;
+    value->bv.length = length;
+    value->bv.bytes = talloc(length);
+    memset(value->bv.bytes, 0, length);
+    return value;
+}
+
+// a file some bytevector is a mapping of; mappings are never undone, so
+// neither are these
+typedef struct MappedFile {
+    dev_t device;
+    ino_t inode;
+    struct MappedFile *next;
+} MappedFile;
+
+static MappedFile *mappedFiles = NULL;
+
+// returns whether some bytevector is a mapping of the file with status
+int isMapped(struct stat *status) {
+    for (MappedFile *file = mappedFiles; file != NULL; file = file->next) {
+        if (file->device == status->st_dev && file->inode == status->st_ino) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+Value *readBytevectorFile(char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat status;
+    if (fstat(fd, &status) < 0 || !S_ISREG(status.st_mode)) {
+        close(fd);
+        return NULL;
+    }
+    long length = status.st_size;
+    Value *value = makeNull();
+    value->type = BYTEVECTOR_TYPE;
+    value->bv.length = length;
+    if (length >= MAP_THRESHOLD) {
+        void *bytes = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                           fd, 0);
+        close(fd);
+        if (bytes == MAP_FAILED) {
+            return NULL;
+        }
+        if (!isMapped(&status)) {
+            MappedFile *file = talloc(sizeof(MappedFile));
+            file->device = status.st_dev;
+            file->inode = status.st_ino;
+            file->next = mappedFiles;
+            mappedFiles = file;
+        }
+        value->bv.bytes = bytes;
+        return value;
+    }
+    value->bv.bytes = talloc(length);
+    long position = 0;
+    while (position < length) {
+        ssize_t count = read(fd, value->bv.bytes + position,
+                             length - position);
+        if (count <= 0) {
+            close(fd);
+            return NULL;
+        }
+        position += count;
+    }
+    close(fd);
+    return value;
+}
+
+// writes all of bytevector to fd and returns whether that worked
+int writeAll(int fd, Value *bytevector) {
+    long position = 0;
+    while (position < bytevector->bv.length) {
+        ssize_t count = write(fd, bytevector->bv.bytes + position,
+                              bytevector->bv.length - position);
+        if (count <= 0) {
+            return 0;
+        }
+        position += count;
+    }
+    return 1;
+}
+
+// writes bytevector to a new file beside path with the mode of the file
+// with status, then renames it over path, leaving the old file to the
+// bytevectors that map it
+int replaceBytevectorFile(char *path, struct stat *status,
+                          Value *bytevector) {
+    char *temporary = talloc(strlen(path) + 8);
+    sprintf(temporary, "%s.XXXXXX", path);
+    int fd = mkstemp(temporary);
+    if (fd < 0) {
+        return 0;
+    }
+    int written = fchmod(fd, status->st_mode & 07777) == 0 &&
+        writeAll(fd, bytevector);
+    written = close(fd) == 0 && written && rename(temporary, path) == 0;
+    if (!written) {
+        unlink(temporary);
+    }
+    return written;
+}
+
+int writeBytevectorFile(char *path, Value *bytevector) {
+    struct stat status;
+    if (stat(path, &status) == 0 && isMapped(&status)) {
+        return replaceBytevectorFile(path, &status, bytevector);
+    }
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0) {
+        return 0;
+    }
+    int written = writeAll(fd, bytevector);
+    return close(fd) == 0 && written;
+}
+
+unsigned long loadBytes(unsigned char *bytes, int size, int big) {
+    int swap = big != HOST_BIG_ENDIAN;
+    switch (size) {
+     case 2: {
+        uint16_t n;
+        memcpy(&n, bytes, 2);
+        return swap ? __builtin_bswap16(n) : n;
+     }
+     case 4: {
+        uint32_t n;
+        memcpy(&n, bytes, 4);
+        return swap ? __builtin_bswap32(n) : n;
+     }
+     case 8: {
+        uint64_t n;
+        memcpy(&n, bytes, 8);
+        return swap ? __builtin_bswap64(n) : n;
+     }
+     default: {
+        return bytes[0];
+     }
+    }
+}
+
+void storeBytes(unsigned char *bytes, int size, int big, unsigned long n) {
+    int swap = big != HOST_BIG_ENDIAN;
+    switch (size) {
+     case 2: {
+        uint16_t field = swap ? __builtin_bswap16(n) : n;
+        memcpy(bytes, &field, 2);
+        break;
+     }
+     case 4: {
+        uint32_t field = swap ? __builtin_bswap32(n) : n;
+        memcpy(bytes, &field, 4);
+        break;
+     }
+     case 8: {
+        uint64_t field = swap ? __builtin_bswap64(n) : n;
+        memcpy(bytes, &field, 8);
+        break;
+     }
+     default: {
+        bytes[0] = n;
+        break;
+     }
+    }
+}
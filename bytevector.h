@@ -0,0 +1,33 @@
+#include "value.h"
+
+#ifndef _BYTEVECTOR
+#define _BYTEVECTOR
+
+// files at least this big are mapped into memory rather than read
+#define MAP_THRESHOLD (1 << 20)
+
+// Returns a new BYTEVECTOR_TYPE value of length bytes, all zero.
+Value *makeBytevector(long length);
+
+// Returns a bytevector of the whole file at path, or NULL if it cannot be
+// read. A big file is mapped privately, so that setting its bytes changes
+// the bytevector but not the file. Pages not yet set still show the file,
+// so the bytevector only keeps its bytes while no one else changes the
+// file; writeBytevectorFile sees to that for this process.
+Value *readBytevectorFile(char *path);
+
+// Writes the bytes of bytevector to the file at path and returns whether
+// that worked. The contents are replaced in place, so that the file's links,
+// mode and owner stay as they were, unless some bytevector maps the file;
+// then a new file with the same mode is renamed over path, so that the
+// mapping keeps the old contents.
+int writeBytevectorFile(char *path, Value *bytevector);
+
+// Returns the unsigned integer of size bytes, 1, 2, 4 or 8, at bytes, most
+// significant first if big is set and least significant first otherwise.
+unsigned long loadBytes(unsigned char *bytes, int size, int big);
+
+// Stores the low size bytes of n at bytes, in the same orders.
+void storeBytes(unsigned char *bytes, int size, int big, unsigned long n);
+
+#endif
@@ -0,0 +1,386 @@
+// Compiler from analyzed Nodes to bytecode for the virtual machine in vm.c.
+// Variables were already resolved by analyze(), so compiling is mostly a
+// matter of mapping each analyzer scope to slots of the enclosing frame.
+
+#include <string.h>
+#include "vm.h"
+#include "talloc.h"
+#include "linkedlist.h"
+
+// State of a Code under compilation.
+typedef struct Compiler {
+    Code *code;
+    int opCapacity;
+    int constCount;
+    int constCapacity;
+    int globalCount;
+    int globalCapacity;
+    int lambdaCount;
+    int lambdaCapacity;
+    int callCount;
+    int callCapacity;
+    int nextSlot;
+    int depth;
+    Value *voidValue;
+    struct Compiler *parent;
+} Compiler;
+
+// The slots, starting at offset, that hold the variables of one analyzer
+// scope in the frame being compiled.
+typedef struct Region {
+    int offset;
+    struct Region *parent;
+} Region;
+
+void compileNode(Compiler *c, Region *region, Node *node, int tail);
+
+// appends one word to the instruction stream
+void emit(Compiler *c, int word) {
+    c->code->ops = growArray(c->code->ops, c->code->length, &c->opCapacity,
+                             sizeof(int));
+    c->code->ops[c->code->length] = word;
+    c->code->length++;
+}
+
+// appends an instruction that changes the stack depth by effect
+void emitOp(Compiler *c, opcode op, int effect) {
+    emit(c, op);
+    c->depth += effect;
+    if (c->depth > c->code->maxStack) {
+        c->code->maxStack = c->depth;
+    }
+}
+
+// returns the index of a new constant
+int addConst(Compiler *c, Value *value) {
+    c->code->consts = growArray(c->code->consts, c->constCount,
+                                &c->constCapacity, sizeof(Value *));
+    c->code->consts[c->constCount] = value;
+    c->constCount++;
+    return c->constCount - 1;
+}
+
+// returns the index of a global variable node; the node caches the binding
+int addGlobal(Compiler *c, Node *var) {
+    c->code->globals = growArray(c->code->globals, c->globalCount,
+                                 &c->globalCapacity, sizeof(Node *));
+    c->code->globals[c->globalCount] = var;
+    c->globalCount++;
+    return c->globalCount - 1;
+}
+
+// returns the index of a call node of two arguments
+int addCall(Compiler *c, Node *call) {
+    c->code->calls = growArray(c->code->calls, c->callCount,
+                               &c->callCapacity, sizeof(Node *));
+    c->code->calls[c->callCount] = call;
+    c->callCount++;
+    return c->callCount - 1;
+}
+
+// emits a jump instruction and returns the position of its target operand
+int emitJump(Compiler *c, opcode op, int effect) {
+    emitOp(c, op, effect);
+    emit(c, 0);
+    return c->code->length - 1;
+}
+
+// points the jump whose target operand is at position at the next
+// instruction
+void patchJump(Compiler *c, int position) {
+    c->code->ops[position] = c->code->length;
+}
+
+void pushConst(Compiler *c, Value *value) {
+    emitOp(c, OP_CONST, 1);
+    emit(c, addConst(c, value));
+}
+
+// creates a compiler for a Code whose frame has size slots
+Compiler *makeCompiler(Compiler *parent, Node *lambda, int size) {
+    Compiler *c = talloc(sizeof(Compiler));
+    Code *code = talloc(sizeof(Code));
+    code->ops = NULL;
+    code->length = 0;
+    code->consts = NULL;
+    code->globals = NULL;
+    code->lambdas = NULL;
+    code->calls = NULL;
+    code->lambda = lambda;
+    code->paramCount = lambda ? lambda->lambda.paramCount : 0;
+    code->frameSize = size;
+    code->maxStack = 0;
+    c->code = code;
+    c->opCapacity = 0;
+    c->constCount = 0;
+    c->constCapacity = 0;
+    c->globalCount = 0;
+    c->globalCapacity = 0;
+    c->lambdaCount = 0;
+    c->lambdaCapacity = 0;
+    c->callCount = 0;
+    c->callCapacity = 0;
+    c->nextSlot = lambda ? lambda->lambda.frameSize : 0;
+    c->depth = 0;
+    c->parent = parent;
+    if (parent) {
+        c->voidValue = parent->voidValue;
+    }
+    else {
+        c->voidValue = makeVoid();
+    }
+    return c;
+}
+
+// returns the slot holding the local variable node refers to
+int slotOf(Region *region, Node *node) {
+    for (int i = 0; i < node->var.depth; i++) {
+        region = region->parent;
+    }
+    return region->offset + node->var.index;
+}
+
+void compileVariable(Compiler *c, Region *region, Node *node) {
+    if (node->kind == GLOBAL_NODE) {
+        emitOp(c, OP_GLOBAL, 1);
+        emit(c, addGlobal(c, node));
+        return;
+    }
+    if (node->kind == FREE_NODE) {
+        emitOp(c, node->var.boxed ? OP_BOXED_FREE : OP_FREE, 1);
+        emit(c, node->var.index);
+    }
+    else {
+        emitOp(c, node->var.boxed ? OP_BOXED_LOCAL : OP_LOCAL, 1);
+        emit(c, slotOf(region, node));
+    }
+    emit(c, addConst(c, node->var.symbol));
+}
+
+// emits code popping the top of the stack into a variable
+void compileStore(Compiler *c, Region *region, Node *node, opcode global) {
+    if (node->kind == GLOBAL_NODE) {
+        emitOp(c, global, -1);
+        emit(c, addGlobal(c, node));
+    }
+    else if (node->kind == FREE_NODE) {
+        // only boxed free variables can be assigned
+        emitOp(c, OP_SET_BOXED_FREE, -1);
+        emit(c, node->var.index);
+    }
+    else {
+        emitOp(c, node->var.boxed ? OP_SET_BOXED_LOCAL : OP_SET_LOCAL, -1);
+        emit(c, slotOf(region, node));
+    }
+}
+
+// emits code boxing the slots, from offset on, that boxed flags
+void compileBoxes(Compiler *c, char *boxed, int offset, int size) {
+    for (int i = 0; boxed != NULL && i < size; i++) {
+        if (boxed[i]) {
+            emitOp(c, OP_BOX, 0);
+            emit(c, offset + i);
+        }
+    }
+}
+
+// compiles a lambda into a Code of its own and returns its index among the
+// lambdas of c
+int compileLambda(Compiler *c, Region *region, Node *node) {
+    Node *body = node->lambda.body;
+    Compiler *inner = makeCompiler(c, node,
+                                   node->lambda.frameSize + countSlots(body));
+    Region *newRegion = talloc(sizeof(Region));
+    newRegion->offset = 0;
+    newRegion->parent = NULL;
+    compileBoxes(inner, node->lambda.boxed, 0, node->lambda.frameSize);
+    compileNode(inner, newRegion, body, 1);
+    emitOp(inner, OP_RETURN, -1);
+
+    c->code->lambdas = growArray(c->code->lambdas, c->lambdaCount,
+                                 &c->lambdaCapacity, sizeof(Code *));
+    c->code->lambdas[c->lambdaCount] = inner->code;
+    c->lambdaCount++;
+    return c->lambdaCount - 1;
+}
+
+void compileLet(Compiler *c, Region *region, Node *node, int tail) {
+    Region *newRegion = talloc(sizeof(Region));
+    newRegion->offset = c->nextSlot;
+    newRegion->parent = region;
+    c->nextSlot += node->let.frameSize;
+
+    compileBoxes(c, node->let.boxed, newRegion->offset, node->let.frameSize);
+    Region *initRegion = node->kind == LET_NODE ? region : newRegion;
+    for (int i = 0; i < node->let.count; i++) {
+        compileNode(c, initRegion, node->let.inits[i], 0);
+        int boxed = node->let.boxed != NULL && node->let.boxed[i];
+        emitOp(c, boxed ? OP_SET_BOXED_LOCAL : OP_SET_LOCAL, -1);
+        emit(c, newRegion->offset + i);
+    }
+    compileNode(c, newRegion, node->let.body, tail);
+}
+
+void compileSequence(Compiler *c, Region *region, Node *node, int tail) {
+    if (node->seq.count == 0) {
+        pushConst(c, c->voidValue);
+        return;
+    }
+    for (int i = 0; i < node->seq.count - 1; i++) {
+        compileNode(c, region, node->seq.exprs[i], 0);
+        emitOp(c, OP_POP, -1);
+    }
+    compileNode(c, region, node->seq.exprs[node->seq.count - 1], tail);
+}
+
+// compiles and/or: each operand but the last jumps to the end, keeping its
+// value, if it decides the result
+void compileLogical(Compiler *c, Region *region, Node *node, int tail) {
+    if (node->seq.count == 0) {
+        pushConst(c, node->kind == AND_NODE ? makeTrue() : makeFalse());
+        return;
+    }
+    opcode op = node->kind == AND_NODE ? OP_AND : OP_OR;
+    int *exits = talloc(node->seq.count * sizeof(int));
+    for (int i = 0; i < node->seq.count - 1; i++) {
+        compileNode(c, region, node->seq.exprs[i], 0);
+        exits[i] = emitJump(c, op, -1);
+    }
+    compileNode(c, region, node->seq.exprs[node->seq.count - 1], tail);
+    for (int i = 0; i < node->seq.count - 1; i++) {
+        patchJump(c, exits[i]);
+    }
+}
+
+void compileCond(Compiler *c, Region *region, Node *node, int tail) {
+    int *exits = talloc(node->cond.count * sizeof(int));
+    int exitCount = 0;
+    int depth = c->depth;
+    int hasElse = 0;
+    for (int i = 0; i < node->cond.count && !hasElse; i++) {
+        c->depth = depth;
+        if (node->cond.tests[i] == NULL) {
+            compileNode(c, region, node->cond.bodies[i], tail);
+            hasElse = 1;
+        }
+        else if (node->cond.bodies[i] == NULL) {
+            compileNode(c, region, node->cond.tests[i], 0);
+            exits[exitCount] = emitJump(c, OP_OR, -1);
+            exitCount++;
+        }
+        else {
+            compileNode(c, region, node->cond.tests[i], 0);
+            int next = emitJump(c, OP_JUMP_IF_FALSE, -1);
+            compileNode(c, region, node->cond.bodies[i], tail);
+            exits[exitCount] = emitJump(c, OP_JUMP, 0);
+            exitCount++;
+            patchJump(c, next);
+        }
+    }
+    if (!hasElse) {
+        c->depth = depth;
+        pushConst(c, c->voidValue);
+    }
+    for (int i = 0; i < exitCount; i++) {
+        patchJump(c, exits[i]);
+    }
+}
+
+// compiles node so that it leaves its value on the stack; tail is whether
+// its value is the value of the whole procedure
+void compileNode(Compiler *c, Region *region, Node *node, int tail) {
+    switch (node->kind) {
+     case CONST_NODE: {
+        pushConst(c, node->value);
+        break;
+     }
+     case LOCAL_NODE:
+     case FREE_NODE:
+     case GLOBAL_NODE: {
+        compileVariable(c, region, node);
+        break;
+     }
+     case DEFINE_NODE: {
+        compileNode(c, region, node->assign.expr, 0);
+        compileStore(c, region, node->assign.var, OP_DEFINE_GLOBAL);
+        pushConst(c, c->voidValue);
+        break;
+     }
+     case SET_NODE: {
+        compileNode(c, region, node->assign.expr, 0);
+        compileStore(c, region, node->assign.var, OP_SET_GLOBAL);
+        pushConst(c, c->voidValue);
+        break;
+     }
+     case IF_NODE: {
+        compileNode(c, region, node->branch.test, 0);
+        int alt = emitJump(c, OP_JUMP_IF_FALSE, -1);
+        compileNode(c, region, node->branch.conseq, tail);
+        int end = emitJump(c, OP_JUMP, -1);
+        patchJump(c, alt);
+        compileNode(c, region, node->branch.alt, tail);
+        patchJump(c, end);
+        break;
+     }
+     case LAMBDA_NODE: {
+        int index = compileLambda(c, region, node);
+        emitOp(c, OP_CLOSURE, 1);
+        emit(c, index);
+        for (int i = 0; i < node->lambda.freeCount; i++) {
+            Node *var = node->lambda.freeVars[i];
+            emit(c, var->kind == FREE_NODE ? -1 - var->var.index :
+                                             slotOf(region, var));
+        }
+        break;
+     }
+     case LET_NODE:
+     case LETSTAR_NODE:
+     case LETREC_NODE: {
+        compileLet(c, region, node, tail);
+        break;
+     }
+     case BEGIN_NODE: {
+        compileSequence(c, region, node, tail);
+        break;
+     }
+     case AND_NODE:
+     case OR_NODE: {
+        compileLogical(c, region, node, tail);
+        break;
+     }
+     case COND_NODE: {
+        compileCond(c, region, node, tail);
+        break;
+     }
+     case CALL_NODE:
+     case FIXNUM_CALL_NODE:
+     case FLONUM_CALL_NODE:
+     case NUMERIC_CALL_NODE: {
+        compileNode(c, region, node->call.fn, 0);
+        for (int i = 0; i < node->call.argc; i++) {
+            compileNode(c, region, node->call.args[i], 0);
+        }
+        if (node->call.argc == 2) {
+            emitOp(c, OP_BINARY_CALL, -2);
+            emit(c, addCall(c, node));
+            emit(c, tail);
+            break;
+        }
+        emitOp(c, tail ? OP_TAIL_CALL : OP_CALL, -node->call.argc);
+        emit(c, node->call.argc);
+        break;
+     }
+     default: {
+        emitOp(c, OP_ERROR, 1);
+        emit(c, node->error);
+     }
+    }
+}
+
+// Compiles an analyzed top-level expression into bytecode.
+Code *compile(Node *node) {
+    Compiler *c = makeCompiler(NULL, NULL, countSlots(node));
+    compileNode(c, NULL, node, 1);
+    emitOp(c, OP_RETURN, -1);
+    return c->code;
+}
@@ -0,0 +1,409 @@
+// Hash tables, the equivalence predicates they compare keys with, and the
+// table of interned symbol names.
+
+#include <stdlib.h>
+#include <string.h>
+#include "hashtable.h"
+#include "bignum.h"
+#include "text.h"
+#include "numvector.h"
+#include "linkedlist.h"
+#include "talloc.h"
+
+// slots a new table starts with; capacities are powers of two
+#define INITIAL_CAPACITY 8
+
+// slots of the old array that each operation moves while a table grows
+#define MIGRATE_STEP 8
+
+// how many elements of the lists and vectors in a key, nested ones included,
+// its equal? hash looks at
+#define HASH_ELEMENTS 16
+
+Value deletedKey;
+
+// scrambles the bits of x, so that keys that differ only in a few bits land
+// in far apart slots
+unsigned long mixBits(unsigned long x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9UL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebUL;
+    x ^= x >> 31;
+    return x;
+}
+
+// the FNV-1a hash of length bytes
+unsigned long hashBytes(char *bytes, long length) {
+    unsigned long hash = 0xcbf29ce484222325UL;
+    for (long i = 0; i < length; i++) {
+        hash ^= (unsigned char)bytes[i];
+        hash *= 0x100000001b3UL;
+    }
+    return hash;
+}
+
+// the interned symbol names, in a set with open addressing
+char **symbolNames = NULL;
+int nameCapacity = 0;
+int nameCount = 0;
+
+// returns the slot of slots holding name, or the empty one it belongs in
+int nameSlot(char **slots, int capacity, char *name) {
+    int i = hashBytes(name, strlen(name)) & (capacity - 1);
+    while (slots[i] != NULL && strcmp(slots[i], name)) {
+        i = (i + 1) & (capacity - 1);
+    }
+    return i;
+}
+
+char *intern(char *name) {
+    if (2 * (nameCount + 1) > nameCapacity) {
+        int capacity = nameCapacity ? 2 * nameCapacity : 256;
+        char **slots = calloc(capacity, sizeof(char *));
+        for (int i = 0; i < nameCapacity; i++) {
+            if (symbolNames[i] != NULL) {
+                slots[nameSlot(slots, capacity, symbolNames[i])] = symbolNames[i];
+            }
+        }
+        free(symbolNames);
+        symbolNames = slots;
+        nameCapacity = capacity;
+    }
+    int i = nameSlot(symbolNames, nameCapacity, name);
+    if (symbolNames[i] == NULL) {
+        symbolNames[i] = name;
+        nameCount++;
+    }
+    return symbolNames[i];
+}
+
+int isEq(Value *a, Value *b) {
+    if (a == b) {
+        return 1;
+    }
+    if (a->type != b->type) {
+        return 0;
+    }
+    switch (a->type) {
+     case SYMBOL_TYPE: {
+        return a->s == b->s;
+     }
+     case INT_TYPE:
+     case CHAR_TYPE:
+     case BOOL_TYPE: {
+        return a->i == b->i;
+     }
+     case NULL_TYPE:
+     case VOID_TYPE: {
+        return 1;
+     }
+     default: {
+        return 0;
+     }
+    }
+}
+
+int isEqv(Value *a, Value *b) {
+    if (isEq(a, b)) {
+        return 1;
+    }
+    if (a->type != b->type) {
+        return 0;
+    }
+    if (a->type == DOUBLE_TYPE) {
+        // 0.0 and -0.0 are not eqv?, and a NaN is eqv? to itself
+        return !memcmp(&a->d, &b->d, sizeof(double));
+    }
+    if (a->type == BIGNUM_TYPE) {
+        return integerCompare(a, b) == 0;
+    }
+    return 0;
+}
+
+int isEqual(Value *a, Value *b) {
+    while (a->type == CONS_TYPE && b->type == CONS_TYPE) {
+        if (!isEqual(car(a), car(b))) {
+            return 0;
+        }
+        a = cdr(a);
+        b = cdr(b);
+    }
+    if (isEqv(a, b)) {
+        return 1;
+    }
+    if (a->type != b->type) {
+        return 0;
+    }
+    if (a->type == STR_TYPE) {
+        return stringCompare(a, b) == 0;
+    }
+    if (a->type == F64VECTOR_TYPE || a->type == S64VECTOR_TYPE) {
+        return a->nv.length == b->nv.length &&
+               !memcmp(numVectorData(a), numVectorData(b),
+                       a->nv.length * sizeof(long));
+    }
+    if (a->type == BYTEVECTOR_TYPE) {
+        return a->bv.length == b->bv.length &&
+               !memcmp(a->bv.bytes, b->bv.bytes, a->bv.length);
+    }
+    if (a->type == VECTOR_TYPE) {
+        if (a->vec.length != b->vec.length) {
+            return 0;
+        }
+        for (int i = 0; i < a->vec.length; i++) {
+            if (!isEqual(a->vec.items[i], b->vec.items[i])) {
+                return 0;
+            }
+        }
+        return 1;
+    }
+    return 0;
+}
+
+// returns whether the keys a and b are the same under kind
+int sameKey(keyKind kind, Value *a, Value *b) {
+    if (kind == EQ_KEYS) {
+        return isEq(a, b);
+    }
+    return kind == EQV_KEYS ? isEqv(a, b) : isEqual(a, b);
+}
+
+// returns the hash of key under kind, looking at no more than *budget
+// elements of the lists and vectors in it, so that circular and deeply
+// nested keys hash in bounded time
+unsigned long hashValue(keyKind kind, Value *key, int *budget) {
+    switch (key->type) {
+     case SYMBOL_TYPE: {
+        // interned, so the name's address identifies the symbol
+        return mixBits((unsigned long)key->s);
+     }
+     case INT_TYPE:
+     case CHAR_TYPE:
+     case BOOL_TYPE: {
+        return mixBits(key->i);
+     }
+     case NULL_TYPE:
+     case VOID_TYPE: {
+        return key->type;
+     }
+     case DOUBLE_TYPE: {
+        if (kind == EQ_KEYS) {
+            break;
+        }
+        unsigned long bits;
+        memcpy(&bits, &key->d, sizeof(double));
+        return mixBits(bits);
+     }
+     case BIGNUM_TYPE: {
+        if (kind == EQ_KEYS) {
+            break;
+        }
+        unsigned long hash = key->big.sign;
+        for (int i = 0; i < key->big.length; i++) {
+            hash = mixBits(hash ^ key->big.digits[i]);
+        }
+        return hash;
+     }
+     case STR_TYPE: {
+        if (kind != EQUAL_KEYS) {
+            break;
+        }
+        return hashBytes(stringChars(key), key->str.length);
+     }
+     case CONS_TYPE: {
+        if (kind != EQUAL_KEYS) {
+            break;
+        }
+        unsigned long hash = CONS_TYPE;
+        for (; *budget > 0 && key->type == CONS_TYPE; key = cdr(key)) {
+            (*budget)--;
+            hash = mixBits(hash ^ hashValue(kind, car(key), budget));
+        }
+        return hash;
+     }
+     case F64VECTOR_TYPE:
+     case S64VECTOR_TYPE: {
+        if (kind != EQUAL_KEYS) {
+            break;
+        }
+        return hashBytes(numVectorData(key), key->nv.length * sizeof(long));
+     }
+     case BYTEVECTOR_TYPE: {
+        if (kind != EQUAL_KEYS) {
+            break;
+        }
+        return hashBytes((char *)key->bv.bytes, key->bv.length);
+     }
+     case VECTOR_TYPE: {
+        if (kind != EQUAL_KEYS) {
+            break;
+        }
+        unsigned long hash = key->vec.length;
+        for (int i = 0; *budget > 0 && i < key->vec.length; i++) {
+            (*budget)--;
+            hash = mixBits(hash ^ hashValue(kind, key->vec.items[i], budget));
+        }
+        return hash;
+     }
+     default: {
+        break;
+     }
+    }
+    return mixBits((unsigned long)key);
+}
+
+// returns the hash of key under kind: keys that kind considers the same
+// hash alike
+unsigned long hashKey(keyKind kind, Value *key) {
+    int budget = HASH_ELEMENTS;
+    return hashValue(kind, key, &budget);
+}
+
+// returns a slot array of capacity empty slots; like every other part of a
+// value, it comes from talloc
+Entry *makeSlots(int capacity) {
+    Entry *slots = talloc(capacity * sizeof(Entry));
+    memset(slots, 0, capacity * sizeof(Entry));
+    return slots;
+}
+
+HashTable *makeHashTable(keyKind kind) {
+    HashTable *table = talloc(sizeof(HashTable));
+    table->kind = kind;
+    table->slots = makeSlots(INITIAL_CAPACITY);
+    table->capacity = INITIAL_CAPACITY;
+    table->used = 0;
+    table->old = NULL;
+    table->oldCapacity = 0;
+    table->migrated = 0;
+    table->count = 0;
+    return table;
+}
+
+// returns the entry of key, which has the given hash, in slots, or NULL if
+// it has none
+Entry *findEntry(HashTable *table, Entry *slots, int capacity, Value *key,
+                 unsigned long hash) {
+    int i = hash & (capacity - 1);
+    while (slots[i].key != NULL) {
+        if (slots[i].key != &deletedKey && slots[i].hash == hash &&
+            sameKey(table->kind, slots[i].key, key)) {
+            return &slots[i];
+        }
+        i = (i + 1) & (capacity - 1);
+    }
+    return NULL;
+}
+
+// puts a key that is not in the table yet into its slot array
+void insertEntry(HashTable *table, Value *key, Value *value,
+                 unsigned long hash) {
+    int i = hash & (table->capacity - 1);
+    while (table->slots[i].key != NULL && table->slots[i].key != &deletedKey) {
+        i = (i + 1) & (table->capacity - 1);
+    }
+    if (table->slots[i].key == NULL) {
+        table->used++;
+    }
+    table->slots[i].key = key;
+    table->slots[i].value = value;
+    table->slots[i].hash = hash;
+}
+
+// moves the entries of up to limit slots of the old array to the new one,
+// dropping the old one once they have all moved. A moved entry leaves a
+// deleted one behind, which keeps the old array's probe sequences intact
+// while lookups, deletes and walks no longer see the stale copy.
+void migrate(HashTable *table, int limit) {
+    if (table->old == NULL) {
+        return;
+    }
+    for (; limit > 0 && table->migrated < table->oldCapacity; limit--) {
+        Entry *entry = &table->old[table->migrated++];
+        if (entry->key != NULL && entry->key != &deletedKey) {
+            insertEntry(table, entry->key, entry->value, entry->hash);
+            entry->key = &deletedKey;
+            entry->value = NULL;
+        }
+    }
+    if (table->migrated == table->oldCapacity) {
+        table->old = NULL;
+    }
+}
+
+// starts moving the entries to a new slot array, twice as big if the table
+// is more than half full and otherwise the same size, which drops the
+// deleted entries
+void growTable(HashTable *table) {
+    migrate(table, table->oldCapacity);
+    table->old = table->slots;
+    table->oldCapacity = table->capacity;
+    table->migrated = 0;
+    if (2 * (table->count + 1) > table->capacity) {
+        table->capacity *= 2;
+    }
+    table->slots = makeSlots(table->capacity);
+    table->used = 0;
+}
+
+// returns the entry of key in table, in either slot array, or NULL
+Entry *lookUpEntry(HashTable *table, Value *key, unsigned long hash) {
+    Entry *entry = findEntry(table, table->slots, table->capacity, key, hash);
+    if (entry == NULL && table->old != NULL) {
+        entry = findEntry(table, table->old, table->oldCapacity, key, hash);
+    }
+    return entry;
+}
+
+Value *hashTableRef(HashTable *table, Value *key) {
+    migrate(table, MIGRATE_STEP);
+    Entry *entry = lookUpEntry(table, key, hashKey(table->kind, key));
+    return entry == NULL ? NULL : entry->value;
+}
+
+void hashTableSet(HashTable *table, Value *key, Value *value) {
+    migrate(table, MIGRATE_STEP);
+    unsigned long hash = hashKey(table->kind, key);
+    Entry *entry = lookUpEntry(table, key, hash);
+    if (entry != NULL) {
+        entry->value = value;
+        return;
+    }
+    // keep a quarter of the slots empty, so that probes stay short
+    if (4 * (table->used + 1) > 3 * table->capacity) {
+        growTable(table);
+    }
+    insertEntry(table, key, value, hash);
+    table->count++;
+}
+
+int hashTableDelete(HashTable *table, Value *key) {
+    migrate(table, MIGRATE_STEP);
+    Entry *entry = lookUpEntry(table, key, hashKey(table->kind, key));
+    if (entry == NULL) {
+        return 0;
+    }
+    entry->key = &deletedKey;
+    entry->value = NULL;
+    table->count--;
+    return 1;
+}
+
+// conses the (key . value) pairs of the live entries in slots onto list
+Value *addEntries(Entry *slots, int capacity, Value *list) {
+    for (int i = capacity - 1; i >= 0; i--) {
+        if (slots[i].key != NULL && slots[i].key != &deletedKey) {
+            list = cons(cons(slots[i].key, slots[i].value), list);
+        }
+    }
+    return list;
+}
+
+Value *hashTableEntries(HashTable *table) {
+    Value *list = makeNull();
+    if (table->old != NULL) {
+        list = addEntries(table->old, table->oldCapacity, list);
+    }
+    return addEntries(table->slots, table->capacity, list);
+}
@@ -0,0 +1,60 @@
+#include "value.h"
+
+#ifndef _HASHTABLE
+#define _HASHTABLE
+
+// how a table compares its keys: as eq?, eqv? or equal? do
+typedef enum {EQ_KEYS, EQV_KEYS, EQUAL_KEYS} keyKind;
+
+// A slot of a table. Its key is NULL if the slot was never used, and
+// deletedKey if its entry was deleted.
+typedef struct Entry {
+    Value *key;
+    Value *value;
+    unsigned long hash;
+} Entry;
+
+// A hash table with open addressing and linear probing. Growing it does not
+// move every entry at once: while old is not NULL, the entries of the old
+// slot array move to the new one a few at a time on every later operation,
+// and lookups search both, so no single operation pauses long.
+typedef struct HashTable {
+    keyKind kind;
+    Entry *slots;
+    int capacity;
+    // the live and deleted entries in slots
+    int used;
+    Entry *old;
+    int oldCapacity;
+    // the slots of old below this have moved
+    int migrated;
+    long count;
+} HashTable;
+
+extern Value deletedKey;
+
+// Returns the one copy of the symbol name, so that symbols with the same
+// name have the same string and compare by identity.
+char *intern(char *name);
+
+// The three equivalences of Scheme. Symbols are eq? if their interned names
+// are; numbers, booleans and the empty list are eq? if they are equal, as
+// they would be if they were immediate values.
+int isEq(Value *a, Value *b);
+int isEqv(Value *a, Value *b);
+int isEqual(Value *a, Value *b);
+
+HashTable *makeHashTable(keyKind kind);
+
+// Returns the value of key in table, or NULL if it has none.
+Value *hashTableRef(HashTable *table, Value *key);
+
+void hashTableSet(HashTable *table, Value *key, Value *value);
+
+// Removes key from table, returning whether it was there.
+int hashTableDelete(HashTable *table, Value *key);
+
+// Returns a list of the (key . value) pairs in table.
+Value *hashTableEntries(HashTable *table);
+
+#endif
@@ -5,17 +5,192 @@
 #include <math.h>
 #include <string.h>
 #include <assert.h>
+#include <setjmp.h>
+#include <limits.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include "interpreter.h"
+#include "bignum.h"
+#include "hashtable.h"
+#include "text.h"
+#include "numvector.h"
+#include "bytevector.h"
 #include "tokenizer.h"
 #include "value.h"
 #include "linkedlist.h"
 #include "talloc.h"
 #include "parser.h"
+#include "analyzer.h"
+#include "vm.h"
+#include "jit.h"
 
-// prints error message and exits
+// frames are taken from a region of this many bytes, in stack order
+#define FRAME_REGION_SIZE (1 << 23)
+
+// evaluation may nest this deep unless --max-depth says otherwise
+#define DEFAULT_MAX_DEPTH 10000000
+
+// bytes of C stack set aside for each level of nesting
+#define STACK_PER_DEPTH 256
+
+// evaluation stops this many bytes short of the end of its C stack
+#define STACK_MARGIN (1 << 16)
+
+// a call node whose specialization failed this often stays generic
+#define MAX_DEOPTS 2
+
+// the fixnums the specialized operations return without allocating
+#define SHARED_INT_MIN -256
+#define SHARED_INT_MAX 1023
+
+// the frame region, in use up to frameTop
+char *frameRegion = NULL;
+size_t frameTop = 0;
+
+int maxDepth = DEFAULT_MAX_DEPTH;
+
+// how deep evalNode calls are nested, and how far down the C stack they may
+// go; evalStackLimit is NULL while evaluation runs on the usual C stack
+int evalDepth = 0;
+char *evalStackLimit = NULL;
+
+// Errors are raised as error objects. raise hands them to the innermost
+// handler installed by with-exception-handler, or unwinds the C stack with
+// longjmp to the innermost error frame: a guard, or the top level, which
+// reports the error and goes on with the next form.
+typedef struct ErrorFrame {
+    jmp_buf jump;
+    // the condition raised, or the value passed to the escape procedure
+    Value *condition;
+    // the escape procedure of a call/ec, which unwinds to the frame
+    Value *escape;
+    // what to restore when unwinding to the frame
+    Value *handlers;
+    size_t frameTop;
+    int evalDepth;
+    VmMark vm;
+    struct ErrorFrame *parent;
+} ErrorFrame;
+
+ErrorFrame *errorFrame = NULL;
+
+// the installed handlers, innermost first; a guard's entry is a PTR_TYPE
+// value pointing to its error frame
+Value *handlers = NULL;
+
+// how many top-level forms raised an error that nothing caught
+int uncaughtErrors = 0;
+
+// returns a new ERROR_TYPE value struct; code is the number of an error of
+// the interpreter's own, or 0 for one raised by error
+Value *makeErrorObject(int code, Value *message, Value *irritants) {
+    Value *value = makeNull();
+    value->type = ERROR_TYPE;
+    value->err.code = code;
+    value->err.message = message;
+    value->err.irritants = irritants;
+    return value;
+}
+
+// prints an error that nothing caught
+void reportError(Value *condition) {
+    if (condition->type != ERROR_TYPE) {
+        printf("An uncaught exception was raised: ");
+        printVal(condition);
+        printf("\n");
+        return;
+    }
+    if (condition->err.code == 0) {
+        Value *message = condition->err.message;
+        printf("An error occurred: ");
+        if (message->type == STR_TYPE) {
+            // without quotes, as display would show it
+            printf("%.*s", (int)message->str.length, stringChars(message));
+        }
+        else {
+            printVal(message);
+        }
+        for (Value *irritant = condition->err.irritants;
+             irritant->type == CONS_TYPE; irritant = cdr(irritant)) {
+            printf(" ");
+            printVal(car(irritant));
+        }
+        printf("\n");
+        return;
+    }
+    for (Value *irritant = condition->err.irritants;
+         irritant->type == CONS_TYPE; irritant = cdr(irritant)) {
+        printVal(car(irritant));
+        printf("\n");
+    }
+    printf("An error occurred during interpretation at: %i\n",
+           condition->err.code);
+}
+
+// sets up frame as the innermost error frame, saving the state to restore
+// when an error unwinds to it
+void pushErrorFrame(ErrorFrame *frame) {
+    frame->escape = NULL;
+    frame->handlers = handlers;
+    frame->frameTop = frameTop;
+    frame->evalDepth = evalDepth;
+    frame->vm = vmMark();
+    frame->parent = errorFrame;
+    errorFrame = frame;
+}
+
+void popErrorFrame(ErrorFrame *frame) {
+    handlers = frame->handlers;
+    errorFrame = frame->parent;
+}
+
+// unwinds to frame, which then gets condition
+void unwindTo(ErrorFrame *frame, Value *condition) {
+    handlers = frame->handlers;
+    frameTop = frame->frameTop;
+    evalDepth = frame->evalDepth;
+    vmUnwind(frame->vm);
+    errorFrame = frame;
+    frame->condition = condition;
+    longjmp(frame->jump, 1);
+}
+
+// Raises condition. A handler installed by with-exception-handler is called
+// on it, with the handlers outside it installed; if continuable is set,
+// what the handler returns is returned, and otherwise the handler returning
+// is an error of its own.
+Value *raiseCondition(Value *condition, int continuable) {
+    if (handlers == NULL || handlers->type != CONS_TYPE) {
+        if (errorFrame == NULL) {
+            reportError(condition);
+            texit(1);
+        }
+        // the top level's error frame
+        while (errorFrame->parent != NULL) {
+            errorFrame = errorFrame->parent;
+        }
+        unwindTo(errorFrame, condition);
+    }
+    Value *handler = car(handlers);
+    if (handler->type == PTR_TYPE) {
+        unwindTo(handler->p, condition);
+    }
+    Value *outer = handlers;
+    handlers = cdr(handlers);
+    Value *result = apply(handler, 1, &condition);
+    if (continuable) {
+        handlers = outer;
+        return result;
+    }
+    handleInterpError(185);
+    return NULL;
+}
+
+// raises error i of the interpreter's own
 void handleInterpError(int i) {
-    printf("An error occurred during interpretation at: %i\n", i);
-    texit(0);
+    Value *message = makeString("interpreter error");
+    raiseCondition(makeErrorObject(i, message, makeNull()), 0);
 }
 
 // returns a new VOID_TYPE value struct
@@ -25,16 +200,68 @@ Value *makeVoid() {
     return value;
 }
 
-// returns a new CLOSURE_TYPE value struct with passed attributes
-Value *makeClosure(Value *params, Value *fxnCode, Frame *fram){
+// returns the frame that holds the local variable referred to by node
+Frame *frameOf(Node *node, Frame *frame) {
+    for (int i = 0; i < node->var.depth; i++) {
+        frame = frame->parent;
+    }
+    return frame;
+}
+
+// returns the value in the slot of a local or free variable, or its box if
+// it is boxed
+Value *rawVariable(Node *node, Frame *frame) {
+    if (node->kind == FREE_NODE) {
+        return frame->freeVars[node->var.index];
+    }
+    return frameOf(node, frame)->slots[node->var.index];
+}
+
+// returns a new CLOSURE_TYPE value struct with passed attributes, capturing
+// the free variables of lambda from fram
+Value *makeClosure(Node *lambda, Frame *fram){
     Value *value = makeNull();
     value->type = CLOSURE_TYPE;
-    if (!(params) || !(fxnCode) || !(fram)){
+    if (!(lambda) || !(fram)){
         handleInterpError(1);
     }
-    value->cl.paramNames = params;
-    value->cl.functionCode = fxnCode;
+    value->cl.freeVars = talloc(lambda->lambda.freeCount * sizeof(Value *));
+    for (int i = 0; i < lambda->lambda.freeCount; i++) {
+        value->cl.freeVars[i] = rawVariable(lambda->lambda.freeVars[i], fram);
+    }
+    while (fram->parent != NULL) {
+        fram = fram->parent;
+    }
+    value->cl.lambda = lambda;
     value->cl.frame = fram;
+    value->cl.code = NULL;
+    value->cl.compiled = NULL;
+    return value;
+}
+
+// returns a new BOX_TYPE value struct holding value
+Value *makeBox(Value *value) {
+    Value *box = makeNull();
+    box->type = BOX_TYPE;
+    box->box = value;
+    return box;
+}
+
+// replaces the variables in the slots that boxed flags with boxes holding
+// them
+void boxSlots(char *boxed, Value **slots, int size) {
+    for (int i = 0; boxed != NULL && i < size; i++) {
+        if (boxed[i]) {
+            slots[i] = makeBox(slots[i]);
+        }
+    }
+}
+
+// returns a new DOUBLE_TYPE value struct holding d
+Value *makeDouble(double d) {
+    Value *value = makeNull();
+    value->type = DOUBLE_TYPE;
+    value->d = d;
     return value;
 }
 
@@ -61,24 +288,57 @@ Frame *makeFirstFrame() {
     Frame *newFrame = talloc(sizeof(Frame));
     newFrame->parent = NULL;
     newFrame->bindings = makeNull();
+    newFrame->slots = NULL;
+    newFrame->size = 0;
+    newFrame->freeVars = NULL;
     return newFrame;
 }
 
-// creates a new frame, with its parent as a parameter
-Frame *makeNewFrame(Frame *parent) {
-    Frame *newFrame = talloc(sizeof(Frame));
-    newFrame->bindings = makeNull();
+// sets up newFrame, with its parent as a parameter, to hold its variables in
+// the size entries of slots; it sees the free variables its parent sees
+Frame *initFrame(Frame *newFrame, Frame *parent, Value **slots, int size) {
+    newFrame->bindings = NULL;
+    newFrame->slots = slots;
+    newFrame->size = size;
+    newFrame->freeVars = parent->freeVars;
     newFrame->parent = parent;
     return newFrame;
 }
 
-// adds a binding consisting of a symbol and result to the current
-// list of bindings, which is the parameter 'bindingList'
-// returns the new list of bindings
-Value *addBinding(Value *symbol, Value *result, Value *bindingList) {
-    Value *cell1 = cons(symbol, result);
-    Value *cell2 = cons(cell1, bindingList);
-    return cell2;
+// returns size bytes of the frame region, which are handed back by resetting
+// frameTop to what it was before; if the region is full, they are talloc'd
+void *pushRegion(size_t size) {
+    if (frameRegion == NULL) {
+        frameRegion = talloc(FRAME_REGION_SIZE);
+    }
+    if (frameTop + size > FRAME_REGION_SIZE) {
+        return talloc(size);
+    }
+    void *pointer = frameRegion + frameTop;
+    frameTop += size;
+    return pointer;
+}
+
+// returns a new frame, with its parent as a parameter, whose size slots
+// follow it in the frame region
+Frame *pushFrame(Frame *parent, int size) {
+    Frame *frame = pushRegion(sizeof(Frame) + size * sizeof(Value *));
+    return initFrame(frame, parent, (Value **)(frame + 1), size);
+}
+
+// moves frame, the last one pushed, down to offset mark of the frame region,
+// dropping every frame pushed between them
+Frame *replaceFrames(Frame *frame, size_t mark) {
+    if ((char *)frame < frameRegion ||
+        (char *)frame >= frameRegion + FRAME_REGION_SIZE) {
+        frameTop = mark;
+        return frame;
+    }
+    size_t size = sizeof(Frame) + frame->size * sizeof(Value *);
+    Frame *moved = memmove(frameRegion + mark, frame, size);
+    moved->slots = (Value **)(moved + 1);
+    frameTop = mark + size;
+    return moved;
 }
 
 // prints a value, provided that it is an int, double, boolean, string,
@@ -92,8 +352,63 @@ void printVal(Value *val) {
         printf("#<procedure>");
         break;
     }
+     case CONTINUATION_TYPE: {
+        printf("#<continuation>");
+        break;
+     }
+     case HASH_TABLE_TYPE: {
+        printf("#<hash-table>");
+        break;
+     }
+     case PROMISE_TYPE: {
+        printf("#<promise>");
+        break;
+     }
+     case PORT_TYPE: {
+        printf("#<input-port>");
+        break;
+     }
+     case EOF_TYPE: {
+        printf("#<eof>");
+        break;
+     }
+     case F64VECTOR_TYPE:
+     case S64VECTOR_TYPE: {
+        printf(val->type == F64VECTOR_TYPE ? "#f64(" : "#s64(");
+        for (long i = 0; i < val->nv.length; i++) {
+            if (i > 0) {
+                printf(" ");
+            }
+            if (val->type == F64VECTOR_TYPE) {
+                printf("%f", val->nv.f64[i]);
+            }
+            else {
+                printf("%li", val->nv.s64[i]);
+            }
+        }
+        printf(")");
+        break;
+     }
+     case BYTEVECTOR_TYPE: {
+        printf("#u8(");
+        for (long i = 0; i < val->bv.length; i++) {
+            printf(i > 0 ? " %d" : "%d", val->bv.bytes[i]);
+        }
+        printf(")");
+        break;
+     }
+     case ERROR_TYPE: {
+        printf("#<error ");
+        printVal(val->err.message);
+        printf(">");
+        break;
+     }
      case INT_TYPE: {
-        printf("%i", val->i);
+        printf("%li", val->i);
+        break;
+     }
+     case BIGNUM_TYPE: {
+        printf("%s", integerToString(val));
         break;
      }
      case DOUBLE_TYPE: {
@@ -109,8 +424,9 @@ void printVal(Value *val) {
         }
         break;
      }
-     case STR_TYPE: {
-        printf("%s", val->s);
+     case STR_TYPE:
+     case CHAR_TYPE: {
+        writeText(stdout, val);
         break;
      }
      case SYMBOL_TYPE: {
@@ -138,6 +454,17 @@ void printVal(Value *val) {
         printf("()");
         break;
      }
+     case VECTOR_TYPE: {
+        printf("#(");
+        for (int i = 0; i < val->vec.length; i++) {
+            if (i > 0) {
+                printf(" ");
+            }
+            printVal(val->vec.items[i]);
+        }
+        printf(")");
+        break;
+     }
      default: {
         //otherwise throw an error
         handleInterpError(3);
@@ -145,110 +472,116 @@ void printVal(Value *val) {
     }
 }
 
-// looks up a symbol in the frame bindings and returns the value
-// associated with that symbol
-Value *lookUpSymbol(Value *expr, Frame *frame) {
-    assert(expr->type == SYMBOL_TYPE);
-    assert(frame);
-    Value *bindings;
-    while(frame != NULL) {
-        bindings = frame->bindings;
-        while (bindings->type != NULL_TYPE) {
-            if (!strcmp(car(car(bindings))->s, expr->s)) {
-                expr = cdr(car(bindings));
-                return expr;
-            }
-            bindings = cdr(bindings);
-        }
-        frame = frame->parent;
-    }
-    printVal(expr);
-    printf("\n");
-    handleInterpError(2); //couldnt find symbol
-    return NULL;
-}
-
-// checks if a symbol is assigned to a primitive or not
-int isPrimitive(Value *symbol, Frame *frame) {
-    assert(symbol); assert(symbol->type == SYMBOL_TYPE);
+// looks up the (symbol . value) binding of symbol in the global frame, the
+// root of frame's chain; returns NULL if there is none
+Value *lookUpGlobal(Value *symbol, Frame *frame) {
     while (frame->parent != NULL) {
         frame = frame->parent;
     }
     Value *bindings = frame->bindings;
     while (bindings->type != NULL_TYPE) {
         if (!strcmp(car(car(bindings))->s, symbol->s)) {
-            if (cdr(car(bindings))->type == PRIMITIVE_TYPE) {
-                return 1;
-            }
-            else {
-                return 0;
-            }
+            return car(bindings);
         }
         bindings = cdr(bindings);
     }
-    return 0;
+    return NULL;
+}
+
+// returns the global binding a GLOBAL_NODE refers to, caching it in the node;
+// NULL if the variable is unbound
+Value *resolveGlobal(Node *var, Frame *frame) {
+    if (var->var.binding == NULL) {
+        var->var.binding = lookUpGlobal(var->var.symbol, frame);
+    }
+    return var->var.binding;
+}
+
+// binds the global variable of a GLOBAL_NODE to value, adding it to the
+// global frame if it is not bound yet
+void defineGlobal(Node *var, Value *value, Frame *frame) {
+    if (resolveGlobal(var, frame) == NULL) {
+        while (frame->parent != NULL) {
+            frame = frame->parent;
+        }
+        var->var.binding = cons(var->var.symbol, value);
+        frame->bindings = cons(var->var.binding, frame->bindings);
+    }
+    var->var.binding->c.cdr = value;
+}
+
+// reports a reference to a variable that has no value
+void handleUnbound(Value *symbol) {
+    //couldnt find symbol
+    raiseCondition(makeErrorObject(2, makeString("unbound variable"),
+                          cons(symbol, makeNull())), 0);
 }
 
 // binds a primitive symbols to its C code
-void bindPrim(char *name, Value *(*function)(struct Value *), Frame *frame) {
+void bindPrim(char *name, Value *(*function)(int, struct Value **),
+              Frame *frame) {
     Value *value = talloc(sizeof(Value));
     value->type = PRIMITIVE_TYPE;
     value->pf = function;
-    Value *symbol = talloc(sizeof(Value));
-    symbol->type = STR_TYPE;
-    symbol->s = name;
-    Value *cell1 = cons(symbol, value);
+    Value *cell1 = cons(makeSymbol(name), value);
     Value *cell2 = cons(cell1, frame->bindings);
     frame->bindings = cell2;
 }
 
 /*** PRIMITIVE FUNCTION CODE ***/
 // these functions are bound to primitives at the beginning of interpret
-// to allow access to them at all stages of scheme code interpretation
+// to allow access to them at all stages of scheme code interpretation;
+// each receives its evaluated arguments as an array argv of length argc
 
-Value *primitiveAdd(Value *args) {
-    if (!(args) || args->type != CONS_TYPE) {
-        if (args->type == NULL_TYPE) {
-            args->type = DOUBLE_TYPE;
-            args->d = 0;
-            return args;
-        }
-        else {
-            handleInterpError(7);
-        }
+// returns the number value as a double, reporting error if it is not a
+// number
+double toDouble(Value *value, int error) {
+    if (isExactInteger(value)) {
+        return integerToDouble(value);
     }
-    else {
-        Value *current = args;
-        Value *sum = makeNull();
-        sum->type = DOUBLE_TYPE;
-        sum->d = 0.0;
-        while (current->type != NULL_TYPE) {
-            if (current->type != CONS_TYPE) {
-                handleInterpError(8);
-            }
-            if (car(current)->type == INT_TYPE) {
-                sum->d += car(current)->i;
-            }
-            else if (car(current)->type == DOUBLE_TYPE) {
-                sum->d += car(current)->d;
-            }
-            else {
-                handleInterpError(9);
-            }
-            current = cdr(current);
-        }
-        return sum;
+    if (value->type != DOUBLE_TYPE) {
+        handleInterpError(error);
     }
-    return makeNull();
+    return value->d;
 }
 
-Value *primitiveNull(Value *args) {
-    if (!args || !(args->type == CONS_TYPE) || !(cdr(args)->type == NULL_TYPE)) {
+// Sums, differences and products are exact while every operand is an
+// integer, and become inexact from the first double operand on. They stay
+// in fixnums until a result overflows, and go on in bignums from there.
+Value *primitiveAdd(int argc, Value **argv) {
+    long sum = 0;
+    int i = 0;
+    for (; i < argc && argv[i]->type == INT_TYPE; i++) {
+        long next;
+        if (__builtin_add_overflow(sum, argv[i]->i, &next)) {
+            break;
+        }
+        sum = next;
+    }
+    if (i == argc) {
+        return makeInt(sum);
+    }
+    Value *exact = makeInt(sum);
+    for (; i < argc && isExactInteger(argv[i]); i++) {
+        exact = integerAdd(exact, argv[i]);
+    }
+    if (i == argc) {
+        return exact;
+    }
+    double total = integerToDouble(exact);
+    for (; i < argc; i++) {
+        total += toDouble(argv[i], 9);
+    }
+    return makeDouble(total);
+}
+
+Value *primitiveNull(int argc, Value **argv) {
+    if (argc != 1) {
         handleInterpError(10);
     }
     Value *ret = talloc(sizeof(Value));
     ret->type = BOOL_TYPE;
-    if (car(args)->type == NULL_TYPE) {
+    if (argv[0]->type == NULL_TYPE) {
         ret->i = 1;
     }
     else {
@@ -257,434 +590,2290 @@ Value *primitiveNull(Value *args) {
     return ret;
 }
 
-Value *primitiveCar(Value *args) {
+Value *primitiveCar(int argc, Value **argv) {
     // are all cases problems?
-    if (!args ||
-        args->type != CONS_TYPE ||
-        !(car(args)) || 
-        car(args)->type != CONS_TYPE ||
-        !(car(car(args))) ||
-        car(car(args))->type == NULL_TYPE) {
+    if (argc < 1 ||
+        argv[0]->type != CONS_TYPE ||
+        !(car(argv[0])) ||
+        car(argv[0])->type == NULL_TYPE) {
         
         handleInterpError(11);
     }
-    return car(car(args));
+    return car(argv[0]);
 }
 
-Value *primitiveCdr(Value *args) {
-    if (!args || !(args->type == CONS_TYPE)) {
+Value *primitiveCdr(int argc, Value **argv) {
+    if (argc < 1) {
         handleInterpError(12);
     }
-    Value *temp = cdr(car(args));
-    return cdr(car(args));
+    return cdr(argv[0]);
 }
 
-Value *primitiveCons(Value *args) {
-    if (!args || !(args->type == CONS_TYPE)) {
+Value *primitiveCons(int argc, Value **argv) {
+    if (argc < 1) {
         handleInterpError(13);
     }
-    if (length(args) != 2) {
+    if (argc != 2) {
         handleInterpError(14);
     }
-    Value *c = car(args);
-    Value *cd = car(cdr(args));
-    return cons(c, cd);
+    return cons(argv[0], argv[1]);
 }
 
-Value *primitiveSub(Value *args) {
-    if (!(args) || args->type != CONS_TYPE) {
-        if (args->type == NULL_TYPE) {
-            args->type = DOUBLE_TYPE;
-            args->d = 0.0;
-            return args;
-        }
-        else {
-            handleInterpError(15);
+Value *primitiveSub(int argc, Value **argv) {
+    // if more than one argument, subtract the rest from the first
+    if (argc > 1 && argv[0]->type == DOUBLE_TYPE) {
+        double total = argv[0]->d;
+        for (int i = 1; i < argc; i++) {
+            total -= toDouble(argv[i], 19);
         }
+        return makeDouble(total);
     }
-    else {
-        Value *current = args;
-        Value *sum = makeNull();
-        sum->type = DOUBLE_TYPE;
-        sum->d = 0.0;
-        // if more than one argument
-        if (cdr(current)->type != NULL_TYPE) {
-            if (current->type != CONS_TYPE) {
-                handleInterpError(16);
-            }
-            if (car(current)->type == INT_TYPE) {
-                sum->d += car(current)->i;
-            }
-            else if (car(current)->type == DOUBLE_TYPE) {
-                sum->d += car(current)->d;
-            }
-            else {
-                handleInterpError(17);
-            }
-            current = cdr(current);
-        }
-        while (current->type != NULL_TYPE) {
-            if (current->type != CONS_TYPE) {
-                handleInterpError(18);
-            }
-            if (car(current)->type == INT_TYPE) {
-                sum->d -= car(current)->i;
-            }
-            else if (car(current)->type == DOUBLE_TYPE) {
-                sum->d -= car(current)->d;
-            }
-            else {
-                handleInterpError(19);
-            }
-            current = cdr(current);
+    if (argc > 1 && !isExactInteger(argv[0])) {
+        handleInterpError(17);
+    }
+    long difference = 0;
+    int i = 0;
+    if (argc > 1 && argv[0]->type == INT_TYPE) {
+        difference = argv[0]->i;
+        i = 1;
+    }
+    for (; i < argc && argv[i]->type == INT_TYPE; i++) {
+        long next;
+        if (__builtin_sub_overflow(difference, argv[i]->i, &next)) {
+            break;
         }
-        return sum;
+        difference = next;
+    }
+    if (i == argc) {
+        return makeInt(difference);
+    }
+    Value *exact = makeInt(difference);
+    if (i == 0 && argc > 1) {
+        exact = argv[0];
+        i = 1;
     }
-    return makeNull();
+    for (; i < argc && isExactInteger(argv[i]); i++) {
+        exact = integerSub(exact, argv[i]);
+    }
+    if (i == argc) {
+        return exact;
+    }
+    double total = integerToDouble(exact);
+    for (; i < argc; i++) {
+        total -= toDouble(argv[i], 19);
+    }
+    return makeDouble(total);
 }
 
-Value *primitiveMult(Value *args) {
-    if (!(args) || args->type != CONS_TYPE) {
-        if (args->type == NULL_TYPE) {
-            args->type = DOUBLE_TYPE;
-            args->d = 1.0;
-            return args;
-        }
-        else {
-            handleInterpError(20);
+Value *primitiveMult(int argc, Value **argv) {
+    long product = 1;
+    int i = 0;
+    for (; i < argc && argv[i]->type == INT_TYPE; i++) {
+        long next;
+        if (__builtin_mul_overflow(product, argv[i]->i, &next)) {
+            break;
         }
+        product = next;
     }
-    else {
-        Value *current = args;
-        Value *sum = makeNull();
-        sum->type = DOUBLE_TYPE;
-        sum->d = 1.0;
-        while (current->type != NULL_TYPE) {
-            if (current->type != CONS_TYPE) {
-                handleInterpError(21);
-            }
-            if (car(current)->type == INT_TYPE) {
-                sum->d *= car(current)->i;
-            }
-            else if (car(current)->type == DOUBLE_TYPE) {
-                sum->d *= car(current)->d;
-            }
-            else {
-                handleInterpError(22);
-            }
-            current = cdr(current);
-        }
-        return sum;
+    if (i == argc) {
+        return makeInt(product);
     }
-    return makeNull();
+    Value *exact = makeInt(product);
+    for (; i < argc && isExactInteger(argv[i]); i++) {
+        exact = integerMul(exact, argv[i]);
+    }
+    if (i == argc) {
+        return exact;
+    }
+    double total = integerToDouble(exact);
+    for (; i < argc; i++) {
+        total *= toDouble(argv[i], 22);
+    }
+    return makeDouble(total);
 }
 
-Value *primitiveDiv(Value *args) {
+Value *primitiveDiv(int argc, Value **argv) {
     // errors if no arguments passed
-    if (!(args) || args->type != CONS_TYPE) {
-            handleInterpError(23);
+    if (argc < 1) {
+        handleInterpError(23);
     }
-    else {
-        Value *current = cdr(args);
-        Value *sum = makeNull();
-        sum->type = DOUBLE_TYPE;
-        if (car(args)->type == INT_TYPE) {
-            sum->d = (double)car(args)->i;
-        }
-        else if (car(args)->type == DOUBLE_TYPE) {
-            sum->d = car(args)->d;
-        }
-        else {
-            handleInterpError(24);
-        }
-        while (current->type != NULL_TYPE) {
-            if (current->type != CONS_TYPE) {
-                handleInterpError(24);
-            }
-            if (car(current)->type == INT_TYPE) {
-                sum->d *= 1 / (double)(car(current)->i);
-            }
-            else if (car(current)->type == DOUBLE_TYPE) {
-                sum->d *= 1 / (car(current)->d);
-            }
-            else {
-                handleInterpError(25);
-            }
-            current = cdr(current);
-        }
-        return sum;
+    double quotient = toDouble(argv[0], 24);
+    for (int i = 1; i < argc; i++) {
+        quotient *= 1 / toDouble(argv[i], 25);
     }
-    return makeNull();
+    return makeDouble(quotient);
 }
 
-Value *primitiveMod(Value *args) {
-    if (length(args) != 2) {
-        handleInterpError(26);
-    }
-    Value *val1 = car(args);
-    Value *val2 = car(cdr(args));
-    int num1;
-    int num2;
-    
-    if (val1->type == INT_TYPE) {
-        num1 = val1->i;
-    }
-    else if (val1->type == DOUBLE_TYPE) {
-        if (val1->d - (int)(val1->d) == 0) {
-            num1 = val1->d;
+// returns whether d is a whole number
+int isIntegral(double d) {
+    if (d != d || d - d != 0) {
+        // NaN or infinite
+        return 0;
+    }
+    // doubles this big have no fraction bits
+    return d >= 4503599627370496.0 || d <= -4503599627370496.0 ||
+           d == (long)d;
+}
+
+// applies divide, an integer division, to the two operands of quotient,
+// remainder or modulo: exact integers, or integral doubles, which make the
+// result inexact; if floored, a remainder takes the sign of the divisor
+Value *divideOperands(int argc, Value **argv,
+                      Value *(*divide)(Value *, Value *), int floored,
+                      int error) {
+    if (argc != 2) {
+        handleInterpError(error);
+    }
+    Value *operands[2];
+    int inexact = 0;
+    for (int i = 0; i < 2; i++) {
+        if (isExactInteger(argv[i])) {
+            operands[i] = argv[i];
+        }
+        else if (argv[i]->type == DOUBLE_TYPE && isIntegral(argv[i]->d)) {
+            operands[i] = integerFromDouble(argv[i]->d);
+            inexact = 1;
         }
         else {
-            handleInterpError(27);
+            handleInterpError(error + 1);
         }
     }
+    if (integerSign(operands[1]) == 0) {
+        handleInterpError(error + 2);
+    }
+    Value *result;
+    Value *a = operands[0];
+    Value *b = operands[1];
+    if (a->type == INT_TYPE && b->type == INT_TYPE &&
+        !(a->i == LONG_MIN && b->i == -1)) {
+        // the common case needs no bignums
+        result = divide == integerQuotient ? makeInt(a->i / b->i)
+                                           : makeInt(a->i % b->i);
+    }
     else {
-        handleInterpError(28);
+        result = divide(a, b);
     }
-    
-    if (val2->type == INT_TYPE) {
-        num2 = val2->i;
+    if (floored && integerSign(result) != 0 &&
+        integerSign(result) != integerSign(b)) {
+        result = integerAdd(result, b);
     }
-    else if (val2->type == DOUBLE_TYPE) {
-        if (val2->d - (int)(val2->d) == 0) {
-            num2 = val2->d;
-        }
-        else {
-            handleInterpError(29);
-        }
+    return inexact ? makeDouble(integerToDouble(result)) : result;
+}
+
+Value *primitiveQuotient(int argc, Value **argv) {
+    return divideOperands(argc, argv, integerQuotient, 0, 194);
+}
+
+// the remainder has the sign of the dividend
+Value *primitiveRemainder(int argc, Value **argv) {
+    return divideOperands(argc, argv, integerRemainder, 0, 194);
+}
+
+// the modulo has the sign of the divisor
+Value *primitiveMod(int argc, Value **argv) {
+    return divideOperands(argc, argv, integerRemainder, 1, 26);
+}
+
+Value *primitiveAbs(int argc, Value **argv) {
+    if (argc != 1) {
+        handleInterpError(197);
     }
-    else {
-        handleInterpError(30);
+    if (isExactInteger(argv[0])) {
+        return integerSign(argv[0]) < 0 ? integerNegate(argv[0]) : argv[0];
     }
+    double d = toDouble(argv[0], 198);
+    return d < 0 ? makeDouble(-d) : argv[0];
+}
 
-    Value *result = makeNull();
-    result->type = INT_TYPE;
-    result->i = num1 % num2;
-    return result;
+// comparisons of two numbers yield this when either is NaN
+#define UNORDERED 2
+
+// compares the numbers a and b, returning -1, 0 or 1 as a is less than,
+// equal to or greater than b, or UNORDERED; integers are compared exactly,
+// and as doubles only against a double
+int compareNumbers(Value *a, Value *b, int error) {
+    if (isExactInteger(a) && isExactInteger(b)) {
+        return integerCompare(a, b);
+    }
+    double x = toDouble(a, error);
+    double y = toDouble(b, error);
+    if (x != x || y != y) {
+        return UNORDERED;
+    }
+    return (x > y) - (x < y);
 }
 
-Value *primitiveLess(Value *args) {
-    if (length(args) < 2) {
-        handleInterpError(31);
+// the least (or with greatest set, greatest) of the numbers, inexact if any
+// of them is
+Value *extremum(int argc, Value **argv, int greatest, int error) {
+    if (argc < 1) {
+        handleInterpError(error);
     }
-    Value *first = car(args);
-    double num1;
-    if (first->type == INT_TYPE) {
-        num1 = first->i;
+    Value *best = argv[0];
+    int inexact = 0;
+    for (int i = 0; i < argc; i++) {
+        int order = compareNumbers(argv[i], best, error + 1);
+        if (order == (greatest ? 1 : -1)) {
+            best = argv[i];
+        }
+        if (argv[i]->type == DOUBLE_TYPE) {
+            inexact = 1;
+        }
     }
-    else if (first->type == DOUBLE_TYPE) {
-        num1 = first->d;
+    if (inexact && isExactInteger(best)) {
+        return makeDouble(integerToDouble(best));
     }
-    else {
-        handleInterpError(32);
+    return best;
+}
+
+Value *primitiveMin(int argc, Value **argv) {
+    return extremum(argc, argv, 0, 199);
+}
+
+Value *primitiveMax(int argc, Value **argv) {
+    return extremum(argc, argv, 1, 199);
+}
+
+Value *primitiveLess(int argc, Value **argv) {
+    if (argc < 2) {
+        handleInterpError(31);
     }
-    
-    Value *comps = cdr(args);
-    Value *num;
-    double compNum;
+    toDouble(argv[0], 32);
     int boolean = 1;
-    for (int i = 0; i < length(cdr(args)); i++) {
-        num = car(comps);
-        if (num->type == INT_TYPE) {
-            compNum = num->i;
-        }
-        else if (num->type == DOUBLE_TYPE) {
-            compNum = num->d;
-        }
-        else {
-            handleInterpError(33);
-        }
-        if (num1 >= compNum) {
+    for (int i = 1; i < argc; i++) {
+        int order = compareNumbers(argv[0], argv[i], 33);
+        if (order >= 0 && order != UNORDERED) {
             boolean = 0;
         }
-        comps = cdr(comps);
-    }
-        
-    if (boolean == 0) {
-        return makeFalse();
-    }
-    else {
-        return makeTrue();
     }
+    return boolean ? makeTrue() : makeFalse();
 }
 
-Value *primitiveGreater(Value *args) {
-    if (length(args) < 2) {
+Value *primitiveGreater(int argc, Value **argv) {
+    if (argc < 2) {
         handleInterpError(34);
     }
-    Value *first = car(args);
-    double num1;
-    if (first->type == INT_TYPE) {
-        num1 = first->i;
-    }
-    else if (first->type == DOUBLE_TYPE) {
-        num1 = first->d;
-    }
-    else {
-        handleInterpError(35);
-    }
-    
-    Value *comps = cdr(args);
-    Value *num;
-    double compNum;
+    toDouble(argv[0], 35);
     int boolean = 1;
-    for (int i = 0; i < length(cdr(args)); i++) {
-        num = car(comps);
-        if (num->type == INT_TYPE) {
-            compNum = num->i;
-        }
-        else if (num->type == DOUBLE_TYPE) {
-            compNum = num->d;
-        }
-        else {
-            handleInterpError(36);
-        }
-        if (num1 <= compNum) {
+    for (int i = 1; i < argc; i++) {
+        int order = compareNumbers(argv[0], argv[i], 36);
+        if (order <= 0) {
             boolean = 0;
         }
-        comps = cdr(comps);
-    }
-        
-    if (boolean == 0) {
-        return makeFalse();
-    }
-    else {
-        return makeTrue();
     }
+    return boolean ? makeTrue() : makeFalse();
 }
 
-Value *primitiveEqual(Value *args) {
-    if (length(args) < 2) {
+Value *primitiveEqual(int argc, Value **argv) {
+    if (argc < 2) {
         handleInterpError(37);
     }
-    Value *first = car(args);
-    double num1;
-    if (first->type == INT_TYPE) {
-        num1 = first->i;
-    }
-    else if (first->type == DOUBLE_TYPE) {
-        num1 = first->d;
-    }
-    else {
-        handleInterpError(38);
-    }
-    
-    Value *comps = cdr(args);
-    Value *num;
-    double compNum;
+    toDouble(argv[0], 38);
     int boolean = 1;
-    for (int i = 0; i < length(cdr(args)); i++) {
-        num = car(comps);
-        if (num->type == INT_TYPE) {
-            compNum = num->i;
-        }
-        else if (num->type == DOUBLE_TYPE) {
-            compNum = num->d;
-        }
-        else {
-            handleInterpError(39);
-        }
-        if (num1 != compNum) {
+    for (int i = 1; i < argc; i++) {
+        int order = compareNumbers(argv[0], argv[i], 39);
+        if (order != 0) {
             boolean = 0;
         }
-        comps = cdr(comps);
-    }
-        
-    if (boolean == 0) {
-        return makeFalse();
-    }
-    else {
-        return makeTrue();
     }
+    return boolean ? makeTrue() : makeFalse();
 }
 
-Value *primitiveLessEq(Value *args) {
-    if (length(args) < 2) {
+Value *primitiveLessEq(int argc, Value **argv) {
+    if (argc < 2) {
         handleInterpError(40);
     }
-    Value *first = car(args);
-    double num1;
-    if (first->type == INT_TYPE) {
-        num1 = first->i;
-    }
-    else if (first->type == DOUBLE_TYPE) {
-        num1 = first->d;
-    }
-    else {
-        handleInterpError(41);
-    }
-    
-    Value *comps = cdr(args);
-    Value *num;
-    double compNum;
+    toDouble(argv[0], 41);
     int boolean = 1;
-    for (int i = 0; i < length(cdr(args)); i++) {
-        num = car(comps);
-        if (num->type == INT_TYPE) {
-            compNum = num->i;
-        }
-        else if (num->type == DOUBLE_TYPE) {
-            compNum = num->d;
-        }
-        else {
-            handleInterpError(42);
-        }
-        if (num1 > compNum) {
+    for (int i = 1; i < argc; i++) {
+        int order = compareNumbers(argv[0], argv[i], 42);
+        if (order > 0 && order != UNORDERED) {
             boolean = 0;
         }
-        comps = cdr(comps);
-    }
-        
-    if (boolean == 0) {
-        return makeFalse();
-    }
-    else {
-        return makeTrue();
     }
+    return boolean ? makeTrue() : makeFalse();
 }
 
-Value *primitiveGrEq(Value *args) {
-    if (length(args) < 2) {
+Value *primitiveGrEq(int argc, Value **argv) {
+    if (argc < 2) {
         handleInterpError(43);
     }
-    Value *first = car(args);
-    double num1;
-    if (first->type == INT_TYPE) {
-        num1 = first->i;
-    }
-    else if (first->type == DOUBLE_TYPE) {
-        num1 = first->d;
-    }
-    else {
-        handleInterpError(44);
-    }
-    
-    Value *comps = cdr(args);
-    Value *num;
-    double compNum;
+    toDouble(argv[0], 44);
     int boolean = 1;
-    for (int i = 0; i < length(cdr(args)); i++) {
-        num = car(comps);
-        if (num->type == INT_TYPE) {
-            compNum = num->i;
-        }
-        else if (num->type == DOUBLE_TYPE) {
-            compNum = num->d;
-        }
-        else {
-            handleInterpError(45);
-        }
-        if (num1 < compNum) {
+    for (int i = 1; i < argc; i++) {
+        int order = compareNumbers(argv[0], argv[i], 45);
+        if (order < 0) {
             boolean = 0;
         }
-        comps = cdr(comps);
     }
-        
-    if (boolean == 0) {
-        return makeFalse();
+    return boolean ? makeTrue() : makeFalse();
+}
+
+// returns whether value can be called
+int isProcedure(Value *value) {
+    return value->type == PRIMITIVE_TYPE || value->type == CLOSURE_TYPE ||
+           value->type == CONTINUATION_TYPE;
+}
+
+// (error message irritant ...)
+Value *primitiveError(int argc, Value **argv) {
+    if (argc < 1) {
+        handleInterpError(186);
+    }
+    Value *irritants = makeNull();
+    for (int i = argc - 1; i > 0; i--) {
+        irritants = cons(argv[i], irritants);
+    }
+    return raiseCondition(makeErrorObject(0, argv[0], irritants), 0);
+}
+
+Value *primitiveRaise(int argc, Value **argv) {
+    if (argc != 1) {
+        handleInterpError(187);
+    }
+    return raiseCondition(argv[0], 0);
+}
+
+Value *primitiveRaiseContinuable(int argc, Value **argv) {
+    if (argc != 1) {
+        handleInterpError(187);
+    }
+    return raiseCondition(argv[0], 1);
+}
+
+// (with-exception-handler handler thunk)
+Value *primitiveWithHandler(int argc, Value **argv) {
+    if (argc != 2 || !isProcedure(argv[0]) || !isProcedure(argv[1])) {
+        handleInterpError(188);
+    }
+    Value *outer = handlers;
+    handlers = cons(argv[0], handlers);
+    Value *result = apply(argv[1], 0, NULL);
+    handlers = outer;
+    return result;
+}
+
+// calls body, a thunk; if it raises a condition, the C stack unwinds to
+// here and clauses, which the analyzer made from the clauses of a guard, is
+// called on it instead
+Value *primitiveGuard(int argc, Value **argv) {
+    ErrorFrame frame;
+    pushErrorFrame(&frame);
+    if (setjmp(frame.jump) == 0) {
+        Value *marker = makeNull();
+        marker->type = PTR_TYPE;
+        marker->p = &frame;
+        handlers = cons(marker, handlers);
+        Value *result = apply(argv[0], 0, NULL);
+        popErrorFrame(&frame);
+        return result;
+    }
+    popErrorFrame(&frame);
+    return apply(argv[1], 1, &frame.condition);
+}
+
+// raises again a condition that no clause of a guard took
+Value *primitiveReraise(int argc, Value **argv) {
+    return raiseCondition(argv[0], 1);
+}
+
+// (call/ec procedure) calls procedure on an escape procedure. Calling that
+// makes call/ec return its argument at once, however deep the call is,
+// by unwinding to an error frame as raise does; it is one-shot and only
+// works while call/ec has not returned.
+Value *primitiveCallEc(int argc, Value **argv) {
+    if (argc != 1 || !isProcedure(argv[0])) {
+        handleInterpError(191);
+    }
+    ErrorFrame frame;
+    Value *escape = makeNull();
+    escape->type = CONTINUATION_TYPE;
+    escape->p = &frame;
+    pushErrorFrame(&frame);
+    frame.escape = escape;
+    if (setjmp(frame.jump) == 0) {
+        Value *result = apply(argv[0], 1, &escape);
+        popErrorFrame(&frame);
+        return result;
+    }
+    popErrorFrame(&frame);
+    return frame.condition;
+}
+
+// calls the escape procedure of a call/ec on the argc arguments in argv
+Value *applyEscape(Value *escape, int argc, Value **argv) {
+    if (argc != 1) {
+        handleInterpError(192);
+    }
+    // the frame is live only if it is still on the chain, and still the
+    // one this escape procedure was made for
+    for (ErrorFrame *frame = errorFrame; frame != NULL;
+         frame = frame->parent) {
+        if (frame == escape->p && frame->escape == escape) {
+            unwindTo(frame, argv[0]);
+        }
+    }
+    handleInterpError(193);
+    return NULL;
+}
+
+Value *primitiveIsErrorObject(int argc, Value **argv) {
+    if (argc != 1) {
+        handleInterpError(189);
+    }
+    return argv[0]->type == ERROR_TYPE ? makeTrue() : makeFalse();
+}
+
+Value *primitiveErrorMessage(int argc, Value **argv) {
+    if (argc != 1 || argv[0]->type != ERROR_TYPE) {
+        handleInterpError(189);
+    }
+    return argv[0]->err.message;
+}
+
+Value *primitiveErrorIrritants(int argc, Value **argv) {
+    if (argc != 1 || argv[0]->type != ERROR_TYPE) {
+        handleInterpError(189);
+    }
+    return argv[0]->err.irritants;
+}
+
+// The list primitives walk their lists in loops, building results front to
+// back through a pointer to the cdr still to fill in, so that lists of any
+// length take constant stack. The higher-order ones call their procedure
+// with one argument array, refilled for each element.
+
+// returns the length of list, checking that it is a proper list
+long listLength(Value *list) {
+    long count = 0;
+    for (; list->type == CONS_TYPE; list = cdr(list)) {
+        count++;
+    }
+    if (list->type != NULL_TYPE) {
+        handleInterpError(224);
+    }
+    return count;
+}
+
+// sets *tail, the cdr at the end of a list being built, to a new pair of
+// value, and returns the cdr of that pair
+Value **appendValue(Value **tail, Value *value) {
+    *tail = cons(value, makeNull());
+    return &(*tail)->c.cdr;
+}
+
+// checks that argv holds a procedure followed by at least one list
+void checkListProcedure(int argc, Value **argv) {
+    if (argc < 2 || !isProcedure(argv[0])) {
+        handleInterpError(224);
+    }
+}
+
+// moves each of the count lists in lists one pair on, putting their cars
+// in items; returns 0 instead if any of them has run out
+int nextItems(Value **lists, Value **items, int count) {
+    for (int i = 0; i < count; i++) {
+        if (lists[i]->type != CONS_TYPE) {
+            if (lists[i]->type != NULL_TYPE) {
+                handleInterpError(224);
+            }
+            return 0;
+        }
+        items[i] = car(lists[i]);
+        lists[i] = cdr(lists[i]);
+    }
+    return 1;
+}
+
+// returns a copy of the list arguments of a higher-order list primitive,
+// from argv[first] on, for nextItems to move along
+Value **listCursors(int argc, Value **argv, int first) {
+    Value **lists = talloc((argc - first) * sizeof(Value *));
+    memcpy(lists, argv + first, (argc - first) * sizeof(Value *));
+    return lists;
+}
+
+Value *primitiveList(int argc, Value **argv) {
+    Value *list = makeNull();
+    for (int i = argc - 1; i >= 0; i--) {
+        list = cons(argv[i], list);
+    }
+    return list;
+}
+
+Value *primitiveLength(int argc, Value **argv) {
+    if (argc != 1) {
+        handleInterpError(224);
+    }
+    return makeInt(listLength(argv[0]));
+}
+
+// the last argument is shared, not copied, and need not be a list
+Value *primitiveAppend(int argc, Value **argv) {
+    if (argc == 0) {
+        return makeNull();
+    }
+    Value *result = makeNull();
+    Value **tail = &result;
+    for (int i = 0; i < argc - 1; i++) {
+        listLength(argv[i]);
+        for (Value *list = argv[i]; list->type == CONS_TYPE;
+             list = cdr(list)) {
+            tail = appendValue(tail, car(list));
+        }
+    }
+    *tail = argv[argc - 1];
+    return result;
+}
+
+Value *primitiveReverse(int argc, Value **argv) {
+    if (argc != 1) {
+        handleInterpError(224);
+    }
+    listLength(argv[0]);
+    Value *reversed = makeNull();
+    for (Value *list = argv[0]; list->type == CONS_TYPE; list = cdr(list)) {
+        reversed = cons(car(list), reversed);
+    }
+    return reversed;
+}
+
+// returns what is left of list after k pairs, checking that it has them
+Value *dropPairs(int argc, Value **argv) {
+    if (argc != 2 || argv[1]->type != INT_TYPE) {
+        handleInterpError(224);
+    }
+    if (argv[1]->i < 0) {
+        handleInterpError(225);
+    }
+    Value *list = argv[0];
+    for (long k = argv[1]->i; k > 0; k--) {
+        if (list->type != CONS_TYPE) {
+            handleInterpError(225);
+        }
+        list = cdr(list);
+    }
+    return list;
+}
+
+Value *primitiveListTail(int argc, Value **argv) {
+    return dropPairs(argc, argv);
+}
+
+Value *primitiveListRef(int argc, Value **argv) {
+    Value *list = dropPairs(argc, argv);
+    if (list->type != CONS_TYPE) {
+        handleInterpError(225);
+    }
+    return car(list);
+}
+
+// (map procedure list ...) stops at the end of the shortest list
+Value *primitiveMap(int argc, Value **argv) {
+    checkListProcedure(argc, argv);
+    Value **lists = listCursors(argc, argv, 1);
+    Value **items = talloc((argc - 1) * sizeof(Value *));
+    Value *result = makeNull();
+    Value **tail = &result;
+    while (nextItems(lists, items, argc - 1)) {
+        tail = appendValue(tail, apply(argv[0], argc - 1, items));
+    }
+    return result;
+}
+
+Value *primitiveForEach(int argc, Value **argv) {
+    checkListProcedure(argc, argv);
+    Value **lists = listCursors(argc, argv, 1);
+    Value **items = talloc((argc - 1) * sizeof(Value *));
+    while (nextItems(lists, items, argc - 1)) {
+        apply(argv[0], argc - 1, items);
+    }
+    return makeVoid();
+}
+
+Value *primitiveFilter(int argc, Value **argv) {
+    if (argc != 2) {
+        handleInterpError(224);
+    }
+    checkListProcedure(argc, argv);
+    Value *list = argv[1];
+    Value *item;
+    Value *result = makeNull();
+    Value **tail = &result;
+    while (nextItems(&list, &item, 1)) {
+        Value *kept = apply(argv[0], 1, &item);
+        if (kept->type != BOOL_TYPE || kept->i) {
+            tail = appendValue(tail, item);
+        }
+    }
+    return result;
+}
+
+// (fold-left procedure initial list ...) calls procedure on the result so
+// far and the next element of each list
+Value *primitiveFoldLeft(int argc, Value **argv) {
+    if (argc < 3) {
+        handleInterpError(224);
+    }
+    checkListProcedure(argc, argv);
+    Value **lists = listCursors(argc, argv, 2);
+    Value **items = talloc((argc - 1) * sizeof(Value *));
+    items[0] = argv[1];
+    while (nextItems(lists, items + 1, argc - 2)) {
+        items[0] = apply(argv[0], argc - 1, items);
+    }
+    return items[0];
+}
+
+// (fold-right procedure initial list ...) calls procedure on the elements
+// of each list and the result for the ones after them, so it goes through
+// the lists backwards, from copies of them reversed
+Value *primitiveFoldRight(int argc, Value **argv) {
+    if (argc < 3) {
+        handleInterpError(224);
+    }
+    checkListProcedure(argc, argv);
+    int count = argc - 2;
+    Value **lists = listCursors(argc, argv, 2);
+    Value **items = talloc((count + 1) * sizeof(Value *));
+    Value **reversed = talloc(count * sizeof(Value *));
+    for (int i = 0; i < count; i++) {
+        reversed[i] = makeNull();
+    }
+    while (nextItems(lists, items, count)) {
+        for (int i = 0; i < count; i++) {
+            reversed[i] = cons(items[i], reversed[i]);
+        }
+    }
+    items[count] = argv[1];
+    while (nextItems(reversed, items, count)) {
+        items[count] = apply(argv[0], count + 1, items);
+    }
+    return items[count];
+}
+
+// returns whether a and b are the same by equality, a procedure given to
+// assoc or member, or by isSame if that is NULL
+int sameItem(Value *equality, int (*isSame)(Value *, Value *), Value *a,
+             Value *b) {
+    if (isSame != NULL) {
+        return isSame(a, b);
+    }
+    Value *args[2] = {a, b};
+    Value *same = apply(equality, 2, args);
+    return same->type != BOOL_TYPE || same->i;
+}
+
+// returns the first pair of the list argv[1] whose car is the same as
+// argv[0], or #f; assoc and member may take the procedure to compare with
+// as a third argument
+Value *findMember(int argc, Value **argv, int (*isSame)(Value *, Value *)) {
+    if (argc < 2 || argc > (isSame == isEqual ? 3 : 2) ||
+        (argc == 3 && !isProcedure(argv[2]))) {
+        handleInterpError(224);
+    }
+    Value *equality = argc == 3 ? argv[2] : NULL;
+    if (equality != NULL) {
+        isSame = NULL;
+    }
+    Value *list = argv[1];
+    for (; list->type == CONS_TYPE; list = cdr(list)) {
+        if (sameItem(equality, isSame, argv[0], car(list))) {
+            return list;
+        }
+    }
+    if (list->type != NULL_TYPE) {
+        handleInterpError(224);
+    }
+    return makeFalse();
+}
+
+// returns the first pair of the association list argv[1] whose car is the
+// same as argv[0], or #f
+Value *findAssociation(int argc, Value **argv,
+                       int (*isSame)(Value *, Value *)) {
+    if (argc < 2 || argc > (isSame == isEqual ? 3 : 2) ||
+        (argc == 3 && !isProcedure(argv[2]))) {
+        handleInterpError(224);
+    }
+    Value *equality = argc == 3 ? argv[2] : NULL;
+    if (equality != NULL) {
+        isSame = NULL;
+    }
+    Value *list = argv[1];
+    for (; list->type == CONS_TYPE; list = cdr(list)) {
+        Value *pair = car(list);
+        if (pair->type != CONS_TYPE) {
+            handleInterpError(224);
+        }
+        if (sameItem(equality, isSame, argv[0], car(pair))) {
+            return pair;
+        }
+    }
+    if (list->type != NULL_TYPE) {
+        handleInterpError(224);
+    }
+    return makeFalse();
+}
+
+Value *primitiveMemq(int argc, Value **argv) {
+    return findMember(argc, argv, isEq);
+}
+
+Value *primitiveMemv(int argc, Value **argv) {
+    return findMember(argc, argv, isEqv);
+}
+
+Value *primitiveMember(int argc, Value **argv) {
+    return findMember(argc, argv, isEqual);
+}
+
+Value *primitiveAssq(int argc, Value **argv) {
+    return findAssociation(argc, argv, isEq);
+}
+
+Value *primitiveAssv(int argc, Value **argv) {
+    return findAssociation(argc, argv, isEqv);
+}
+
+Value *primitiveAssoc(int argc, Value **argv) {
+    return findAssociation(argc, argv, isEqual);
+}
+
+// Sorting is stable, and calls the procedure that says whether one element
+// goes before another through apply(), except that when that is < or > and
+// the elements are all numbers, they are compared here, as those
+// primitives would compare them.
+
+// how a sort compares elements
+typedef struct Ordering {
+    Value *less;
+    // 0 to call less, or -1 or 1 for < or > on numbers
+    int direct;
+    // whether the numbers are all fixnums
+    int fixnums;
+} Ordering;
+
+// sets up order to sort the count items with less
+void makeOrdering(Ordering *order, Value *less, Value **items, long count) {
+    if (!isProcedure(less)) {
+        handleInterpError(226);
+    }
+    order->less = less;
+    order->direct = 0;
+    order->fixnums = 1;
+    if (less->type != PRIMITIVE_TYPE ||
+        (less->pf != primitiveLess && less->pf != primitiveGreater)) {
+        return;
+    }
+    for (long i = 0; i < count; i++) {
+        if (items[i]->type != INT_TYPE && items[i]->type != DOUBLE_TYPE &&
+            items[i]->type != BIGNUM_TYPE) {
+            return;
+        }
+        order->fixnums = order->fixnums && items[i]->type == INT_TYPE;
+    }
+    order->direct = less->pf == primitiveLess ? -1 : 1;
+}
+
+// returns whether a goes before b
+int precedes(Ordering *order, Value *a, Value *b) {
+    if (order->direct != 0) {
+        if (order->fixnums) {
+            return order->direct < 0 ? a->i < b->i : a->i > b->i;
+        }
+        int comparison = compareNumbers(a, b, 33);
+        return order->direct < 0 ? comparison < 0 : comparison > 0;
+    }
+    Value *args[2] = {a, b};
+    Value *result = apply(order->less, 2, args);
+    return result->type != BOOL_TYPE || result->i;
+}
+
+// a run of items already in order, in an array being sorted
+typedef struct Run {
+    long start;
+    long length;
+} Run;
+
+// blocks of items shorter than this are sorted by insertion before merging
+#define INSERTION_BLOCK 16
+
+// merges the neighbouring sorted runs of items from start to middle and
+// from middle to end, through scratch, taking from the first among equal
+// items; runs already in order need no merging at all
+void mergeRuns(Ordering *order, Value **items, Value **scratch, long start,
+               long middle, long end) {
+    if (!precedes(order, items[middle], items[middle - 1])) {
+        return;
+    }
+    long width = middle - start;
+    memcpy(scratch, items + start, width * sizeof(Value *));
+    long i = 0;
+    long j = middle;
+    long k = start;
+    while (i < width && j < end) {
+        if (precedes(order, items[j], scratch[i])) {
+            items[k++] = items[j++];
+        }
+        else {
+            items[k++] = scratch[i++];
+        }
+    }
+    memcpy(items + k, scratch + i, (width - i) * sizeof(Value *));
+}
+
+// sorts the count items by a natural merge sort, with a scratch array of
+// as many: it finds the runs already in order, reversing those in strictly
+// descending order and extending short ones by insertion, and merges them
+// on a stack whose runs are each more than twice as long as the one above,
+// so that the stack stays shallow and the merges balanced
+void sortItems(Ordering *order, Value **items, Value **scratch,
+               long count) {
+    Run stack[64];
+    int depth = 0;
+    long start = 0;
+    while (start < count) {
+        long end = start + 1;
+        if (end < count && precedes(order, items[end], items[start])) {
+            while (end < count && precedes(order, items[end], items[end - 1])) {
+                end++;
+            }
+            for (long i = start, j = end - 1; i < j; i++, j--) {
+                Value *item = items[i];
+                items[i] = items[j];
+                items[j] = item;
+            }
+        }
+        else {
+            while (end < count &&
+                   !precedes(order, items[end], items[end - 1])) {
+                end++;
+            }
+        }
+        long limit = start + INSERTION_BLOCK < count ? start + INSERTION_BLOCK
+                                                     : count;
+        for (; end < limit; end++) {
+            Value *item = items[end];
+            long j = end;
+            for (; j > start && precedes(order, item, items[j - 1]); j--) {
+                items[j] = items[j - 1];
+            }
+            items[j] = item;
+        }
+        stack[depth].start = start;
+        stack[depth].length = end - start;
+        depth++;
+        while (depth > 1 &&
+               (stack[depth - 2].length <= 2 * stack[depth - 1].length ||
+                end == count)) {
+            Run *left = &stack[depth - 2];
+            Run *right = &stack[depth - 1];
+            mergeRuns(order, items, scratch, left->start, right->start,
+                      right->start + right->length);
+            left->length += right->length;
+            depth--;
+        }
+        start = end;
+    }
+}
+
+// returns a sorted copy of list, which it sorts as an array, since
+// following the pairs of a list as they are relinked is slower than
+// sorting an array by several times on long lists
+Value *sortedList(Value *list, Value *less) {
+    long count = 0;
+    Value *rest = list;
+    for (; rest->type == CONS_TYPE; rest = cdr(rest)) {
+        count++;
+    }
+    if (rest->type != NULL_TYPE) {
+        handleInterpError(226);
+    }
+    Value **items = talloc((2 * count + 1) * sizeof(Value *));
+    rest = list;
+    for (long i = 0; i < count; i++) {
+        items[i] = car(rest);
+        rest = cdr(rest);
+    }
+    Ordering order;
+    makeOrdering(&order, less, items, count);
+    sortItems(&order, items, items + count, count);
+    Value *sorted = makeNull();
+    for (long i = count - 1; i >= 0; i--) {
+        sorted = cons(items[i], sorted);
+    }
+    return sorted;
+}
+
+// sorts the items of vector, which it changes only once they are sorted,
+// so that an error raised by the procedure leaves the vector as it was; the
+// scratch arrays come from talloc, since such an error skips any free
+void sortVector(Value *vector, Value *less) {
+    long count = vector->vec.length;
+    Ordering order;
+    makeOrdering(&order, less, vector->vec.items, count);
+    Value **items = talloc((2 * count + 1) * sizeof(Value *));
+    memcpy(items, vector->vec.items, count * sizeof(Value *));
+    sortItems(&order, items, items + count, count);
+    memcpy(vector->vec.items, items, count * sizeof(Value *));
+}
+
+// (sort sequence less) returns a sorted copy of a list or vector
+Value *primitiveSort(int argc, Value **argv) {
+    if (argc != 2) {
+        handleInterpError(226);
+    }
+    if (argv[0]->type != VECTOR_TYPE) {
+        return sortedList(argv[0], argv[1]);
+    }
+    Value *copy = makeVector(argv[0]->vec.length, makeVoid());
+    memcpy(copy->vec.items, argv[0]->vec.items,
+           argv[0]->vec.length * sizeof(Value *));
+    sortVector(copy, argv[1]);
+    return copy;
+}
+
+// (list-sort less list)
+Value *primitiveListSort(int argc, Value **argv) {
+    if (argc != 2) {
+        handleInterpError(226);
+    }
+    return sortedList(argv[1], argv[0]);
+}
+
+// (vector-sort! vector less)
+Value *primitiveVectorSort(int argc, Value **argv) {
+    if (argc != 2 || argv[0]->type != VECTOR_TYPE) {
+        handleInterpError(226);
+    }
+    sortVector(argv[0], argv[1]);
+    return makeVoid();
+}
+
+Value *primitiveMakeVector(int argc, Value **argv) {
+    if (argc < 1 || argc > 2 || argv[0]->type != INT_TYPE ||
+        argv[0]->i < 0 || argv[0]->i > INT_MAX) {
+        handleInterpError(201);
+    }
+    return makeVector(argv[0]->i, argc == 2 ? argv[1] : makeInt(0));
+}
+
+Value *primitiveVector(int argc, Value **argv) {
+    Value *vector = makeVector(argc, NULL);
+    memcpy(vector->vec.items, argv, argc * sizeof(Value *));
+    return vector;
+}
+
+Value *primitiveIsVector(int argc, Value **argv) {
+    if (argc != 1) {
+        handleInterpError(202);
+    }
+    return argv[0]->type == VECTOR_TYPE ? makeTrue() : makeFalse();
+}
+
+// returns the index argument of vector-ref or vector-set!, checking that it
+// is in the bounds of the vector
+int vectorIndex(Value *vector, Value *index) {
+    if (vector->type != VECTOR_TYPE || index->type != INT_TYPE) {
+        handleInterpError(202);
+    }
+    if (index->i < 0 || index->i >= vector->vec.length) {
+        handleInterpError(203);
+    }
+    return index->i;
+}
+
+Value *primitiveVectorRef(int argc, Value **argv) {
+    if (argc != 2) {
+        handleInterpError(202);
+    }
+    return argv[0]->vec.items[vectorIndex(argv[0], argv[1])];
+}
+
+Value *primitiveVectorSet(int argc, Value **argv) {
+    if (argc != 3) {
+        handleInterpError(202);
+    }
+    argv[0]->vec.items[vectorIndex(argv[0], argv[1])] = argv[2];
+    return makeVoid();
+}
+
+Value *primitiveVectorLength(int argc, Value **argv) {
+    if (argc != 1 || argv[0]->type != VECTOR_TYPE) {
+        handleInterpError(202);
+    }
+    return makeInt(argv[0]->vec.length);
+}
+
+Value *primitiveVectorFill(int argc, Value **argv) {
+    if (argc != 2 || argv[0]->type != VECTOR_TYPE) {
+        handleInterpError(202);
+    }
+    for (int i = 0; i < argv[0]->vec.length; i++) {
+        argv[0]->vec.items[i] = argv[1];
+    }
+    return makeVoid();
+}
+
+Value *primitiveVectorToList(int argc, Value **argv) {
+    if (argc != 1 || argv[0]->type != VECTOR_TYPE) {
+        handleInterpError(202);
+    }
+    Value *list = makeNull();
+    for (int i = argv[0]->vec.length - 1; i >= 0; i--) {
+        list = cons(argv[0]->vec.items[i], list);
+    }
+    return list;
+}
+
+Value *primitiveListToVector(int argc, Value **argv) {
+    if (argc != 1) {
+        handleInterpError(202);
+    }
+    int count = 0;
+    Value *list = argv[0];
+    for (; list->type == CONS_TYPE; list = cdr(list)) {
+        count++;
+    }
+    if (list->type != NULL_TYPE) {
+        handleInterpError(204);
+    }
+    Value *vector = makeVector(count, NULL);
+    list = argv[0];
+    for (int i = 0; i < count; i++) {
+        vector->vec.items[i] = car(list);
+        list = cdr(list);
+    }
+    return vector;
+}
+
+Value *primitiveIsEq(int argc, Value **argv) {
+    if (argc != 2) {
+        handleInterpError(208);
+    }
+    return isEq(argv[0], argv[1]) ? makeTrue() : makeFalse();
+}
+
+Value *primitiveIsEqv(int argc, Value **argv) {
+    if (argc != 2) {
+        handleInterpError(208);
+    }
+    return isEqv(argv[0], argv[1]) ? makeTrue() : makeFalse();
+}
+
+Value *primitiveIsEqual(int argc, Value **argv) {
+    if (argc != 2) {
+        handleInterpError(208);
+    }
+    return isEqual(argv[0], argv[1]) ? makeTrue() : makeFalse();
+}
+
+// the keys of a table compare as its optional argument, eq?, eqv? or
+// equal?, does; equal? by default
+Value *primitiveMakeHashTable(int argc, Value **argv) {
+    keyKind kind = EQUAL_KEYS;
+    if (argc > 1) {
+        handleInterpError(205);
+    }
+    if (argc == 1) {
+        if (argv[0]->type != PRIMITIVE_TYPE) {
+            handleInterpError(205);
+        }
+        if (argv[0]->pf == primitiveIsEq) {
+            kind = EQ_KEYS;
+        }
+        else if (argv[0]->pf == primitiveIsEqv) {
+            kind = EQV_KEYS;
+        }
+        else if (argv[0]->pf != primitiveIsEqual) {
+            handleInterpError(205);
+        }
+    }
+    Value *value = makeNull();
+    value->type = HASH_TABLE_TYPE;
+    value->table = makeHashTable(kind);
+    return value;
+}
+
+// checks that a hash table primitive got a table and count - 1 more
+// arguments
+void checkTableArgs(int argc, Value **argv, int count) {
+    if (argc != count || argv[0]->type != HASH_TABLE_TYPE) {
+        handleInterpError(207);
+    }
+}
+
+Value *primitiveIsHashTable(int argc, Value **argv) {
+    if (argc != 1) {
+        handleInterpError(207);
+    }
+    return argv[0]->type == HASH_TABLE_TYPE ? makeTrue() : makeFalse();
+}
+
+// the value of a key that is not in the table is that of the optional
+// thunk, or an error without one
+Value *primitiveHashTableRef(int argc, Value **argv) {
+    checkTableArgs(argc, argv, argc == 3 ? 3 : 2);
+    Value *value = hashTableRef(argv[0]->table, argv[1]);
+    if (value != NULL) {
+        return value;
+    }
+    if (argc == 3) {
+        return apply(argv[2], 0, NULL);
+    }
+    raiseCondition(makeErrorObject(206, makeString("key not found"),
+                                   cons(argv[1], makeNull())), 0);
+    return NULL;
+}
+
+Value *primitiveHashTableRefDefault(int argc, Value **argv) {
+    checkTableArgs(argc, argv, 3);
+    Value *value = hashTableRef(argv[0]->table, argv[1]);
+    return value == NULL ? argv[2] : value;
+}
+
+Value *primitiveHashTableSet(int argc, Value **argv) {
+    checkTableArgs(argc, argv, 3);
+    hashTableSet(argv[0]->table, argv[1], argv[2]);
+    return makeVoid();
+}
+
+Value *primitiveHashTableDelete(int argc, Value **argv) {
+    checkTableArgs(argc, argv, 2);
+    hashTableDelete(argv[0]->table, argv[1]);
+    return makeVoid();
+}
+
+Value *primitiveHashTableCount(int argc, Value **argv) {
+    checkTableArgs(argc, argv, 1);
+    return makeInt(argv[0]->table->count);
+}
+
+// calls the procedure on each key and its value; it walks the entries as
+// they were when it started, so the procedure may change the table
+Value *primitiveHashTableWalk(int argc, Value **argv) {
+    checkTableArgs(argc, argv, 2);
+    Value *entries = hashTableEntries(argv[0]->table);
+    for (; entries->type == CONS_TYPE; entries = cdr(entries)) {
+        Value *args[2] = {car(car(entries)), cdr(car(entries))};
+        apply(argv[1], 2, args);
+    }
+    return makeVoid();
+}
+
+// checks that the argc arguments of a string primitive are strings
+void checkStrings(int argc, Value **argv) {
+    for (int i = 0; i < argc; i++) {
+        if (argv[i]->type != STR_TYPE) {
+            handleInterpError(209);
+        }
+    }
+}
+
+// returns index, an argument of a string primitive, checking that it is
+// from 0 to limit
+long stringIndex(Value *index, long limit) {
+    if (index->type != INT_TYPE) {
+        handleInterpError(209);
+    }
+    if (index->i < 0 || index->i > limit) {
+        handleInterpError(210);
+    }
+    return index->i;
+}
+
+Value *primitiveStringLength(int argc, Value **argv) {
+    if (argc != 1) {
+        handleInterpError(209);
+    }
+    checkStrings(1, argv);
+    return makeInt(argv[0]->str.length);
+}
+
+Value *primitiveStringAppend(int argc, Value **argv) {
+    checkStrings(argc, argv);
+    return stringAppend(argc, argv);
+}
+
+// the characters of a string from start up to the optional end, which is
+// the end of the string by default; substring shares them, and string-copy
+// copies them
+Value *stringRange(int argc, Value **argv, int first) {
+    if (argc < first || argc > 3) {
+        handleInterpError(209);
+    }
+    checkStrings(1, argv);
+    long length = argv[0]->str.length;
+    long end = argc == 3 ? stringIndex(argv[2], length) : length;
+    long start = argc >= 2 ? stringIndex(argv[1], end) : 0;
+    return substring(argv[0], start, end);
+}
+
+Value *primitiveSubstring(int argc, Value **argv) {
+    return stringRange(argc, argv, 2);
+}
+
+Value *primitiveStringCopy(int argc, Value **argv) {
+    Value *range = stringRange(argc, argv, 1);
+    char *chars = talloc(range->str.length);
+    memcpy(chars, range->str.chars, range->str.length);
+    return makeText(chars, range->str.length);
+}
+
+Value *primitiveStringRef(int argc, Value **argv) {
+    if (argc != 2) {
+        handleInterpError(209);
+    }
+    checkStrings(1, argv);
+    long index = stringIndex(argv[1], argv[0]->str.length - 1);
+    Value *value = makeNull();
+    value->type = CHAR_TYPE;
+    value->i = (unsigned char)stringChars(argv[0])[index];
+    return value;
+}
+
+// returns whether each of the strings in argv sorts before the next, or
+// with equal set, whether they are all the same
+Value *compareStrings(int argc, Value **argv, int equal) {
+    if (argc < 1) {
+        handleInterpError(209);
+    }
+    checkStrings(argc, argv);
+    for (int i = 1; i < argc; i++) {
+        int order = stringCompare(argv[i - 1], argv[i]);
+        if (equal ? order != 0 : order >= 0) {
+            return makeFalse();
+        }
+    }
+    return makeTrue();
+}
+
+Value *primitiveStringEqual(int argc, Value **argv) {
+    return compareStrings(argc, argv, 1);
+}
+
+Value *primitiveStringLess(int argc, Value **argv) {
+    return compareStrings(argc, argv, 0);
+}
+
+Value *primitiveStringToList(int argc, Value **argv) {
+    if (argc != 1) {
+        handleInterpError(209);
+    }
+    checkStrings(1, argv);
+    char *chars = stringChars(argv[0]);
+    Value *list = makeNull();
+    for (long i = argv[0]->str.length - 1; i >= 0; i--) {
+        Value *value = makeNull();
+        value->type = CHAR_TYPE;
+        value->i = (unsigned char)chars[i];
+        list = cons(value, list);
+    }
+    return list;
+}
+
+Value *primitiveIsString(int argc, Value **argv) {
+    if (argc != 1) {
+        handleInterpError(209);
+    }
+    return argv[0]->type == STR_TYPE ? makeTrue() : makeFalse();
+}
+
+// Each primitive on f64vectors or s64vectors has one name per kind of
+// vector, and a wrapper of that name passing the kind to the code they
+// share.
+
+// checks that argv holds count numeric vectors of the given type, of the
+// same length, followed by extra more arguments
+void checkNumVectors(int argc, Value **argv, valueType type, int count,
+                     int extra) {
+    if (argc != count + extra) {
+        handleInterpError(211);
+    }
+    for (int i = 0; i < count; i++) {
+        if (argv[i]->type != type) {
+            handleInterpError(211);
+        }
+        if (argv[i]->nv.length != argv[0]->nv.length) {
+            handleInterpError(213);
+        }
+    }
+}
+
+// stores value as element index of a numeric vector
+void setNumElement(Value *vector, long index, Value *value) {
+    if (vector->type == F64VECTOR_TYPE) {
+        vector->nv.f64[index] = toDouble(value, 211);
+    }
+    else if (value->type == INT_TYPE) {
+        vector->nv.s64[index] = value->i;
+    }
+    else {
+        handleInterpError(211);
+    }
+}
+
+// returns element index of a numeric vector
+Value *numElement(Value *vector, long index) {
+    if (vector->type == F64VECTOR_TYPE) {
+        return makeDouble(vector->nv.f64[index]);
+    }
+    return makeInt(vector->nv.s64[index]);
+}
+
+Value *makeNumVectorOf(int argc, Value **argv, valueType type) {
+    if (argc < 1 || argc > 2 || argv[0]->type != INT_TYPE ||
+        argv[0]->i < 0) {
+        handleInterpError(211);
+    }
+    Value *vector = makeNumVector(type, argv[0]->i);
+    if (argc == 2) {
+        for (long i = 0; i < vector->nv.length; i++) {
+            setNumElement(vector, i, argv[1]);
+        }
+    }
+    return vector;
+}
+
+Value *numVectorOf(int argc, Value **argv, valueType type) {
+    Value *vector = makeNumVector(type, argc);
+    for (int i = 0; i < argc; i++) {
+        setNumElement(vector, i, argv[i]);
+    }
+    return vector;
+}
+
+Value *listToNumVector(int argc, Value **argv, valueType type) {
+    if (argc != 1) {
+        handleInterpError(211);
+    }
+    long count = 0;
+    Value *list = argv[0];
+    for (; list->type == CONS_TYPE; list = cdr(list)) {
+        count++;
+    }
+    if (list->type != NULL_TYPE) {
+        handleInterpError(211);
+    }
+    Value *vector = makeNumVector(type, count);
+    list = argv[0];
+    for (long i = 0; i < count; i++) {
+        setNumElement(vector, i, car(list));
+        list = cdr(list);
+    }
+    return vector;
+}
+
+Value *numVectorToList(int argc, Value **argv, valueType type) {
+    checkNumVectors(argc, argv, type, 1, 0);
+    Value *list = makeNull();
+    for (long i = argv[0]->nv.length - 1; i >= 0; i--) {
+        list = cons(numElement(argv[0], i), list);
+    }
+    return list;
+}
+
+Value *isNumVector(int argc, Value **argv, valueType type) {
+    if (argc != 1) {
+        handleInterpError(211);
+    }
+    return argv[0]->type == type ? makeTrue() : makeFalse();
+}
+
+Value *numVectorLength(int argc, Value **argv, valueType type) {
+    checkNumVectors(argc, argv, type, 1, 0);
+    return makeInt(argv[0]->nv.length);
+}
+
+// returns the index argument of a numeric vector primitive, checking that
+// it is in the bounds of the vector
+long numVectorIndex(Value *vector, Value *index) {
+    if (index->type != INT_TYPE) {
+        handleInterpError(211);
+    }
+    if (index->i < 0 || index->i >= vector->nv.length) {
+        handleInterpError(212);
+    }
+    return index->i;
+}
+
+Value *numVectorRef(int argc, Value **argv, valueType type) {
+    checkNumVectors(argc, argv, type, 1, 1);
+    return numElement(argv[0], numVectorIndex(argv[0], argv[1]));
+}
+
+Value *numVectorSet(int argc, Value **argv, valueType type) {
+    checkNumVectors(argc, argv, type, 1, 2);
+    setNumElement(argv[0], numVectorIndex(argv[0], argv[1]), argv[2]);
+    return makeVoid();
+}
+
+// reports what went wrong in an s64 kernel, if anything did
+void checkLanes(laneStatus status) {
+    if (status == LANES_OVERFLOW) {
+        handleInterpError(214);
+    }
+    if (status == LANES_DIVIDE_BY_ZERO) {
+        handleInterpError(215);
+    }
+}
+
+// the vector of op applied to each pair of elements of the two vectors;
+// comparisons make s64vectors of 1 for true and 0 for false
+Value *numVectorLanes(int argc, Value **argv, valueType type, laneOp op) {
+    checkNumVectors(argc, argv, type, 2, 0);
+    long n = argv[0]->nv.length;
+    int compare = op == LANE_LESS || op == LANE_EQUAL;
+    Value *result = makeNumVector(compare ? S64VECTOR_TYPE : type, n);
+    if (type == F64VECTOR_TYPE && compare) {
+        f64Compare(op, result->nv.s64, argv[0]->nv.f64, argv[1]->nv.f64, n);
+    }
+    else if (type == F64VECTOR_TYPE) {
+        f64Lanes(op, result->nv.f64, argv[0]->nv.f64, argv[1]->nv.f64, n);
+    }
+    else if (compare) {
+        s64Compare(op, result->nv.s64, argv[0]->nv.s64, argv[1]->nv.s64, n);
+    }
+    else {
+        checkLanes(s64Lanes(op, result->nv.s64, argv[0]->nv.s64,
+                            argv[1]->nv.s64, n));
+    }
+    return result;
+}
+
+Value *numVectorScale(int argc, Value **argv, valueType type) {
+    checkNumVectors(argc, argv, type, 1, 1);
+    long n = argv[0]->nv.length;
+    Value *result = makeNumVector(type, n);
+    if (type == F64VECTOR_TYPE) {
+        f64Scale(result->nv.f64, argv[0]->nv.f64, toDouble(argv[1], 211), n);
+    }
+    else if (argv[1]->type == INT_TYPE) {
+        checkLanes(s64Scale(result->nv.s64, argv[0]->nv.s64, argv[1]->i, n));
+    }
+    else {
+        handleInterpError(211);
+    }
+    return result;
+}
+
+// the sum of the elements of a vector, or with two vectors, of the products
+// of their elements; an s64 total that overflows is a bignum
+Value *numVectorTotal(int argc, Value **argv, valueType type, int dot) {
+    checkNumVectors(argc, argv, type, dot ? 2 : 1, 0);
+    long n = argv[0]->nv.length;
+    if (type == F64VECTOR_TYPE) {
+        return makeDouble(dot ? f64Dot(argv[0]->nv.f64, argv[1]->nv.f64, n)
+                              : f64Sum(argv[0]->nv.f64, n));
+    }
+    long total;
+    long done = dot ? s64Dot(argv[0]->nv.s64, argv[1]->nv.s64, n, &total)
+                    : s64Sum(argv[0]->nv.s64, n, &total);
+    // the rest is added exactly, as + would add it
+    Value *exact = makeInt(total);
+    for (long i = done; i < n; i++) {
+        Value *term = makeInt(argv[0]->nv.s64[i]);
+        if (dot) {
+            term = integerMul(term, makeInt(argv[1]->nv.s64[i]));
+        }
+        exact = integerAdd(exact, term);
+    }
+    return exact;
+}
+
+Value *numVectorExtremum(int argc, Value **argv, valueType type, int max) {
+    checkNumVectors(argc, argv, type, 1, 0);
+    long n = argv[0]->nv.length;
+    if (n == 0) {
+        handleInterpError(211);
+    }
+    if (type == F64VECTOR_TYPE) {
+        return makeDouble(f64Extremum(argv[0]->nv.f64, n, max));
+    }
+    return makeInt(s64Extremum(argv[0]->nv.s64, n, max));
+}
+
+Value *primitiveMakeF64Vector(int argc, Value **argv) {
+    return makeNumVectorOf(argc, argv, F64VECTOR_TYPE);
+}
+
+Value *primitiveF64Vector(int argc, Value **argv) {
+    return numVectorOf(argc, argv, F64VECTOR_TYPE);
+}
+
+Value *primitiveIsF64Vector(int argc, Value **argv) {
+    return isNumVector(argc, argv, F64VECTOR_TYPE);
+}
+
+Value *primitiveF64VectorLength(int argc, Value **argv) {
+    return numVectorLength(argc, argv, F64VECTOR_TYPE);
+}
+
+Value *primitiveF64VectorRef(int argc, Value **argv) {
+    return numVectorRef(argc, argv, F64VECTOR_TYPE);
+}
+
+Value *primitiveF64VectorSet(int argc, Value **argv) {
+    return numVectorSet(argc, argv, F64VECTOR_TYPE);
+}
+
+Value *primitiveF64VectorToList(int argc, Value **argv) {
+    return numVectorToList(argc, argv, F64VECTOR_TYPE);
+}
+
+Value *primitiveListToF64Vector(int argc, Value **argv) {
+    return listToNumVector(argc, argv, F64VECTOR_TYPE);
+}
+
+Value *primitiveF64VectorAdd(int argc, Value **argv) {
+    return numVectorLanes(argc, argv, F64VECTOR_TYPE, LANE_ADD);
+}
+
+Value *primitiveF64VectorSub(int argc, Value **argv) {
+    return numVectorLanes(argc, argv, F64VECTOR_TYPE, LANE_SUB);
+}
+
+Value *primitiveF64VectorMul(int argc, Value **argv) {
+    return numVectorLanes(argc, argv, F64VECTOR_TYPE, LANE_MUL);
+}
+
+Value *primitiveF64VectorDiv(int argc, Value **argv) {
+    return numVectorLanes(argc, argv, F64VECTOR_TYPE, LANE_DIV);
+}
+
+Value *primitiveF64VectorLess(int argc, Value **argv) {
+    return numVectorLanes(argc, argv, F64VECTOR_TYPE, LANE_LESS);
+}
+
+Value *primitiveF64VectorEqual(int argc, Value **argv) {
+    return numVectorLanes(argc, argv, F64VECTOR_TYPE, LANE_EQUAL);
+}
+
+Value *primitiveF64VectorScale(int argc, Value **argv) {
+    return numVectorScale(argc, argv, F64VECTOR_TYPE);
+}
+
+Value *primitiveF64VectorDot(int argc, Value **argv) {
+    return numVectorTotal(argc, argv, F64VECTOR_TYPE, 1);
+}
+
+Value *primitiveF64VectorSum(int argc, Value **argv) {
+    return numVectorTotal(argc, argv, F64VECTOR_TYPE, 0);
+}
+
+Value *primitiveF64VectorMin(int argc, Value **argv) {
+    return numVectorExtremum(argc, argv, F64VECTOR_TYPE, 0);
+}
+
+Value *primitiveF64VectorMax(int argc, Value **argv) {
+    return numVectorExtremum(argc, argv, F64VECTOR_TYPE, 1);
+}
+
+Value *primitiveMakeS64Vector(int argc, Value **argv) {
+    return makeNumVectorOf(argc, argv, S64VECTOR_TYPE);
+}
+
+Value *primitiveS64Vector(int argc, Value **argv) {
+    return numVectorOf(argc, argv, S64VECTOR_TYPE);
+}
+
+Value *primitiveIsS64Vector(int argc, Value **argv) {
+    return isNumVector(argc, argv, S64VECTOR_TYPE);
+}
+
+Value *primitiveS64VectorLength(int argc, Value **argv) {
+    return numVectorLength(argc, argv, S64VECTOR_TYPE);
+}
+
+Value *primitiveS64VectorRef(int argc, Value **argv) {
+    return numVectorRef(argc, argv, S64VECTOR_TYPE);
+}
+
+Value *primitiveS64VectorSet(int argc, Value **argv) {
+    return numVectorSet(argc, argv, S64VECTOR_TYPE);
+}
+
+Value *primitiveS64VectorToList(int argc, Value **argv) {
+    return numVectorToList(argc, argv, S64VECTOR_TYPE);
+}
+
+Value *primitiveListToS64Vector(int argc, Value **argv) {
+    return listToNumVector(argc, argv, S64VECTOR_TYPE);
+}
+
+Value *primitiveS64VectorAdd(int argc, Value **argv) {
+    return numVectorLanes(argc, argv, S64VECTOR_TYPE, LANE_ADD);
+}
+
+Value *primitiveS64VectorSub(int argc, Value **argv) {
+    return numVectorLanes(argc, argv, S64VECTOR_TYPE, LANE_SUB);
+}
+
+Value *primitiveS64VectorMul(int argc, Value **argv) {
+    return numVectorLanes(argc, argv, S64VECTOR_TYPE, LANE_MUL);
+}
+
+Value *primitiveS64VectorDiv(int argc, Value **argv) {
+    return numVectorLanes(argc, argv, S64VECTOR_TYPE, LANE_DIV);
+}
+
+Value *primitiveS64VectorLess(int argc, Value **argv) {
+    return numVectorLanes(argc, argv, S64VECTOR_TYPE, LANE_LESS);
+}
+
+Value *primitiveS64VectorEqual(int argc, Value **argv) {
+    return numVectorLanes(argc, argv, S64VECTOR_TYPE, LANE_EQUAL);
+}
+
+Value *primitiveS64VectorScale(int argc, Value **argv) {
+    return numVectorScale(argc, argv, S64VECTOR_TYPE);
+}
+
+Value *primitiveS64VectorDot(int argc, Value **argv) {
+    return numVectorTotal(argc, argv, S64VECTOR_TYPE, 1);
+}
+
+Value *primitiveS64VectorSum(int argc, Value **argv) {
+    return numVectorTotal(argc, argv, S64VECTOR_TYPE, 0);
+}
+
+Value *primitiveS64VectorMin(int argc, Value **argv) {
+    return numVectorExtremum(argc, argv, S64VECTOR_TYPE, 0);
+}
+
+Value *primitiveS64VectorMax(int argc, Value **argv) {
+    return numVectorExtremum(argc, argv, S64VECTOR_TYPE, 1);
+}
+
+// checks that argv holds a bytevector followed by from min to max more
+// arguments
+void checkBytevector(int argc, Value **argv, int min, int max) {
+    if (argc < min + 1 || argc > max + 1 ||
+        argv[0]->type != BYTEVECTOR_TYPE) {
+        handleInterpError(216);
+    }
+}
+
+// returns index, an argument of a bytevector primitive, checking that it
+// is from 0 to limit
+long bytevectorIndex(Value *index, long limit) {
+    if (index->type != INT_TYPE) {
+        handleInterpError(216);
+    }
+    if (index->i < 0 || index->i > limit) {
+        handleInterpError(217);
+    }
+    return index->i;
+}
+
+// reads the optional start and end arguments of a bytevector primitive,
+// from argv[first] on, which are 0 and the length of bytevector by default
+void bytevectorRange(int argc, Value **argv, int first, Value *bytevector,
+                     long *start, long *end) {
+    *end = bytevector->bv.length;
+    if (argc > first + 1) {
+        *end = bytevectorIndex(argv[first + 1], *end);
+    }
+    *start = argc > first ? bytevectorIndex(argv[first], *end) : 0;
+}
+
+// returns value, checking that it is a byte
+unsigned char byteOf(Value *value) {
+    if (value->type != INT_TYPE) {
+        handleInterpError(216);
+    }
+    if (value->i < 0 || value->i > 255) {
+        handleInterpError(218);
+    }
+    return value->i;
+}
+
+// returns whether the endianness argument of a bytevector primitive, the
+// symbol big or little, is big
+int isBigEndian(Value *endianness) {
+    if (endianness->type == SYMBOL_TYPE) {
+        if (!strcmp(endianness->s, "big")) {
+            return 1;
+        }
+        if (!strcmp(endianness->s, "little")) {
+            return 0;
+        }
+    }
+    handleInterpError(216);
+    return 0;
+}
+
+Value *primitiveMakeBytevector(int argc, Value **argv) {
+    if (argc < 1 || argc > 2 || argv[0]->type != INT_TYPE) {
+        handleInterpError(216);
+    }
+    if (argv[0]->i < 0) {
+        handleInterpError(217);
+    }
+    Value *bytevector = makeBytevector(argv[0]->i);
+    if (argc == 2) {
+        memset(bytevector->bv.bytes, byteOf(argv[1]), argv[0]->i);
+    }
+    return bytevector;
+}
+
+Value *primitiveBytevector(int argc, Value **argv) {
+    Value *bytevector = makeBytevector(argc);
+    for (int i = 0; i < argc; i++) {
+        bytevector->bv.bytes[i] = byteOf(argv[i]);
+    }
+    return bytevector;
+}
+
+Value *primitiveIsBytevector(int argc, Value **argv) {
+    if (argc != 1) {
+        handleInterpError(216);
+    }
+    return argv[0]->type == BYTEVECTOR_TYPE ? makeTrue() : makeFalse();
+}
+
+Value *primitiveBytevectorLength(int argc, Value **argv) {
+    checkBytevector(argc, argv, 0, 0);
+    return makeInt(argv[0]->bv.length);
+}
+
+Value *primitiveBytevectorU8Ref(int argc, Value **argv) {
+    checkBytevector(argc, argv, 1, 1);
+    long index = bytevectorIndex(argv[1], argv[0]->bv.length - 1);
+    return makeInt(argv[0]->bv.bytes[index]);
+}
+
+Value *primitiveBytevectorU8Set(int argc, Value **argv) {
+    checkBytevector(argc, argv, 2, 2);
+    long index = bytevectorIndex(argv[1], argv[0]->bv.length - 1);
+    argv[0]->bv.bytes[index] = byteOf(argv[2]);
+    return makeVoid();
+}
+
+Value *primitiveBytevectorCopy(int argc, Value **argv) {
+    checkBytevector(argc, argv, 0, 2);
+    long start;
+    long end;
+    bytevectorRange(argc, argv, 1, argv[0], &start, &end);
+    Value *copy = makeBytevector(end - start);
+    memcpy(copy->bv.bytes, argv[0]->bv.bytes + start, end - start);
+    return copy;
+}
+
+// (bytevector-copy! to at from [start [end]]), which may copy within one
+// bytevector
+Value *primitiveBytevectorCopyInto(int argc, Value **argv) {
+    checkBytevector(argc, argv, 2, 4);
+    if (argv[2]->type != BYTEVECTOR_TYPE) {
+        handleInterpError(216);
+    }
+    long at = bytevectorIndex(argv[1], argv[0]->bv.length);
+    long start;
+    long end;
+    bytevectorRange(argc, argv, 3, argv[2], &start, &end);
+    if (end - start > argv[0]->bv.length - at) {
+        handleInterpError(217);
+    }
+    memmove(argv[0]->bv.bytes + at, argv[2]->bv.bytes + start, end - start);
+    return makeVoid();
+}
+
+// The fields of more than one byte are read by (bytevector-u16-ref
+// bytevector index endianness) and written by (bytevector-u16-set!
+// bytevector index value endianness), and likewise for the other sizes,
+// for signed integers and for floats; each name has a wrapper passing the
+// size and kind to the code they share.
+
+// returns the offset of the field of size bytes at index in bytevector,
+// checking that all of it is in the bytevector
+long fieldOffset(Value *bytevector, Value *index, int size) {
+    return bytevectorIndex(index, bytevector->bv.length - size);
+}
+
+Value *integerFieldRef(int argc, Value **argv, int size, int isSigned) {
+    checkBytevector(argc, argv, 2, 2);
+    long offset = fieldOffset(argv[0], argv[1], size);
+    unsigned long n = loadBytes(argv[0]->bv.bytes + offset, size,
+                                isBigEndian(argv[2]));
+    if (isSigned) {
+        int shift = 64 - 8 * size;
+        return makeInt((long)(n << shift) >> shift);
+    }
+    return integerFromUnsigned(n);
+}
+
+Value *integerFieldSet(int argc, Value **argv, int size, int isSigned) {
+    checkBytevector(argc, argv, 3, 3);
+    long offset = fieldOffset(argv[0], argv[1], size);
+    Value *value = argv[2];
+    if (!isExactInteger(value)) {
+        handleInterpError(216);
+    }
+    unsigned long n;
+    if (isSigned) {
+        int shift = 64 - 8 * size;
+        if (value->type != INT_TYPE ||
+            (long)((unsigned long)value->i << shift) >> shift != value->i) {
+            handleInterpError(218);
+        }
+        n = value->i;
+    }
+    else if (!integerToUnsigned(value, &n) ||
+             (size < 8 && n >> 8 * size != 0)) {
+        handleInterpError(218);
+    }
+    storeBytes(argv[0]->bv.bytes + offset, size, isBigEndian(argv[3]), n);
+    return makeVoid();
+}
+
+// floats are 4 bytes and doubles 8
+Value *floatFieldRef(int argc, Value **argv, int size) {
+    checkBytevector(argc, argv, 2, 2);
+    long offset = fieldOffset(argv[0], argv[1], size);
+    unsigned long n = loadBytes(argv[0]->bv.bytes + offset, size,
+                                isBigEndian(argv[2]));
+    if (size == 4) {
+        unsigned int bits = n;
+        float f;
+        memcpy(&f, &bits, 4);
+        return makeDouble(f);
+    }
+    double d;
+    memcpy(&d, &n, 8);
+    return makeDouble(d);
+}
+
+Value *floatFieldSet(int argc, Value **argv, int size) {
+    checkBytevector(argc, argv, 3, 3);
+    long offset = fieldOffset(argv[0], argv[1], size);
+    double d = toDouble(argv[2], 216);
+    unsigned long n;
+    if (size == 4) {
+        float f = d;
+        unsigned int bits;
+        memcpy(&bits, &f, 4);
+        n = bits;
+    }
+    else {
+        memcpy(&n, &d, 8);
+    }
+    storeBytes(argv[0]->bv.bytes + offset, size, isBigEndian(argv[3]), n);
+    return makeVoid();
+}
+
+Value *primitiveBytevectorU16Ref(int argc, Value **argv) {
+    return integerFieldRef(argc, argv, 2, 0);
+}
+
+Value *primitiveBytevectorU16Set(int argc, Value **argv) {
+    return integerFieldSet(argc, argv, 2, 0);
+}
+
+Value *primitiveBytevectorS16Ref(int argc, Value **argv) {
+    return integerFieldRef(argc, argv, 2, 1);
+}
+
+Value *primitiveBytevectorS16Set(int argc, Value **argv) {
+    return integerFieldSet(argc, argv, 2, 1);
+}
+
+Value *primitiveBytevectorU32Ref(int argc, Value **argv) {
+    return integerFieldRef(argc, argv, 4, 0);
+}
+
+Value *primitiveBytevectorU32Set(int argc, Value **argv) {
+    return integerFieldSet(argc, argv, 4, 0);
+}
+
+Value *primitiveBytevectorS32Ref(int argc, Value **argv) {
+    return integerFieldRef(argc, argv, 4, 1);
+}
+
+Value *primitiveBytevectorS32Set(int argc, Value **argv) {
+    return integerFieldSet(argc, argv, 4, 1);
+}
+
+Value *primitiveBytevectorU64Ref(int argc, Value **argv) {
+    return integerFieldRef(argc, argv, 8, 0);
+}
+
+Value *primitiveBytevectorU64Set(int argc, Value **argv) {
+    return integerFieldSet(argc, argv, 8, 0);
+}
+
+Value *primitiveBytevectorS64Ref(int argc, Value **argv) {
+    return integerFieldRef(argc, argv, 8, 1);
+}
+
+Value *primitiveBytevectorS64Set(int argc, Value **argv) {
+    return integerFieldSet(argc, argv, 8, 1);
+}
+
+Value *primitiveBytevectorSingleRef(int argc, Value **argv) {
+    return floatFieldRef(argc, argv, 4);
+}
+
+Value *primitiveBytevectorSingleSet(int argc, Value **argv) {
+    return floatFieldSet(argc, argv, 4);
+}
+
+Value *primitiveBytevectorDoubleRef(int argc, Value **argv) {
+    return floatFieldRef(argc, argv, 8);
+}
+
+Value *primitiveBytevectorDoubleSet(int argc, Value **argv) {
+    return floatFieldSet(argc, argv, 8);
+}
+
+// a bytevector of the whole file named by a string; big files are mapped
+// rather than read
+Value *primitiveFileToBytevector(int argc, Value **argv) {
+    if (argc != 1 || argv[0]->type != STR_TYPE) {
+        handleInterpError(216);
+    }
+    Value *bytevector = readBytevectorFile(stringToC(argv[0]));
+    if (bytevector == NULL) {
+        handleInterpError(219);
+    }
+    return bytevector;
+}
+
+// (bytevector->file bytevector name) replaces the file with the bytes
+Value *primitiveBytevectorToFile(int argc, Value **argv) {
+    checkBytevector(argc, argv, 1, 1);
+    if (argv[1]->type != STR_TYPE) {
+        handleInterpError(216);
+    }
+    if (!writeBytevectorFile(stringToC(argv[1]), argv[0])) {
+        handleInterpError(219);
+    }
+    return makeVoid();
+}
+
+Value *primitiveUtf8ToString(int argc, Value **argv) {
+    checkBytevector(argc, argv, 0, 2);
+    long start;
+    long end;
+    bytevectorRange(argc, argv, 1, argv[0], &start, &end);
+    char *chars = talloc(end - start);
+    memcpy(chars, argv[0]->bv.bytes + start, end - start);
+    return makeText(chars, end - start);
+}
+
+Value *primitiveStringToUtf8(int argc, Value **argv) {
+    if (argc != 1 || argv[0]->type != STR_TYPE) {
+        handleInterpError(216);
+    }
+    Value *bytevector = makeBytevector(argv[0]->str.length);
+    memcpy(bytevector->bv.bytes, stringChars(argv[0]), argv[0]->str.length);
+    return bytevector;
+}
+
+// A promise computes its value the first time it is forced and keeps it.
+// Streams are pairs whose cdr is a promise of the rest of the stream, or
+// the empty list; the stream primitives build the rest of what they return
+// as promises to call themselves again, so that nothing is computed before
+// it is asked for.
+
+// returns a new promise to call procedure on the list args, whose result
+// is a promise to force in turn if lazy is set
+Value *makePromise(Value *procedure, Value *args, int lazy) {
+    Value *value = makeNull();
+    value->type = PROMISE_TYPE;
+    value->promise = talloc(sizeof(struct Promise));
+    value->promise->done = 0;
+    value->promise->lazy = lazy;
+    value->promise->value = procedure;
+    value->promise->args = args;
+    return value;
+}
+
+// returns a PRIMITIVE_TYPE value of function, for a promise to call
+Value *primitiveValue(Value *(*function)(int, Value **)) {
+    Value *value = makeNull();
+    value->type = PRIMITIVE_TYPE;
+    value->pf = function;
+    return value;
+}
+
+// returns the result of promise, computing it if it is not done; a value
+// that is not a promise is its own result. A chain of delay-force is
+// followed in a loop, each promise in it taking over the state of the next,
+// so forcing it takes constant stack however long it is.
+Value *force(Value *promise) {
+    if (promise->type != PROMISE_TYPE) {
+        return promise;
+    }
+    struct Promise *state = promise->promise;
+    while (!state->done) {
+        int argc = length(state->args);
+        Value **argv = talloc(argc * sizeof(Value *));
+        Value *args = state->args;
+        for (int i = 0; i < argc; i++) {
+            argv[i] = car(args);
+            args = cdr(args);
+        }
+        Value *result = apply(state->value, argc, argv);
+        if (state->done) {
+            // forcing it again while it ran finished it first
+            break;
+        }
+        if (!state->lazy) {
+            state->done = 1;
+            state->value = result;
+            state->args = NULL;
+            break;
+        }
+        if (result->type != PROMISE_TYPE) {
+            handleInterpError(222);
+        }
+        *state = *result->promise;
+        result->promise = state;
+    }
+    return state->value;
+}
+
+// (delay expr) is (#delay thunk), for a thunk returning expr
+Value *primitiveDelay(int argc, Value **argv) {
+    return makePromise(argv[0], makeNull(), 0);
+}
+
+// (delay-force expr) is (#delay-force thunk), for a thunk returning expr,
+// which must be a promise
+Value *primitiveDelayForce(int argc, Value **argv) {
+    return makePromise(argv[0], makeNull(), 1);
+}
+
+Value *primitiveForce(int argc, Value **argv) {
+    if (argc != 1) {
+        handleInterpError(221);
+    }
+    return force(argv[0]);
+}
+
+// a promise already done with the argument, or the argument if it is a
+// promise
+Value *primitiveMakePromise(int argc, Value **argv) {
+    if (argc != 1) {
+        handleInterpError(221);
+    }
+    if (argv[0]->type == PROMISE_TYPE) {
+        return argv[0];
+    }
+    Value *promise = makePromise(NULL, NULL, 0);
+    promise->promise->done = 1;
+    promise->promise->value = argv[0];
+    return promise;
+}
+
+Value *primitiveIsPromise(int argc, Value **argv) {
+    if (argc != 1) {
+        handleInterpError(221);
     }
-    else {
-        return makeTrue();
+    return argv[0]->type == PROMISE_TYPE ? makeTrue() : makeFalse();
+}
+
+// returns stream, or the stream a promise of one computes, checking that
+// it is a pair or empty
+Value *forceStream(Value *stream) {
+    stream = force(stream);
+    if (stream->type != CONS_TYPE && stream->type != NULL_TYPE) {
+        handleInterpError(223);
+    }
+    return stream;
+}
+
+Value *primitiveStreamCar(int argc, Value **argv) {
+    if (argc != 1 || argv[0]->type != CONS_TYPE) {
+        handleInterpError(223);
+    }
+    return car(argv[0]);
+}
+
+Value *primitiveStreamCdr(int argc, Value **argv) {
+    if (argc != 1 || argv[0]->type != CONS_TYPE) {
+        handleInterpError(223);
+    }
+    return forceStream(cdr(argv[0]));
+}
+
+// (stream-map procedure stream ...) is as long as the shortest stream
+Value *primitiveStreamMap(int argc, Value **argv) {
+    if (argc < 2 || !isProcedure(argv[0])) {
+        handleInterpError(223);
+    }
+    Value **firsts = talloc((argc - 1) * sizeof(Value *));
+    Value *rests = makeNull();
+    for (int i = argc - 1; i >= 1; i--) {
+        Value *stream = forceStream(argv[i]);
+        if (stream->type == NULL_TYPE) {
+            return stream;
+        }
+        firsts[i - 1] = car(stream);
+        rests = cons(cdr(stream), rests);
+    }
+    Value *first = apply(argv[0], argc - 1, firsts);
+    Value *rest = makePromise(primitiveValue(primitiveStreamMap),
+                              cons(argv[0], rests), 0);
+    return cons(first, rest);
+}
+
+// (stream-filter predicate stream) skips the elements that predicate
+// rejects in a loop, however many of them there are in a row
+Value *primitiveStreamFilter(int argc, Value **argv) {
+    if (argc != 2 || !isProcedure(argv[0])) {
+        handleInterpError(223);
+    }
+    Value *stream = forceStream(argv[1]);
+    while (stream->type == CONS_TYPE) {
+        Value *first = car(stream);
+        Value *kept = apply(argv[0], 1, &first);
+        if (kept->type != BOOL_TYPE || kept->i) {
+            Value *args = cons(argv[0], cons(cdr(stream), makeNull()));
+            return cons(first,
+                        makePromise(primitiveValue(primitiveStreamFilter),
+                                    args, 0));
+        }
+        stream = forceStream(cdr(stream));
+    }
+    return stream;
+}
+
+// (stream-take n stream) is the stream of the first n elements of stream,
+// or all of them if it has fewer
+Value *primitiveStreamTake(int argc, Value **argv) {
+    if (argc != 2 || argv[0]->type != INT_TYPE || argv[0]->i < 0) {
+        handleInterpError(223);
+    }
+    if (argv[0]->i == 0) {
+        return makeNull();
+    }
+    Value *stream = forceStream(argv[1]);
+    if (stream->type == NULL_TYPE) {
+        return stream;
+    }
+    Value *args = cons(makeInt(argv[0]->i - 1),
+                       cons(cdr(stream), makeNull()));
+    return cons(car(stream),
+                makePromise(primitiveValue(primitiveStreamTake), args, 0));
+}
+
+// (stream->list [n] stream) is a list of the first n elements of stream,
+// or of all of them
+Value *primitiveStreamToList(int argc, Value **argv) {
+    if (argc < 1 || argc > 2 ||
+        (argc == 2 && (argv[0]->type != INT_TYPE || argv[0]->i < 0))) {
+        handleInterpError(223);
+    }
+    long count = argc == 2 ? argv[0]->i : LONG_MAX;
+    Value *stream = forceStream(argv[argc - 1]);
+    Value *list = makeNull();
+    for (long i = 0; i < count && stream->type == CONS_TYPE; i++) {
+        list = cons(car(stream), list);
+        if (i + 1 < count) {
+            stream = forceStream(cdr(stream));
+        }
+    }
+    return reverse(list);
+}
+
+// Data files are read one datum at a time, by the tokenizer and parser
+// that read programs, from a port with a buffer of PORT_BUFFER bytes, so
+// that reading a datum takes only as much of the file as it spans.
+
+#define PORT_BUFFER (1 << 16)
+
+// the port on stdin that read takes when it is given none, once it has
+Value *standardInput = NULL;
+
+Value *primitiveOpenInputFile(int argc, Value **argv) {
+    if (argc != 1 || argv[0]->type != STR_TYPE) {
+        handleInterpError(227);
+    }
+    FILE *file = fopen(stringToC(argv[0]), "r");
+    if (file == NULL) {
+        handleInterpError(228);
+    }
+    setvbuf(file, NULL, _IOFBF, PORT_BUFFER);
+    Value *value = makeNull();
+    value->type = PORT_TYPE;
+    value->port = makePort(file);
+    return value;
+}
+
+// returns the port argument of a port primitive, or the port on stdin if
+// it has none, checking that it is open
+Port *portOf(int argc, Value **argv) {
+    if (argc > 1 || (argc == 1 && argv[0]->type != PORT_TYPE)) {
+        handleInterpError(227);
+    }
+    if (argc == 0 && standardInput == NULL) {
+        standardInput = makeNull();
+        standardInput->type = PORT_TYPE;
+        standardInput->port = makePort(stdin);
+    }
+    Port *port = argc == 1 ? argv[0]->port : standardInput->port;
+    if (port->file == NULL) {
+        handleInterpError(227);
+    }
+    return port;
+}
+
+Value *primitiveClosePort(int argc, Value **argv) {
+    if (argc != 1 || argv[0]->type != PORT_TYPE) {
+        handleInterpError(227);
+    }
+    if (argv[0]->port->file != NULL) {
+        fclose(argv[0]->port->file);
+        argv[0]->port->file = NULL;
+    }
+    return makeVoid();
+}
+
+Value *primitiveIsInputPort(int argc, Value **argv) {
+    if (argc != 1) {
+        handleInterpError(227);
+    }
+    return argv[0]->type == PORT_TYPE ? makeTrue() : makeFalse();
+}
+
+// returns a new end of file object
+Value *makeEof() {
+    Value *value = makeNull();
+    value->type = EOF_TYPE;
+    return value;
+}
+
+// (read [port]) returns the next datum, or the end of file object; a
+// syntax error in the file is raised as an error of the program, rather
+// than stopping it as one in the program itself does
+Value *primitiveRead(int argc, Value **argv) {
+    Port *port = portOf(argc, argv);
+    jmp_buf jump;
+    jmp_buf *outer = syntaxErrorJump;
+    syntaxErrorJump = &jump;
+    if (setjmp(jump) != 0) {
+        syntaxErrorJump = outer;
+        handleInterpError(229);
+    }
+    Value *datum = readDatum(port);
+    syntaxErrorJump = outer;
+    return datum == NULL ? makeEof() : datum;
+}
+
+Value *primitiveEofObject(int argc, Value **argv) {
+    if (argc != 0) {
+        handleInterpError(227);
+    }
+    return makeEof();
+}
+
+Value *primitiveIsEofObject(int argc, Value **argv) {
+    if (argc != 1) {
+        handleInterpError(227);
     }
+    return argv[0]->type == EOF_TYPE ? makeTrue() : makeFalse();
 }
 
 /*** EVALUATION CODE ***/
@@ -693,9 +2882,10 @@ Value *primitiveGrEq(Value *args) {
  * also includes helper functions for evaluation methods
  */
 
-// interprets scheme tree as code
-void interpret(Value *tree) {
+// returns the global frame, with every primitive bound in it
+Frame *makeGlobalFrame() {
     Frame *newFrame = makeFirstFrame();
+    handlers = makeNull();
     bindPrim("+", primitiveAdd, newFrame);
     bindPrim("null?", primitiveNull, newFrame);
     bindPrim("car", primitiveCar, newFrame);
@@ -705,548 +2895,839 @@ void interpret(Value *tree) {
     bindPrim("-", primitiveSub, newFrame);
     bindPrim("/", primitiveDiv, newFrame);
     bindPrim("modulo", primitiveMod, newFrame);
+    bindPrim("quotient", primitiveQuotient, newFrame);
+    bindPrim("remainder", primitiveRemainder, newFrame);
+    bindPrim("abs", primitiveAbs, newFrame);
+    bindPrim("min", primitiveMin, newFrame);
+    bindPrim("max", primitiveMax, newFrame);
     bindPrim("<", primitiveLess, newFrame);
     bindPrim(">", primitiveGreater, newFrame);
     bindPrim("<=", primitiveLessEq, newFrame);
     bindPrim(">=", primitiveGrEq, newFrame);
     bindPrim("=", primitiveEqual, newFrame);
-    
-    while (tree->type != NULL_TYPE) {
-        Value *val = eval(car(tree), newFrame);
+    bindPrim("error", primitiveError, newFrame);
+    bindPrim("raise", primitiveRaise, newFrame);
+    bindPrim("raise-continuable", primitiveRaiseContinuable, newFrame);
+    bindPrim("with-exception-handler", primitiveWithHandler, newFrame);
+    bindPrim("error-object?", primitiveIsErrorObject, newFrame);
+    bindPrim("error-object-message", primitiveErrorMessage, newFrame);
+    bindPrim("error-object-irritants", primitiveErrorIrritants, newFrame);
+    bindPrim("list", primitiveList, newFrame);
+    bindPrim("length", primitiveLength, newFrame);
+    bindPrim("append", primitiveAppend, newFrame);
+    bindPrim("reverse", primitiveReverse, newFrame);
+    bindPrim("list-tail", primitiveListTail, newFrame);
+    bindPrim("list-ref", primitiveListRef, newFrame);
+    bindPrim("map", primitiveMap, newFrame);
+    bindPrim("for-each", primitiveForEach, newFrame);
+    bindPrim("filter", primitiveFilter, newFrame);
+    bindPrim("fold-left", primitiveFoldLeft, newFrame);
+    bindPrim("fold-right", primitiveFoldRight, newFrame);
+    bindPrim("memq", primitiveMemq, newFrame);
+    bindPrim("memv", primitiveMemv, newFrame);
+    bindPrim("member", primitiveMember, newFrame);
+    bindPrim("assq", primitiveAssq, newFrame);
+    bindPrim("assv", primitiveAssv, newFrame);
+    bindPrim("assoc", primitiveAssoc, newFrame);
+    bindPrim("sort", primitiveSort, newFrame);
+    bindPrim("list-sort", primitiveListSort, newFrame);
+    bindPrim("vector-sort!", primitiveVectorSort, newFrame);
+    bindPrim("make-vector", primitiveMakeVector, newFrame);
+    bindPrim("vector", primitiveVector, newFrame);
+    bindPrim("vector?", primitiveIsVector, newFrame);
+    bindPrim("vector-ref", primitiveVectorRef, newFrame);
+    bindPrim("vector-set!", primitiveVectorSet, newFrame);
+    bindPrim("vector-length", primitiveVectorLength, newFrame);
+    bindPrim("vector-fill!", primitiveVectorFill, newFrame);
+    bindPrim("vector->list", primitiveVectorToList, newFrame);
+    bindPrim("list->vector", primitiveListToVector, newFrame);
+    bindPrim("eq?", primitiveIsEq, newFrame);
+    bindPrim("eqv?", primitiveIsEqv, newFrame);
+    bindPrim("equal?", primitiveIsEqual, newFrame);
+    bindPrim("make-hash-table", primitiveMakeHashTable, newFrame);
+    bindPrim("hash-table?", primitiveIsHashTable, newFrame);
+    bindPrim("hash-table-ref", primitiveHashTableRef, newFrame);
+    bindPrim("hash-table-ref/default", primitiveHashTableRefDefault,
+             newFrame);
+    bindPrim("hash-table-set!", primitiveHashTableSet, newFrame);
+    bindPrim("hash-table-delete!", primitiveHashTableDelete, newFrame);
+    bindPrim("hash-table-count", primitiveHashTableCount, newFrame);
+    bindPrim("hash-table-walk", primitiveHashTableWalk, newFrame);
+    bindPrim("string?", primitiveIsString, newFrame);
+    bindPrim("string-length", primitiveStringLength, newFrame);
+    bindPrim("string-append", primitiveStringAppend, newFrame);
+    bindPrim("substring", primitiveSubstring, newFrame);
+    bindPrim("string-copy", primitiveStringCopy, newFrame);
+    bindPrim("string-ref", primitiveStringRef, newFrame);
+    bindPrim("string=?", primitiveStringEqual, newFrame);
+    bindPrim("string<?", primitiveStringLess, newFrame);
+    bindPrim("string->list", primitiveStringToList, newFrame);
+    bindPrim("make-f64vector", primitiveMakeF64Vector, newFrame);
+    bindPrim("f64vector", primitiveF64Vector, newFrame);
+    bindPrim("f64vector?", primitiveIsF64Vector, newFrame);
+    bindPrim("f64vector-length", primitiveF64VectorLength, newFrame);
+    bindPrim("f64vector-ref", primitiveF64VectorRef, newFrame);
+    bindPrim("f64vector-set!", primitiveF64VectorSet, newFrame);
+    bindPrim("f64vector->list", primitiveF64VectorToList, newFrame);
+    bindPrim("list->f64vector", primitiveListToF64Vector, newFrame);
+    bindPrim("f64vector-add", primitiveF64VectorAdd, newFrame);
+    bindPrim("f64vector-sub", primitiveF64VectorSub, newFrame);
+    bindPrim("f64vector-mul", primitiveF64VectorMul, newFrame);
+    bindPrim("f64vector-div", primitiveF64VectorDiv, newFrame);
+    bindPrim("f64vector-less", primitiveF64VectorLess, newFrame);
+    bindPrim("f64vector-equal", primitiveF64VectorEqual, newFrame);
+    bindPrim("f64vector-scale", primitiveF64VectorScale, newFrame);
+    bindPrim("f64vector-dot", primitiveF64VectorDot, newFrame);
+    bindPrim("f64vector-sum", primitiveF64VectorSum, newFrame);
+    bindPrim("f64vector-min", primitiveF64VectorMin, newFrame);
+    bindPrim("f64vector-max", primitiveF64VectorMax, newFrame);
+    bindPrim("make-s64vector", primitiveMakeS64Vector, newFrame);
+    bindPrim("s64vector", primitiveS64Vector, newFrame);
+    bindPrim("s64vector?", primitiveIsS64Vector, newFrame);
+    bindPrim("s64vector-length", primitiveS64VectorLength, newFrame);
+    bindPrim("s64vector-ref", primitiveS64VectorRef, newFrame);
+    bindPrim("s64vector-set!", primitiveS64VectorSet, newFrame);
+    bindPrim("s64vector->list", primitiveS64VectorToList, newFrame);
+    bindPrim("list->s64vector", primitiveListToS64Vector, newFrame);
+    bindPrim("s64vector-add", primitiveS64VectorAdd, newFrame);
+    bindPrim("s64vector-sub", primitiveS64VectorSub, newFrame);
+    bindPrim("s64vector-mul", primitiveS64VectorMul, newFrame);
+    bindPrim("s64vector-div", primitiveS64VectorDiv, newFrame);
+    bindPrim("s64vector-less", primitiveS64VectorLess, newFrame);
+    bindPrim("s64vector-equal", primitiveS64VectorEqual, newFrame);
+    bindPrim("s64vector-scale", primitiveS64VectorScale, newFrame);
+    bindPrim("s64vector-dot", primitiveS64VectorDot, newFrame);
+    bindPrim("s64vector-sum", primitiveS64VectorSum, newFrame);
+    bindPrim("s64vector-min", primitiveS64VectorMin, newFrame);
+    bindPrim("s64vector-max", primitiveS64VectorMax, newFrame);
+    bindPrim("make-bytevector", primitiveMakeBytevector, newFrame);
+    bindPrim("bytevector", primitiveBytevector, newFrame);
+    bindPrim("bytevector?", primitiveIsBytevector, newFrame);
+    bindPrim("bytevector-length", primitiveBytevectorLength, newFrame);
+    bindPrim("bytevector-u8-ref", primitiveBytevectorU8Ref, newFrame);
+    bindPrim("bytevector-u8-set!", primitiveBytevectorU8Set, newFrame);
+    bindPrim("bytevector-copy", primitiveBytevectorCopy, newFrame);
+    bindPrim("bytevector-copy!", primitiveBytevectorCopyInto, newFrame);
+    bindPrim("bytevector-u16-ref", primitiveBytevectorU16Ref, newFrame);
+    bindPrim("bytevector-u16-set!", primitiveBytevectorU16Set, newFrame);
+    bindPrim("bytevector-s16-ref", primitiveBytevectorS16Ref, newFrame);
+    bindPrim("bytevector-s16-set!", primitiveBytevectorS16Set, newFrame);
+    bindPrim("bytevector-u32-ref", primitiveBytevectorU32Ref, newFrame);
+    bindPrim("bytevector-u32-set!", primitiveBytevectorU32Set, newFrame);
+    bindPrim("bytevector-s32-ref", primitiveBytevectorS32Ref, newFrame);
+    bindPrim("bytevector-s32-set!", primitiveBytevectorS32Set, newFrame);
+    bindPrim("bytevector-u64-ref", primitiveBytevectorU64Ref, newFrame);
+    bindPrim("bytevector-u64-set!", primitiveBytevectorU64Set, newFrame);
+    bindPrim("bytevector-s64-ref", primitiveBytevectorS64Ref, newFrame);
+    bindPrim("bytevector-s64-set!", primitiveBytevectorS64Set, newFrame);
+    bindPrim("bytevector-ieee-single-ref", primitiveBytevectorSingleRef,
+             newFrame);
+    bindPrim("bytevector-ieee-single-set!", primitiveBytevectorSingleSet,
+             newFrame);
+    bindPrim("bytevector-ieee-double-ref", primitiveBytevectorDoubleRef,
+             newFrame);
+    bindPrim("bytevector-ieee-double-set!", primitiveBytevectorDoubleSet,
+             newFrame);
+    bindPrim("file->bytevector", primitiveFileToBytevector, newFrame);
+    bindPrim("bytevector->file", primitiveBytevectorToFile, newFrame);
+    bindPrim("utf8->string", primitiveUtf8ToString, newFrame);
+    bindPrim("string->utf8", primitiveStringToUtf8, newFrame);
+    bindPrim("#cons", primitiveCons, newFrame);
+    bindPrim("#delay", primitiveDelay, newFrame);
+    bindPrim("#delay-force", primitiveDelayForce, newFrame);
+    bindPrim("force", primitiveForce, newFrame);
+    bindPrim("make-promise", primitiveMakePromise, newFrame);
+    bindPrim("promise?", primitiveIsPromise, newFrame);
+    bindPrim("stream-car", primitiveStreamCar, newFrame);
+    bindPrim("stream-cdr", primitiveStreamCdr, newFrame);
+    bindPrim("stream-map", primitiveStreamMap, newFrame);
+    bindPrim("stream-filter", primitiveStreamFilter, newFrame);
+    bindPrim("stream-take", primitiveStreamTake, newFrame);
+    bindPrim("stream->list", primitiveStreamToList, newFrame);
+    bindPrim("open-input-file", primitiveOpenInputFile, newFrame);
+    bindPrim("close-input-port", primitiveClosePort, newFrame);
+    bindPrim("input-port?", primitiveIsInputPort, newFrame);
+    bindPrim("read", primitiveRead, newFrame);
+    bindPrim("eof-object", primitiveEofObject, newFrame);
+    bindPrim("eof-object?", primitiveIsEofObject, newFrame);
+    bindPrim("call/ec", primitiveCallEc, newFrame);
+    // only escaping continuations are supported
+    bindPrim("call-with-current-continuation", primitiveCallEc, newFrame);
+    // what guard expands to; programs cannot name them
+    bindPrim("#guard", primitiveGuard, newFrame);
+    bindPrim("#reraise", primitiveReraise, newFrame);
+    return newFrame;
+}
+
+// the program interpret runs
+Value *program;
+int programBytecode;
+
+// where runDeep returns to once its body is done
+ucontext_t deepReturn;
+
+// Runs form(data), a top-level form, and returns its value. If it raises
+// an error that nothing catches, the error is reported and NULL returned;
+// the global frame keeps whatever the form defined before the error.
+Value *runTopLevel(Value *(*form)(void *), void *data) {
+    ErrorFrame frame;
+    pushErrorFrame(&frame);
+    if (setjmp(frame.jump) == 0) {
+        Value *result = form(data);
+        popErrorFrame(&frame);
+        return result;
+    }
+    popErrorFrame(&frame);
+    reportError(frame.condition);
+    uncaughtErrors++;
+    return NULL;
+}
+
+// the global frame of the program interpret runs
+Frame *programFrame;
+
+Value *evalForm(void *expr) {
+    if (programBytecode) {
+        return vmEval(expr, programFrame);
+    }
+    return eval(expr, programFrame);
+}
+
+void runProgram() {
+    programFrame = makeGlobalFrame();
+    for (Value *tree = program; tree->type != NULL_TYPE; tree = cdr(tree)) {
+        Value *val = runTopLevel(evalForm, car(tree));
+        if (val == NULL) {
+            continue;
+        }
         printVal(val);
         if (val->type != VOID_TYPE) {
             printf("\n");
         }
-        tree = cdr(tree);
     }
 }
 
-Value *evalIf(Value *expr, Frame *frame) {
-    Value *tExpr;
-    Value *fExpr;
-    if (expr->type != CONS_TYPE) {
-        handleInterpError(148);
-    }
-    if (cdr(expr)->type == CONS_TYPE) {
-        tExpr = car(cdr(expr));
-        if (cdr(cdr(expr))->type == CONS_TYPE) {
-            if(cdr(cdr(cdr(expr)))->type != NULL_TYPE) {
-                handleInterpError(149);
-            }
-            fExpr = car(cdr(cdr(expr)));
-        }
-        else {
-            handleInterpError(150);
-        }
-    }
-    else {
-        handleInterpError(151);
-    }
-    Value *check = eval(car(expr), frame);
-    if (check->i) {
-        return eval(tExpr, frame);
-    }
-    else {
-        return eval(fExpr, frame);
-    }
+// Runs body on a C stack of its own, big enough for maxDepth levels of
+// nesting, since evaluation recurses in C; its pages are only committed as
+// the recursion reaches them. A page below it is left inaccessible, so that
+// overrunning it faults rather than writing over whatever is mapped there.
+void runDeep(void (*body)()) {
+    size_t guard = sysconf(_SC_PAGESIZE);
+    size_t size = (size_t)maxDepth * STACK_PER_DEPTH + 2 * STACK_MARGIN;
+    char *region = mmap(NULL, guard + size, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (region == MAP_FAILED) {
+        body();
+        return;
+    }
+    mprotect(region, guard, PROT_NONE);
+    char *stack = region + guard;
+    ucontext_t context;
+    getcontext(&context);
+    context.uc_stack.ss_sp = stack;
+    context.uc_stack.ss_size = size;
+    context.uc_link = &deepReturn;
+    makecontext(&context, body, 0);
+    evalStackLimit = stack + STACK_MARGIN;
+    setJitStackEnd(stack + 2 * STACK_MARGIN);
+    swapcontext(&deepReturn, &context);
+    evalStackLimit = NULL;
+    munmap(region, guard + size);
 }
 
-int inFrame(Value *symbol, Frame *frame) {
-    Value *temp = frame->bindings;
-    while (temp->type == CONS_TYPE) {
-        if (!strcmp(car(car(temp))->s, symbol->s)) {
-            return 1;
-        }
-        temp = cdr(temp);
+// Reports that evaluation nests too deep if the C stack is nearly used up.
+void checkStack() {
+    char here;
+    if (evalStackLimit != NULL && &here < evalStackLimit) {
+        handleInterpError(184);
     }
-    return 0;
 }
 
-Value *evalLetrec(Value *expr, Frame *frame) {
-    
-    if (expr == NULL || expr->type != CONS_TYPE ||
-        car(expr)->type != CONS_TYPE || cdr(expr)->type == NULL_TYPE) {
-        handleInterpError(152);
-    }
-    
-    Frame *newFrame = makeNewFrame(frame);
-    
-    Value *assignList = car(expr);
-    while (assignList->type != NULL_TYPE) {
-        // error checking for assignList
-        if (assignList->type != CONS_TYPE) {
-            handleInterpError(153);
-        }
-        Value *assign = car(assignList); 
-        
-        // error checking for assign
-        if (assign->type != CONS_TYPE) {
-            handleInterpError(154);
-        }
-        else if (cdr(assign)->type != CONS_TYPE) {
-            handleInterpError(155);
-        }
-        else if (cdr(cdr(assign))->type != NULL_TYPE) {
-            handleInterpError(156);
-        }
-        else if (car(assign)->type != SYMBOL_TYPE) {
-            handleInterpError(157);
+// interprets scheme tree as code, on the bytecode VM if bytecode is set and
+// by walking the analyzed tree otherwise; returns the exit status, which is
+// 1 if some form raised an error that nothing caught
+int interpret(Value *tree, int bytecode) {
+    program = tree;
+    programBytecode = bytecode;
+    runDeep(runProgram);
+    return uncaughtErrors > 0;
+}
+
+// Lets evaluation nest depth deep before it is an error.
+void setMaxDepth(int depth) {
+    maxDepth = depth;
+}
+
+Value *evalVariable(Node *node, Frame *frame) {
+    if (node->kind != GLOBAL_NODE) {
+        Value *value = rawVariable(node, frame);
+        if (node->var.boxed) {
+            value = value->box;
         }
-        
-        Value *symbol = car(assign);
-        if (inFrame(symbol, newFrame)) {
-            handleInterpError(158);
+        if (value == NULL) {
+            handleUnbound(node->var.symbol);
         }
-
-        
-        Value *newBind = car(cdr(assign));
-        newFrame->bindings = addBinding(symbol, newBind, newFrame->bindings);
-        assignList = cdr(assignList);
+        return value;
     }
-    assignList = newFrame->bindings;
-    while (assignList->type != NULL_TYPE) {
-        assignList->c.car = cons(car(car(assignList)),   
-                                 eval(cdr(car(assignList)), newFrame));
-        assignList = cdr(assignList);
-    }
-    
-    Value *result;
-    Value *cur = (cdr(expr));
-    while (cur->type != NULL_TYPE){
-        result = eval(car(cur), newFrame);
-        cur = cdr(cur);
+    if (resolveGlobal(node, frame) == NULL) {
+        handleUnbound(node->var.symbol);
     }
-    return result;
+    return node->var.binding->c.cdr;
 }
 
-Value *evalLet(Value *expr, Frame *frame, int star) {
-    if (expr == NULL || expr->type != CONS_TYPE ||
-        car(expr)->type != CONS_TYPE || cdr(expr)->type == NULL_TYPE) {
-        handleInterpError(159);
+// The special forms below evaluate what they do not evaluate in tail
+// position and return the expression left to evaluate in their place, or
+// NULL once they have stored their value in *result. evalNode then
+// evaluates that expression in the same C call, so tail calls take no C
+// stack.
+
+Node *evalIf(Node *node, Frame *frame) {
+    Value *check = evalNode(node->branch.test, frame);
+    if (check->type != BOOL_TYPE || check->i) {
+        return node->branch.conseq;
     }
-    
-    Frame *newFrame = makeNewFrame(frame);
-    
-    Value *assignList = car(expr);
-    while (assignList->type != NULL_TYPE) {
-        // error checking for assignList
-        if (assignList->type != CONS_TYPE) {
-            handleInterpError(160);
-        }
-        Value *assign = car(assignList); 
-        
-        // error checking for assign
-        if (assign->type != CONS_TYPE) {
-            handleInterpError(161);
-        }
-        else if (cdr(assign)->type != CONS_TYPE) {
-            handleInterpError(162);
-        }
-        else if (cdr(cdr(assign))->type != NULL_TYPE) {
-            handleInterpError(163);
-        }
-        else if (car(assign)->type != SYMBOL_TYPE) {
-            handleInterpError(164);
-        }
-        
-        Value *symbol = car(assign);
-        if (inFrame(symbol, newFrame)) {
-            handleInterpError(165);
-        }
+    else {
+        return node->branch.alt;
+    }
+}
 
-        Value *newBind;
-        //difference between let and let* is if it evals in frame or newFrame
-        if (star) {
-            newBind = eval(car(cdr(assign)), newFrame);
+// evaluates let, let* and letrec, pushing the frame of the body in *frame;
+// let evaluates its inits in the enclosing frame, the others in the new one
+Node *evalLet(Node *node, Frame **frame) {
+    int size = node->let.frameSize;
+    Frame *newFrame = pushFrame(*frame, size);
+    Value **slots = newFrame->slots;
+    for (int i = 0; i < size; i++) {
+        slots[i] = NULL;
+    }
+    boxSlots(node->let.boxed, slots, size);
+    Frame *inits = node->kind == LET_NODE ? *frame : newFrame;
+    for (int i = 0; i < node->let.count; i++) {
+        Value *value = evalNode(node->let.inits[i], inits);
+        if (node->let.boxed != NULL && node->let.boxed[i]) {
+            slots[i]->box = value;
         }
         else {
-            newBind = eval(car(cdr(assign)), frame);
+            slots[i] = value;
         }
-        newFrame->bindings = addBinding(symbol, newBind, newFrame->bindings);
-        assignList = cdr(assignList);
-    }
-    Value *result;
-    Value *cur = (cdr(expr));
-    while (cur->type != NULL_TYPE){
-        result = eval(car(cur), newFrame);
-        cur = cdr(cur);
     }
-    return result;
+    *frame = newFrame;
+    return node->let.body;
 }
 
-Value *evalQuote(Value *expr, Frame *frame) {
-    if (expr->type != CONS_TYPE || car(expr) == NULL || cdr(expr) == NULL
-        || cdr(expr)->type != NULL_TYPE) {
-        handleInterpError(166);
+// stores value in a local or free variable
+void assignVariable(Node *var, Frame *frame, Value *value) {
+    if (var->var.boxed) {
+        rawVariable(var, frame)->box = value;
     }
-    if (car(expr)->type == CONS_TYPE && car(car(expr))->type == NULL_TYPE) {
-        return car(car(expr));
+    else {
+        frameOf(var, frame)->slots[var->var.index] = value;
     }
-    return car(expr);
 }
 
-Value *evalDefine(Value *expr, Frame *frame) {
-    if (length(expr) != 2) {
-        handleInterpError(167);
-    }
-    if (car(expr) == NULL || car(cdr(expr)) == NULL) {
-        handleInterpError(168);
-    }
-    if (car(expr)->type != SYMBOL_TYPE) {
-        handleInterpError(169);
+Value *evalDefine(Node *node, Frame *frame) {
+    Value *result = evalNode(node->assign.expr, frame);
+    Node *var = node->assign.var;
+    if (var->kind == LOCAL_NODE) {
+        assignVariable(var, frame, result);
+        return makeVoid();
     }
-    
-    Value *result = eval(car(cdr(expr)), frame);
-    
-    frame->bindings = addBinding(car(expr), result, frame->bindings);
+    defineGlobal(var, result, frame);
     return makeVoid();
 }
 
-Value *evalSetBang(Value *expr, Frame *frame) {
-    if (length(expr) != 2) {
-        handleInterpError(170);
-    }  
-    if (car(expr) == NULL || car(cdr(expr)) == NULL) {
-        handleInterpError(171);
-    }
-    
-    Value *result = eval(car(cdr(expr)), frame);
-    Value *var = car(expr);
-    
-    Frame *tempFrame = frame;
-    while (tempFrame != NULL) {
-        Value *temp = tempFrame->bindings;
-        while (temp->type == CONS_TYPE) {
-            if (!strcmp(car(car(temp))->s, var->s)) {
-                car(temp)->c.cdr = result;
-                return makeVoid();
-            }
-            temp = cdr(temp);
-        }
-        tempFrame = tempFrame->parent;
+Value *evalSetBang(Node *node, Frame *frame) {
+    Value *result = evalNode(node->assign.expr, frame);
+    Node *var = node->assign.var;
+    if (var->kind != GLOBAL_NODE) {
+        assignVariable(var, frame, result);
+        return makeVoid();
     }
-    handleInterpError(172);
-    return makeVoid();
-}
-
-Value *evalBegin(Value *expr, Frame *frame) {
-    Value *result = makeVoid();
-    Value *temp = expr;
-    for (int i = 0; i < length(expr); i++) {
-        result = eval(car(temp), frame);
-        temp = cdr(temp);
+    if (resolveGlobal(var, frame) == NULL) {
+        handleInterpError(172);
     }
-    return result;
+    var->var.binding->c.cdr = result;
+    return makeVoid();
 }
 
-Value *evalLambda(Value *expr, Frame *frame) {
-    Value *current = car(expr);
-    if (current->type == CONS_TYPE && car(current)->type == NULL_TYPE) {
-        current = cdr(current);
+Node *evalBegin(Node *node, Frame *frame, Value **result) {
+    if (node->seq.count == 0) {
+        *result = makeVoid();
+        return NULL;
     }
-    while (current->type != NULL_TYPE) {
-        if (car(current)->type != SYMBOL_TYPE) {
-            handleInterpError(174);
-        }
-        current = cdr(current);
+    for (int i = 0; i < node->seq.count - 1; i++) {
+        evalNode(node->seq.exprs[i], frame);
     }
-    Value *closure = makeClosure(car(expr), cdr(expr), frame);
-    return closure;
+    return node->seq.exprs[node->seq.count - 1];
 }
 
-Value *evalAnd(Value *args, Frame *frame) {
-    Value *ret;
-    if (!args) {
-        handleInterpError(178);
-    }
+Node *evalAnd(Node *node, Frame *frame, Value **result) {
     // case: 0 args
-    if (length(args) == 0) {
-        ret = makeNull();
-        ret->type = BOOL_TYPE;
-        ret->i = 1;
-        return ret;
+    if (node->seq.count == 0) {
+        *result = makeTrue();
+        return NULL;
     }
-    Value *temp = args;
-    Value *arg;
-    for (int i = 0; i < length(args); i++) {
-        arg = eval(car(temp), frame);
+    for (int i = 0; i < node->seq.count - 1; i++) {
+        Value *arg = evalNode(node->seq.exprs[i], frame);
         if (arg->type == BOOL_TYPE && arg->i == 0) {
-            return arg;
-        }
-        if (i == (length(args) - 1)) {
-            ret = car(temp);
+            *result = arg;
+            return NULL;
         }
-        temp = cdr(temp);
     }
-    return eval(ret, frame);
+    return node->seq.exprs[node->seq.count - 1];
 }
 
-Value *evalOr(Value *args, Frame *frame) {
-    Value *ret;
-    if (!args) {
-        handleInterpError(179);
-    }
+Node *evalOr(Node *node, Frame *frame, Value **result) {
     // case: 0 args
-    if (length(args) == 0) {
-        ret = makeNull();
-        ret->type = BOOL_TYPE;
-        ret->i = 0;
-        return ret;
+    if (node->seq.count == 0) {
+        *result = makeFalse();
+        return NULL;
     }
-    Value *temp = args;
-    Value *arg;
-    for (int i = 0; i < length(args); i++) {
-        arg = eval(car(temp), frame);
-        if (arg->type != BOOL_TYPE) {
-            ret = arg;
-            return arg;
+    for (int i = 0; i < node->seq.count - 1; i++) {
+        Value *arg = evalNode(node->seq.exprs[i], frame);
+        if (arg->type != BOOL_TYPE || arg->i == 1) {
+            *result = arg;
+            return NULL;
         }
-        else if (arg->i == 1) {
-            return arg;
-        }
-        ret = car(temp);
-        temp = cdr(temp);
     }
-    return eval(ret, frame);
+    return node->seq.exprs[node->seq.count - 1];
 }
 
-Value *evalCond(Value *args, Frame *frame) {
-    if (!args) {
-        handleInterpError(180);
-    }
-    if (length(args) == 0) {
-        return makeVoid();
-    }
-    Value *current = args;
-    while (current->type != NULL_TYPE) {
-        if (!car(current) || length(car(current)) == 0){
-            handleInterpError(181);
-        }
-        if (length(car(current)) == 1) {
-            if (car(car(current))->type == SYMBOL_TYPE) {
-                if (!strcmp(car(car(current))->s, "else")) {
-                    handleInterpError(182);
-                }
-            }
-            Value *check = eval(car(car(current)), frame);
-            if (check->type != BOOL_TYPE) {
-                return eval(car(car(current)), frame);
-            }
-            if (check->type == BOOL_TYPE) {
-                if (check->i == 1) {
-                    return eval(car(car(current)), frame);
-                }
-            }
-        }
-        else {
-            if (car(car(current))->type == SYMBOL_TYPE) {
-                if (!strcmp(car(car(current))->s, "else")) {
-                    Value *ret = cdr(car(current));
-                    while (cdr(ret)->type != NULL_TYPE) {
-                        ret = cdr(ret);
-                    }
-                    return eval(car(ret), frame);
-                }
-            }
-            Value *check = eval(car(car(current)), frame);
-            if (check->type != BOOL_TYPE) {
-                Value *ret = cdr(car(current));
-                    while (cdr(ret)->type != NULL_TYPE) {
-                        ret = cdr(ret);
-                    }
-                    return eval(car(ret), frame);
-            }
-            if (check->type == BOOL_TYPE) {
-                if (check->i == 1) {
-                    Value *ret = cdr(car(current));
-                    while (cdr(ret)->type != NULL_TYPE) {
-                        ret = cdr(ret);
-                    }
-                    return eval(car(ret), frame);
-                }
+Node *evalCond(Node *node, Frame *frame, Value **result) {
+    for (int i = 0; i < node->cond.count; i++) {
+        if (node->cond.tests[i] == NULL) {
+            return node->cond.bodies[i];
+        }
+        Value *check = evalNode(node->cond.tests[i], frame);
+        if (check->type != BOOL_TYPE || check->i == 1) {
+            if (node->cond.bodies[i] == NULL) {
+                *result = check;
+                return NULL;
             }
+            return node->cond.bodies[i];
         }
-        current = cdr(current);
     }
-    return makeVoid();
+    *result = makeVoid();
+    return NULL;
 }
 
-Value *evalEach(Value *expr, Frame *frame) {
-    if (expr->type == NULL_TYPE) {
-        return expr;
+// rewrites a generic call node that just called a two-argument arithmetic or
+// comparison primitive on numbers into the specialization for those numbers;
+// once it has been deoptimized, it only gets the one for any numbers
+void specializeCall(Node *node, Value *function, Value **argv) {
+    Value *(*pf)(int, Value **) = function->pf;
+    arithOp op;
+    if (pf == primitiveAdd) {
+        op = ADD_OP;
     }
-    if (expr->type != CONS_TYPE) {
-        handleInterpError(175);
+    else if (pf == primitiveSub) {
+        op = SUB_OP;
     }
-    Value *args = makeNull();
-    Value *cur = expr;
-    while (cur->type != NULL_TYPE) {
-        args = cons(eval(car(cur), frame), args);
-        cur = cdr(cur);
+    else if (pf == primitiveMult) {
+        op = MULT_OP;
     }
-    
-    return reverse(args);
-}
-
-Value* evalPrim(Value *symbol, Value *args, Frame *frame) {
-    if (!symbol || symbol->type != SYMBOL_TYPE) {
-        handleInterpError(176);
+    else if (pf == primitiveLess) {
+        op = LESS_OP;
     }
-    Frame *tempFrame = frame;
-    while (tempFrame->parent != NULL) {
-        tempFrame = tempFrame->parent;
+    else if (pf == primitiveGreater) {
+        op = GREATER_OP;
     }
-    Value *bindings = tempFrame->bindings;
-    while (bindings->type != NULL_TYPE) {
-        if (!strcmp(car(car(bindings))->s, symbol->s)) {
-            return (cdr(car(bindings))->pf)(evalEach(args, frame));
-        }
-        bindings = cdr(bindings);
+    else if (pf == primitiveLessEq) {
+        op = LESS_EQ_OP;
+    }
+    else if (pf == primitiveGrEq) {
+        op = GR_EQ_OP;
+    }
+    else if (pf == primitiveEqual) {
+        op = EQUAL_OP;
+    }
+    else {
+        return;
+    }
+    valueType a = argv[0]->type;
+    valueType b = argv[1]->type;
+    if ((a != INT_TYPE && a != DOUBLE_TYPE) ||
+        (b != INT_TYPE && b != DOUBLE_TYPE)) {
+        return;
+    }
+    if (node->call.deopts == 0 && a == INT_TYPE && b == INT_TYPE) {
+        node->kind = FIXNUM_CALL_NODE;
     }
-    handleInterpError(177);
-    return NULL;   
+    else if (node->call.deopts == 0 && a == DOUBLE_TYPE &&
+             b == DOUBLE_TYPE) {
+        node->kind = FLONUM_CALL_NODE;
+    }
+    else {
+        node->kind = NUMERIC_CALL_NODE;
+    }
+    node->call.primitive = function;
+    node->call.op = op;
 }
 
-Value *apply(Value *function, Value *args) {
-    if (!(function) || function->type != CLOSURE_TYPE) {
-        handleInterpError(4);
+// the booleans and small fixnums the specialized operations return, which
+// are shared rather than made anew, since a value never changes once made
+Value sharedTrue = {.type = BOOL_TYPE, .i = 1};
+Value sharedFalse = {.type = BOOL_TYPE, .i = 0};
+Value sharedInts[SHARED_INT_MAX - SHARED_INT_MIN + 1];
+
+Value *boolResult(int boolean) {
+    return boolean ? &sharedTrue : &sharedFalse;
+}
+
+Value *intResult(long n) {
+    if (n < SHARED_INT_MIN || n > SHARED_INT_MAX) {
+        return makeInt(n);
     }
-    Frame *newFrame = makeNewFrame(function->cl.frame);
-    Value *curr = function->cl.paramNames;
-    if (car(curr)->type != NULL_TYPE) {
-        Value *curr2 = args;
-        while (curr->type != NULL_TYPE && curr2->type != NULL_TYPE) {
-            newFrame->bindings = addBinding(car(curr), car(curr2), newFrame->bindings);
-            curr = cdr(curr); 
-            curr2 = cdr(curr2);
+    // INT_TYPE is 0, so only the number needs filling in
+    Value *value = &sharedInts[n - SHARED_INT_MIN];
+    value->i = n;
+    return value;
+}
+
+// computes what the primitives compute on two fixnums; a sum, difference or
+// product that overflows is a bignum
+Value *fixnumOp(arithOp op, long a, long b) {
+    long result;
+    switch (op) {
+     case ADD_OP: {
+        if (__builtin_add_overflow(a, b, &result)) {
+            return integerAdd(makeInt(a), makeInt(b));
+        }
+        return intResult(result);
+     }
+     case SUB_OP: {
+        if (__builtin_sub_overflow(a, b, &result)) {
+            return integerSub(makeInt(a), makeInt(b));
         }
-        if (length(curr) != length(curr2)) {
-            handleInterpError(5);
+        return intResult(result);
+     }
+     case MULT_OP: {
+        if (__builtin_mul_overflow(a, b, &result)) {
+            return integerMul(makeInt(a), makeInt(b));
         }
+        return intResult(result);
+     }
+     case LESS_OP: {
+        return boolResult(a < b);
+     }
+     case GREATER_OP: {
+        return boolResult(a > b);
+     }
+     case LESS_EQ_OP: {
+        return boolResult(a <= b);
+     }
+     case GR_EQ_OP: {
+        return boolResult(a >= b);
+     }
+     default: {
+        return boolResult(a == b);
+     }
     }
-    else if (length(args) != 0) {
-        handleInterpError(6);
-    }
-    
-    // this assumes that the functionCode will be a list of bodies
-    Value *evaled = function->cl.functionCode;
-    Value *bodies = function->cl.functionCode;
-    for (int i = 0; i < length(function->cl.functionCode); i++) {
-        evaled = eval(car(bodies), newFrame);
-        bodies = cdr(bodies);
-    }
-    return evaled;
 }
 
-Value *eval(Value *expr, Frame *frame) {
-    Value *result;
-    switch (expr->type) {
-     case INT_TYPE: {
-        return expr;
-        break;
+// computes what the primitives compute when an operand is a double, in the
+// same order, so that results agree to the last bit: sums start from 0.0 and
+// products from 1.0, and comparisons test the negated operator, which
+// matters for NaN
+Value *flonumOp(arithOp op, double a, double b) {
+    switch (op) {
+     case ADD_OP: {
+        return makeDouble((0.0 + a) + b);
      }
-     case DOUBLE_TYPE: {
-        return expr;
-        break;
+     case SUB_OP: {
+        return makeDouble(a - b);
      }
-     case BOOL_TYPE: {
-        return expr;
-        break;
+     case MULT_OP: {
+        return makeDouble((1.0 * a) * b);
      }
-     case STR_TYPE: {
-        return expr;
-        break;
-     } 
-     case SYMBOL_TYPE: {
-        return lookUpSymbol(expr, frame);
-        break;
+     case LESS_OP: {
+        return boolResult(!(a >= b));
      }
-     case CONS_TYPE: {
-        Value *first = car(expr);
-        Value *args = cdr(expr);
+     case GREATER_OP: {
+        return boolResult(!(a <= b));
+     }
+     case LESS_EQ_OP: {
+        return boolResult(!(a > b));
+     }
+     case GR_EQ_OP: {
+        return boolResult(!(a < b));
+     }
+     default: {
+        return boolResult(!(a != b));
+     }
+    }
+}
 
-        if (first->type == NULL_TYPE) {
-            result = expr;
+// returns what a specialized call node computes on a and b, or NULL if they
+// are not the numbers the node was specialized to
+Value *specializedOp(Node *node, Value *a, Value *b) {
+    if (node->kind == FIXNUM_CALL_NODE) {
+        if (a->type == INT_TYPE && b->type == INT_TYPE) {
+            return fixnumOp(node->call.op, a->i, b->i);
         }
-         
-        else if (first->type != SYMBOL_TYPE && first->type != CONS_TYPE) {
-            handleInterpError(182);
-        }
-        
-        // Sanity and error checking on first...
-        else if (!strcmp(first->s, "if")) {
-            result = evalIf(args, frame);
-        }
-        
-        else if (!strcmp(first->s, "let")) {
-            result = evalLet(args, frame, 0);
-            //result = evalLet(args, frame, 0);
-        }
-        else if (!strcmp(first->s, "let*")) {
-            result = evalLet(args, frame, 1);
-            //result = evalLet(args, frame, 1);
-        }
-        else if (!strcmp(first->s, "letrec")) {
-            result = evalLetrec(args, frame);
-        }
-        
-        else if (!strcmp(first->s, "quote")) {
-            result = evalQuote(args, frame);
-        }
-        
-        else if (!strcmp(first->s, "define")) {
-            result = evalDefine(args, frame);
-        }
-        
-        else if (!strcmp(first->s, "lambda")) {
-            result = evalLambda(args, frame);
-        }
-         
-        else if (!strcmp(first->s, "and")) {
-            result = evalAnd(args, frame);
-        }
-        
-        else if (!strcmp(first->s, "or")) {
-            result = evalOr(args, frame);
-        }
-        else if (!strcmp(first->s, "cond")) {
-            result = evalCond(args, frame);
-        }
-         
-        else if (!strcmp(first->s, "set!")) {
-            result = evalSetBang(args, frame);
-        }
-         
-        else if (!strcmp(first->s, "begin")) {
-            result = evalBegin(args, frame);
-        }
-         
-        // symbol is a primitive
-        else if (first->type == SYMBOL_TYPE) {
-            int check = isPrimitive(first, frame);
-            if (check == 1) {
-                result = evalPrim(first, args, frame);
-            }
-            else {
-                // not a recognized special form or primitive
-                Value *evaledOperator = eval(first, frame);
-                Value *evaledArgs = evalEach(args, frame);
-                return apply(evaledOperator, evaledArgs);
-            }
+    }
+    else if (node->kind == FLONUM_CALL_NODE) {
+        if (a->type == DOUBLE_TYPE && b->type == DOUBLE_TYPE) {
+            return flonumOp(node->call.op, a->d, b->d);
         }
+    }
+    else if (a->type == INT_TYPE && b->type == INT_TYPE) {
+        return fixnumOp(node->call.op, a->i, b->i);
+    }
+    else if ((a->type == INT_TYPE || a->type == DOUBLE_TYPE) &&
+             (b->type == INT_TYPE || b->type == DOUBLE_TYPE)) {
+        return flonumOp(node->call.op,
+                        a->type == INT_TYPE ? a->i : a->d,
+                        b->type == INT_TYPE ? b->i : b->d);
+    }
+    return NULL;
+}
 
-        else {
-            // not a recognized special form or primitive
-            Value *evaledOperator = eval(first, frame);
-            Value *evaledArgs = evalEach(args, frame);
-            return apply(evaledOperator, evaledArgs);
+// turns a specialized call node back into a generic one
+void deoptimizeCall(Node *node) {
+    node->kind = CALL_NODE;
+    node->call.deopts++;
+}
+
+// notes that a generic call node just called function on the argc arguments
+// in argv, which specializes it if that was a primitive it can be
+// specialized to
+void profileCall(Node *node, Value *function, int argc, Value **argv) {
+    if (function->type == PRIMITIVE_TYPE && argc == 2 &&
+        node->call.deopts < MAX_DEOPTS) {
+        specializeCall(node, function, argv);
+    }
+}
+
+// evaluates a specialized call without going through the primitive; if the
+// procedure or an operand is not what the node was specialized to, the node
+// goes back to being a generic call
+Value *evalSpecializedCall(Node *node, Frame *frame) {
+    Value *function = evalNode(node->call.fn, frame);
+    Value *a = evalNode(node->call.args[0], frame);
+    Value *b = evalNode(node->call.args[1], frame);
+    if (function == node->call.primitive) {
+        Value *result = specializedOp(node, a, b);
+        if (result != NULL) {
+            return result;
+        }
+    }
+    deoptimizeCall(node);
+    Value *argv[2] = {a, b};
+    return apply(function, 2, argv);
+}
+
+// pushes a frame for a call of a closure of the tree walker on argc
+// arguments, with room for the arguments and the closure's whole frame
+Frame *pushCallFrame(Value *function, int argc) {
+    int size = function->cl.lambda->lambda.frameSize;
+    return pushFrame(function->cl.frame, size < argc ? argc : size);
+}
+
+// readies frame, pushed by pushCallFrame and holding the argc arguments, to
+// run the body of the closure in
+void enterClosure(Value *function, int argc, Frame *frame) {
+    Node *lambda = function->cl.lambda;
+    if (argc != lambda->lambda.paramCount) {
+        handleInterpError(lambda->lambda.paramCount ? 5 : 6);
+    }
+    for (int i = argc; i < lambda->lambda.frameSize; i++) {
+        frame->slots[i] = NULL;
+    }
+    boxSlots(lambda->lambda.boxed, frame->slots, lambda->lambda.frameSize);
+    frame->freeVars = function->cl.freeVars;
+}
+
+// a call that a procedure compiled by schemec made in tail position, and
+// returned &pendingCall in place of its value
+Value pendingCall;
+Value *pendingFunction;
+int pendingArgc;
+Value **pendingArgv = NULL;
+int pendingCapacity = 0;
+
+// Makes a call in tail position of a procedure compiled by schemec, which
+// must return what this returns. A call of another compiled procedure is
+// only recorded, and apply makes it once the caller has returned, so that
+// compiled loops take no C stack.
+Value *tailCall(Value *function, int argc, Value **argv) {
+    if (function->type != CLOSURE_TYPE || function->cl.compiled == NULL) {
+        return apply(function, argc, argv);
+    }
+    if (argc > pendingCapacity) {
+        pendingCapacity = 2 * argc;
+        pendingArgv = talloc(pendingCapacity * sizeof(Value *));
+    }
+    // the callee copies its arguments before making a call of its own
+    memcpy(pendingArgv, argv, argc * sizeof(Value *));
+    pendingFunction = function;
+    pendingArgc = argc;
+    return &pendingCall;
+}
+
+// calls a procedure on the argc arguments in argv
+Value *apply(Value *function, int argc, Value **argv) {
+    if (function->type == PRIMITIVE_TYPE) {
+        return (function->pf)(argc, argv);
+    }
+    if (function->type == CONTINUATION_TYPE) {
+        return applyEscape(function, argc, argv);
+    }
+    if (function->type != CLOSURE_TYPE) {
+        handleInterpError(4);
+    }
+    if (function->cl.compiled != NULL) {
+        Value *result = function->cl.compiled(function, argc, argv);
+        while (result == &pendingCall) {
+            result = pendingFunction->cl.compiled(pendingFunction,
+                                                  pendingArgc, pendingArgv);
         }
-        break;
-     }
-     default: {
-        // otherwise throw an error
-        handleInterpError(183);
-     }    
+        return result;
+    }
+    if (function->cl.code != NULL) {
+        return vmApply(function, argc, argv);
+    }
+    Value *result = jitCall(function->cl.lambda, argc, argv);
+    if (result != NULL) {
+        return result;
     }
+    size_t mark = frameTop;
+    Frame *frame = pushCallFrame(function, argc);
+    memcpy(frame->slots, argv, argc * sizeof(Value *));
+    enterClosure(function, argc, frame);
+    result = evalNode(function->cl.lambda->lambda.body, frame);
+    frameTop = mark;
     return result;
-}
\ No newline at end of file
+}
+
+// evaluates a call in tail position of the evalNode that began at offset
+// mark of the frame region. The arguments for a closure of the tree walker
+// go straight into the slots of its frame, which then replaces every frame
+// that evalNode pushed, and the closure's body is returned to evaluate in
+// *frame; any other procedure is applied, storing its value in *result.
+Node *evalCall(Node *node, Frame **frame, Value **result, size_t mark) {
+    Value *function = evalNode(node->call.fn, *frame);
+    int argc = node->call.argc;
+    int walked = function->type == CLOSURE_TYPE &&
+                 function->cl.code == NULL && function->cl.compiled == NULL;
+    Frame *newFrame = NULL;
+    Value **argv;
+    if (walked) {
+        newFrame = pushCallFrame(function, argc);
+        argv = newFrame->slots;
+    }
+    else {
+        argv = pushRegion(argc * sizeof(Value *));
+    }
+    for (int i = 0; i < argc; i++) {
+        argv[i] = evalNode(node->call.args[i], *frame);
+    }
+    if (function->type == PRIMITIVE_TYPE) {
+        profileCall(node, function, argc, argv);
+        *result = (function->pf)(argc, argv);
+        return NULL;
+    }
+    if (!walked) {
+        *result = apply(function, argc, argv);
+        return NULL;
+    }
+    *result = jitCall(function->cl.lambda, argc, argv);
+    if (*result != NULL) {
+        return NULL;
+    }
+    *frame = replaceFrames(newFrame, mark);
+    enterClosure(function, argc, *frame);
+    return function->cl.lambda->lambda.body;
+}
+
+// evaluates an analyzed expression in frame; expressions in tail position
+// are evaluated by going round the loop again rather than by recursing
+Value *evalNode(Node *node, Frame *frame) {
+    size_t mark = frameTop;
+    Value *result = NULL;
+    evalDepth++;
+    if (evalDepth > maxDepth ||
+        (evalStackLimit != NULL && (char *)&mark < evalStackLimit)) {
+        handleInterpError(184);
+    }
+    while (node != NULL) {
+        switch (node->kind) {
+         case CONST_NODE: {
+            result = node->value;
+            node = NULL;
+            break;
+         }
+         case LOCAL_NODE:
+         case FREE_NODE:
+         case GLOBAL_NODE: {
+            result = evalVariable(node, frame);
+            node = NULL;
+            break;
+         }
+         case DEFINE_NODE: {
+            result = evalDefine(node, frame);
+            node = NULL;
+            break;
+         }
+         case SET_NODE: {
+            result = evalSetBang(node, frame);
+            node = NULL;
+            break;
+         }
+         case IF_NODE: {
+            node = evalIf(node, frame);
+            break;
+         }
+         case LAMBDA_NODE: {
+            result = makeClosure(node, frame);
+            node = NULL;
+            break;
+         }
+         case LET_NODE:
+         case LETSTAR_NODE:
+         case LETREC_NODE: {
+            node = evalLet(node, &frame);
+            break;
+         }
+         case BEGIN_NODE: {
+            node = evalBegin(node, frame, &result);
+            break;
+         }
+         case AND_NODE: {
+            node = evalAnd(node, frame, &result);
+            break;
+         }
+         case OR_NODE: {
+            node = evalOr(node, frame, &result);
+            break;
+         }
+         case COND_NODE: {
+            node = evalCond(node, frame, &result);
+            break;
+         }
+         case CALL_NODE: {
+            node = evalCall(node, &frame, &result, mark);
+            break;
+         }
+         case FIXNUM_CALL_NODE:
+         case FLONUM_CALL_NODE:
+         case NUMERIC_CALL_NODE: {
+            result = evalSpecializedCall(node, frame);
+            node = NULL;
+            break;
+         }
+         default: {
+            handleInterpError(node->error);
+         }
+        }
+    }
+    frameTop = mark;
+    evalDepth--;
+    return result;
+}
+
+// evaluates a top-level expression: it is analyzed once, then the resulting
+// node is run
+Value *eval(Value *expr, Frame *frame) {
+    return evalNode(analyze(expr), frame);
+}
@@ -1,4 +1,5 @@
 #include "value.h"
+#include "analyzer.h"
 
 #ifndef _INTERPRETER
 #define _INTERPRETER
@@ -7,14 +8,75 @@
 // binding is a variable name (represented as a string), and a pointer to the
 // Value it is bound to. Specifically how you implement the list of bindings is
 // up to you.
+// Only the global frame keeps a list of (symbol . value) bindings. Local
+// variables are resolved by analyze() to a slot index, so the frames of
+// procedures and lets hold them by position in slots. Closures copy the
+// values of the variables they use into their own freeVars, which the frames
+// of their calls point to, so frames never outlive their calls and are kept
+// in a region in stack order. A call in tail position replaces the frames of
+// the procedure making it.
 struct Frame {
     Value *bindings;
+    Value **slots;
+    int size;
+    Value **freeVars;
     struct Frame *parent;
 };
 
 typedef struct Frame Frame;
 
-void interpret(Value *tree);
+int interpret(Value *tree, int bytecode);
+void setMaxDepth(int depth);
+Frame *makeGlobalFrame();
+void printVal(Value *val);
 Value *eval(Value *expr, Frame *frame);
+Value *evalNode(Node *node, Frame *frame);
+Value *apply(Value *function, int argc, Value **argv);
+Value *tailCall(Value *function, int argc, Value **argv);
+void runDeep(void (*body)());
+Value *runTopLevel(Value *(*form)(void *), void *data);
+extern int uncaughtErrors;
+void checkStack();
+
+// shared with the bytecode VM
+extern int maxDepth;
+void handleInterpError(int i);
+void handleUnbound(Value *symbol);
+Value *raiseCondition(Value *condition, int continuable);
+Value *resolveGlobal(Node *var, Frame *frame);
+void defineGlobal(Node *var, Value *value, Frame *frame);
+Value *makeVoid();
+Value *makeDouble(double d);
+Value *makeBox(Value *value);
+Value *makeTrue();
+Value *makeFalse();
+
+// the type feedback of two-argument calls, which both the tree walker and
+// the VM specialize to the arithmetic primitives they turn out to call
+Value *specializedOp(Node *node, Value *a, Value *b);
+void deoptimizeCall(Node *node);
+void profileCall(Node *node, Value *function, int argc, Value **argv);
+
+// the results of specialized operations, shared for booleans and small
+// fixnums
+Value *intResult(long n);
+Value *boolResult(int boolean);
+
+// primitives the JIT compiles inline and the optimizer folds
+Value *primitiveAdd(int argc, Value **argv);
+Value *primitiveSub(int argc, Value **argv);
+Value *primitiveMult(int argc, Value **argv);
+Value *primitiveDiv(int argc, Value **argv);
+Value *primitiveMod(int argc, Value **argv);
+Value *primitiveQuotient(int argc, Value **argv);
+Value *primitiveRemainder(int argc, Value **argv);
+Value *primitiveAbs(int argc, Value **argv);
+Value *primitiveMin(int argc, Value **argv);
+Value *primitiveMax(int argc, Value **argv);
+Value *primitiveLess(int argc, Value **argv);
+Value *primitiveGreater(int argc, Value **argv);
+Value *primitiveLessEq(int argc, Value **argv);
+Value *primitiveGrEq(int argc, Value **argv);
+Value *primitiveEqual(int argc, Value **argv);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,676 @@
+// A template JIT for x86-64 Linux. Once a lambda has been called
+// JIT_THRESHOLD times, its body is translated to machine code, provided it
+// only uses what the translation handles: parameters, constants, if, calls
+// of the arithmetic and comparison primitives, and calls of the procedure
+// itself. Arithmetic is first compiled for fixnums, on unboxed integers that
+// bail out when they overflow; a lambda whose code keeps bailing out is
+// recompiled for flonums, on unboxed doubles, computed exactly as the
+// primitives compute them. The code checks that the globals it calls still
+// hold the primitive or procedure they held when it was compiled, and
+// returns NULL if a check fails; the interpreter then runs the whole call
+// again, which is safe since such code has no side effects.
+
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include "jit.h"
+#include "interpreter.h"
+#include "linkedlist.h"
+#include "talloc.h"
+
+#if defined(__linux__) && defined(__x86_64__)
+#include <sys/mman.h>
+#define JIT_SUPPORTED 1
+#else
+#define JIT_SUPPORTED 0
+#endif
+
+// what a call in a compiled body calls
+typedef enum {NOT_INLINE,SELF,ADD,SUB,MULT,LESS,GREATER,LESS_EQ,GR_EQ,
+              EQUAL} callKind;
+
+// x86-64 condition codes, as used in the second byte of a near jcc; BELOW
+// and ABOVE compare unsigned integers or doubles, LT to GT signed integers
+typedef enum {ALWAYS=0,OVERFLOW=0x80,BELOW=0x82,ABOVE_EQ=0x83,EQ=0x84,
+              NOT_EQ=0x85,ABOVE=0x87,PARITY=0x8a,LT=0x8c,GE=0x8d,LE=0x8e,
+              GT=0x8f} condition;
+
+typedef Value *(*nativeCode)(Value **argv);
+
+// Machine code of one lambda under construction.
+typedef struct Assembler {
+    unsigned char *bytes;
+    int length;
+    int capacity;
+    int *bailouts;
+    int bailoutCount;
+    int bailoutCapacity;
+    int depth;
+    Node *lambda;
+    // set when numbers are compiled as flonums rather than fixnums
+    int flonum;
+} Assembler;
+
+int jitEnabled = JIT_SUPPORTED;
+
+// native code bails out rather than recurse below this address
+char *stackLimit = NULL;
+
+// the end of the C stack, when it is not the usual one
+char *stackEnd = NULL;
+
+Value *trueValue = NULL;
+Value *falseValue = NULL;
+
+// Turns the JIT off for the rest of the run.
+void disableJit() {
+    jitEnabled = 0;
+}
+
+void setJitStackEnd(char *end) {
+    stackEnd = end;
+    stackLimit = NULL;
+}
+
+void emitBytes(Assembler *a, const char *bytes, int count) {
+    while (a->length + count > a->capacity) {
+        int capacity = a->capacity ? 2 * a->capacity : 256;
+        unsigned char *larger = talloc(capacity);
+        if (a->length > 0) {
+            memcpy(larger, a->bytes, a->length);
+        }
+        a->bytes = larger;
+        a->capacity = capacity;
+    }
+    memcpy(a->bytes + a->length, bytes, count);
+    a->length += count;
+}
+
+void emitInt32(Assembler *a, int n) {
+    emitBytes(a, (char *)&n, 4);
+}
+
+// emits mov rax, imm64 (or mov rcx with rcx set) loading pointer
+void emitLoad(Assembler *a, void *pointer, int rcx) {
+    emitBytes(a, rcx ? "\x48\xb9" : "\x48\xb8", 2);
+    emitBytes(a, (char *)&pointer, 8);
+}
+
+// emits a jump, conditional unless cond is ALWAYS, and returns the position
+// of its displacement
+int emitJcc(Assembler *a, condition cond) {
+    if (cond == ALWAYS) {
+        emitBytes(a, "\xe9", 1);
+    }
+    else {
+        char bytes[2] = {0x0f, (char)cond};
+        emitBytes(a, bytes, 2);
+    }
+    emitInt32(a, 0);
+    return a->length - 4;
+}
+
+// points the jump whose displacement is at position at the current end
+void patchJcc(Assembler *a, int position) {
+    int displacement = a->length - (position + 4);
+    memcpy(a->bytes + position, &displacement, 4);
+}
+
+// emits a jump to the bailout code, which returns NULL
+void emitBailout(Assembler *a, condition cond) {
+    if (a->bailoutCount == a->bailoutCapacity) {
+        int capacity = a->bailoutCapacity ? 2 * a->bailoutCapacity : 16;
+        int *larger = talloc(capacity * sizeof(int));
+        if (a->bailoutCount > 0) {
+            memcpy(larger, a->bailouts, a->bailoutCount * sizeof(int));
+        }
+        a->bailouts = larger;
+        a->bailoutCapacity = capacity;
+    }
+    a->bailouts[a->bailoutCount] = emitJcc(a, cond);
+    a->bailoutCount++;
+}
+
+// emits code pushing rax, or popping into it after moving rax to rcx
+void pushInt(Assembler *a) {
+    emitBytes(a, "\x50", 1);
+    a->depth++;
+}
+
+void popInt(Assembler *a) {
+    emitBytes(a, "\x48\x89\xc1\x58", 4);
+    a->depth--;
+}
+
+// emits code pushing xmm0, or popping into it after moving xmm0 to xmm1
+void pushDouble(Assembler *a) {
+    emitBytes(a, "\x48\x83\xec\x08\xf2\x0f\x11\x04\x24", 9);
+    a->depth++;
+}
+
+void popDouble(Assembler *a) {
+    emitBytes(a, "\xf2\x0f\x10\xc8\xf2\x0f\x10\x04\x24\x48\x83\xc4\x08", 13);
+    a->depth--;
+}
+
+// emits a call of a C function, keeping the stack 16-byte aligned
+void emitCCall(Assembler *a, void *function) {
+    int pad = a->depth % 2;
+    if (pad) {
+        emitBytes(a, "\x48\x83\xec\x08", 4);
+    }
+    emitLoad(a, function, 0);
+    emitBytes(a, "\xff\xd0", 2);
+    if (pad) {
+        emitBytes(a, "\x48\x83\xc4\x08", 4);
+    }
+}
+
+// returns what a call whose procedure is fn calls, judging by the global it
+// is bound to now
+callKind classify(Node *fn, Node *lambda) {
+    if (fn->kind != GLOBAL_NODE || fn->var.binding == NULL) {
+        return NOT_INLINE;
+    }
+    Value *value = fn->var.binding->c.cdr;
+    if (value->type == CLOSURE_TYPE && value->cl.lambda == lambda) {
+        return SELF;
+    }
+    if (value->type != PRIMITIVE_TYPE) {
+        return NOT_INLINE;
+    }
+    Value *(*pf)(int, Value **) = value->pf;
+    if (pf == primitiveAdd) {
+        return ADD;
+    }
+    if (pf == primitiveSub) {
+        return SUB;
+    }
+    if (pf == primitiveMult) {
+        return MULT;
+    }
+    if (pf == primitiveLess) {
+        return LESS;
+    }
+    if (pf == primitiveGreater) {
+        return GREATER;
+    }
+    if (pf == primitiveLessEq) {
+        return LESS_EQ;
+    }
+    if (pf == primitiveGrEq) {
+        return GR_EQ;
+    }
+    if (pf == primitiveEqual) {
+        return EQUAL;
+    }
+    return NOT_INLINE;
+}
+
+int isComparison(callKind kind) {
+    return kind >= LESS;
+}
+
+int isConstant(Node *node, valueType type) {
+    return node->kind == CONST_NODE && node->value->type == type;
+}
+
+// returns whether the operands of an arithmetic or comparison call suit
+// code for fixnums, or with flonum set, flonums: a double constant would
+// always fail the checks of fixnum code, and arithmetic on integer constants
+// alone has an integer value, which flonum code cannot compute; neither
+// handles bignum constants
+int suitsNumbers(Node *node, callKind kind, int flonum) {
+    int constant = 1;
+    for (int i = 0; i < node->call.argc; i++) {
+        if (!flonum && isConstant(node->call.args[i], DOUBLE_TYPE)) {
+            return 0;
+        }
+        if (isConstant(node->call.args[i], BIGNUM_TYPE)) {
+            return 0;
+        }
+        if (!isConstant(node->call.args[i], INT_TYPE)) {
+            constant = 0;
+        }
+    }
+    return !flonum || isComparison(kind) || !constant;
+}
+
+// returns whether node can be compiled as part of the body of lambda, with
+// numbers as fixnums, or with flonum set, flonums
+int supported(Node *node, Node *lambda, int flonum) {
+    switch (node->kind) {
+     case CONST_NODE: {
+        return 1;
+     }
+     case LOCAL_NODE: {
+        return node->var.depth == 0 && !node->var.boxed &&
+               node->var.index < lambda->lambda.paramCount;
+     }
+     case IF_NODE: {
+        return supported(node->branch.test, lambda, flonum) &&
+               supported(node->branch.conseq, lambda, flonum) &&
+               supported(node->branch.alt, lambda, flonum);
+     }
+     case CALL_NODE:
+     case FIXNUM_CALL_NODE:
+     case FLONUM_CALL_NODE:
+     case NUMERIC_CALL_NODE: {
+        callKind kind = classify(node->call.fn, lambda);
+        if (kind == NOT_INLINE ||
+            (kind == SELF && node->call.argc != lambda->lambda.paramCount) ||
+            (isComparison(kind) && node->call.argc != 2) ||
+            (kind != SELF && !suitsNumbers(node, kind, flonum))) {
+            return 0;
+        }
+        for (int i = 0; i < node->call.argc; i++) {
+            if (!supported(node->call.args[i], lambda, flonum)) {
+                return 0;
+            }
+        }
+        return 1;
+     }
+     default: {
+        return 0;
+     }
+    }
+}
+
+// emits a check that the global called by a call node still holds what
+// classify() found in it
+void emitGuard(Assembler *a, Node *fn, callKind kind) {
+    emitLoad(a, fn->var.binding, 0);
+    // mov rax, [rax + cdr]
+    char load[4] = {0x48, 0x8b, 0x40, offsetof(Value, c.cdr)};
+    emitBytes(a, load, 4);
+    if (kind == SELF) {
+        // cmp dword [rax], CLOSURE_TYPE; mov rax, [rax + lambda]
+        char check[3] = {0x83, 0x38, CLOSURE_TYPE};
+        emitBytes(a, check, 3);
+        emitBailout(a, NOT_EQ);
+        char lambda[4] = {0x48, 0x8b, 0x40, offsetof(Value, cl.lambda)};
+        emitBytes(a, lambda, 4);
+        emitLoad(a, a->lambda, 1);
+    }
+    else {
+        emitLoad(a, fn->var.binding->c.cdr, 1);
+    }
+    // cmp rax, rcx
+    emitBytes(a, "\x48\x39\xc8", 3);
+    emitBailout(a, NOT_EQ);
+}
+
+void compileValue(Assembler *a, Node *node);
+
+// emits code unboxing the fixnum in rax into rax, bailing out if it is not
+// one
+void emitUnboxInt(Assembler *a) {
+    // cmp dword [rax], INT_TYPE; mov rax, [rax + i]
+    char check[3] = {0x83, 0x38, INT_TYPE};
+    emitBytes(a, check, 3);
+    emitBailout(a, NOT_EQ);
+    char load[4] = {0x48, 0x8b, 0x40, offsetof(Value, i)};
+    emitBytes(a, load, 4);
+}
+
+// emits code unboxing the flonum in rax into xmm0, bailing out if it is not
+// one; a fixnum would make the result exact, which flonum code cannot give
+void emitUnbox(Assembler *a) {
+    // cmp dword [rax], DOUBLE_TYPE; movsd xmm0, [rax + d]
+    char check[3] = {0x83, 0x38, DOUBLE_TYPE};
+    emitBytes(a, check, 3);
+    emitBailout(a, NOT_EQ);
+    char load[5] = {0xf2, 0x0f, 0x10, 0x40, offsetof(Value, d)};
+    emitBytes(a, load, 5);
+}
+
+// compiles node so that it leaves its value as a fixnum in rax
+void compileInt(Assembler *a, Node *node) {
+    if (isConstant(node, INT_TYPE)) {
+        // mov rax, imm64
+        emitBytes(a, "\x48\xb8", 2);
+        emitBytes(a, (char *)&node->value->i, 8);
+        return;
+    }
+    callKind kind = NOT_INLINE;
+    if (isCall(node)) {
+        kind = classify(node->call.fn, a->lambda);
+    }
+    if (kind != ADD && kind != SUB && kind != MULT) {
+        compileValue(a, node);
+        emitUnboxInt(a);
+        return;
+    }
+
+    emitGuard(a, node->call.fn, kind);
+    int first = 0;
+    if (kind == SUB && node->call.argc > 1) {
+        compileInt(a, node->call.args[0]);
+        first = 1;
+    }
+    else {
+        // mov eax, 0 or 1
+        emitBytes(a, "\xb8", 1);
+        emitInt32(a, kind == MULT);
+    }
+    for (int i = first; i < node->call.argc; i++) {
+        pushInt(a);
+        compileInt(a, node->call.args[i]);
+        popInt(a);
+        // add, sub or imul rax, rcx; jo bailout
+        if (kind == ADD) {
+            emitBytes(a, "\x48\x01\xc8", 3);
+        }
+        else if (kind == SUB) {
+            emitBytes(a, "\x48\x29\xc8", 3);
+        }
+        else {
+            emitBytes(a, "\x48\x0f\xaf\xc1", 4);
+        }
+        emitBailout(a, OVERFLOW);
+    }
+}
+
+void emitDouble(Assembler *a, double d) {
+    // mov rax, imm64; movq xmm0, rax
+    emitBytes(a, "\x48\xb8", 2);
+    emitBytes(a, (char *)&d, 8);
+    emitBytes(a, "\x66\x48\x0f\x6e\xc0", 5);
+}
+
+// compiles node so that it leaves its value as a double in xmm0
+void compileDouble(Assembler *a, Node *node) {
+    if (node->kind == CONST_NODE && node->value->type == INT_TYPE) {
+        emitDouble(a, node->value->i);
+        return;
+    }
+    if (node->kind == CONST_NODE && node->value->type == DOUBLE_TYPE) {
+        emitDouble(a, node->value->d);
+        return;
+    }
+    callKind kind = NOT_INLINE;
+    if (isCall(node)) {
+        kind = classify(node->call.fn, a->lambda);
+    }
+    if (kind != ADD && kind != SUB && kind != MULT) {
+        compileValue(a, node);
+        emitUnbox(a);
+        return;
+    }
+
+    emitGuard(a, node->call.fn, kind);
+    int first = 0;
+    if (kind == SUB && node->call.argc > 1) {
+        compileDouble(a, node->call.args[0]);
+        first = 1;
+    }
+    else {
+        emitDouble(a, kind == MULT ? 1.0 : 0.0);
+    }
+    for (int i = first; i < node->call.argc; i++) {
+        pushDouble(a);
+        compileDouble(a, node->call.args[i]);
+        popDouble(a);
+        // addsd, subsd or mulsd xmm0, xmm1
+        char op[4] = {0xf2, 0x0f, 0x58, 0xc1};
+        if (kind == SUB) {
+            op[2] = 0x5c;
+        }
+        else if (kind == MULT) {
+            op[2] = 0x59;
+        }
+        emitBytes(a, op, 4);
+    }
+}
+
+// compiles the test of a branch, storing the positions of the jumps taken
+// when it is false in jumps and returning how many there are
+int compileTest(Assembler *a, Node *node, int *jumps) {
+    callKind kind = NOT_INLINE;
+    if (isCall(node)) {
+        kind = classify(node->call.fn, a->lambda);
+    }
+    if (!isComparison(kind)) {
+        // only #f is false: cmp dword [rax], BOOL_TYPE; cmp dword [rax+i], 0
+        compileValue(a, node);
+        char checkType[3] = {0x83, 0x38, BOOL_TYPE};
+        emitBytes(a, checkType, 3);
+        int notBool = emitJcc(a, NOT_EQ);
+        char checkFalse[4] = {0x83, 0x78, offsetof(Value, i), 0};
+        emitBytes(a, checkFalse, 4);
+        jumps[0] = emitJcc(a, EQ);
+        patchJcc(a, notBool);
+        return 1;
+    }
+
+    emitGuard(a, node->call.fn, kind);
+    if (!a->flonum) {
+        compileInt(a, node->call.args[0]);
+        pushInt(a);
+        compileInt(a, node->call.args[1]);
+        popInt(a);
+        // cmp rax, rcx, jumping when the comparison is false
+        emitBytes(a, "\x48\x39\xc8", 3);
+        condition negated[] = {GE, LE, GT, LT, NOT_EQ};
+        jumps[0] = emitJcc(a, negated[kind - LESS]);
+        return 1;
+    }
+    compileDouble(a, node->call.args[0]);
+    pushDouble(a);
+    compileDouble(a, node->call.args[1]);
+    popDouble(a);
+    // the primitives compare with the negated operator, so a comparison
+    // with NaN is false for =, and true for the others
+    const char *compare = "\x66\x0f\x2e\xc1";          // ucomisd xmm0, xmm1
+    const char *compareSwapped = "\x66\x0f\x2e\xc8";   // ucomisd xmm1, xmm0
+    switch (kind) {
+     case LESS: {
+        emitBytes(a, compare, 4);
+        jumps[0] = emitJcc(a, ABOVE_EQ);
+        return 1;
+     }
+     case GREATER: {
+        emitBytes(a, compareSwapped, 4);
+        jumps[0] = emitJcc(a, ABOVE_EQ);
+        return 1;
+     }
+     case LESS_EQ: {
+        emitBytes(a, compare, 4);
+        jumps[0] = emitJcc(a, ABOVE);
+        return 1;
+     }
+     case GR_EQ: {
+        emitBytes(a, compareSwapped, 4);
+        jumps[0] = emitJcc(a, ABOVE);
+        return 1;
+     }
+     default: {
+        emitBytes(a, compare, 4);
+        jumps[0] = emitJcc(a, NOT_EQ);
+        jumps[1] = emitJcc(a, PARITY);
+        return 2;
+     }
+    }
+}
+
+// compiles a call of the procedure itself, passing the arguments as an
+// array on the machine stack
+void compileSelfCall(Assembler *a, Node *node) {
+    emitGuard(a, node->call.fn, SELF);
+    int argc = node->call.argc;
+    int size = argc + (a->depth + argc) % 2;
+    // sub rsp, 8 * size
+    emitBytes(a, "\x48\x81\xec", 3);
+    emitInt32(a, 8 * size);
+    a->depth += size;
+    for (int i = 0; i < argc; i++) {
+        compileValue(a, node->call.args[i]);
+        // mov [rsp + 8 * i], rax
+        emitBytes(a, "\x48\x89\x84\x24", 4);
+        emitInt32(a, 8 * i);
+    }
+    // mov rdi, rsp; call the start of the code
+    emitBytes(a, "\x48\x89\xe7\xe8", 4);
+    emitInt32(a, -(a->length + 4));
+    // add rsp, 8 * size
+    emitBytes(a, "\x48\x81\xc4", 3);
+    emitInt32(a, 8 * size);
+    a->depth -= size;
+    // a bailout of the callee bails out of the caller too
+    emitBytes(a, "\x48\x85\xc0", 3);
+    emitBailout(a, EQ);
+}
+
+// compiles node so that it leaves a pointer to its value in rax
+void compileValue(Assembler *a, Node *node) {
+    switch (node->kind) {
+     case CONST_NODE: {
+        emitLoad(a, node->value, 0);
+        break;
+     }
+     case LOCAL_NODE: {
+        // mov rax, [rbx + 8 * index]
+        emitBytes(a, "\x48\x8b\x83", 3);
+        emitInt32(a, 8 * node->var.index);
+        break;
+     }
+     case IF_NODE: {
+        int jumps[2];
+        int count = compileTest(a, node->branch.test, jumps);
+        compileValue(a, node->branch.conseq);
+        int end = emitJcc(a, ALWAYS);
+        for (int i = 0; i < count; i++) {
+            patchJcc(a, jumps[i]);
+        }
+        compileValue(a, node->branch.alt);
+        patchJcc(a, end);
+        break;
+     }
+     default: {
+        callKind kind = classify(node->call.fn, a->lambda);
+        if (kind == SELF) {
+            compileSelfCall(a, node);
+        }
+        else if (isComparison(kind)) {
+            int jumps[2];
+            int count = compileTest(a, node, jumps);
+            emitLoad(a, trueValue, 0);
+            int end = emitJcc(a, ALWAYS);
+            for (int i = 0; i < count; i++) {
+                patchJcc(a, jumps[i]);
+            }
+            emitLoad(a, falseValue, 0);
+            patchJcc(a, end);
+        }
+        else if (!a->flonum) {
+            compileInt(a, node);
+            // mov rdi, rax
+            emitBytes(a, "\x48\x89\xc7", 3);
+            emitCCall(a, makeInt);
+        }
+        else {
+            compileDouble(a, node);
+            emitCCall(a, makeDouble);
+        }
+     }
+    }
+}
+
+// returns native code for lambda, or NULL if its body cannot be compiled
+void *compileNative(Node *lambda) {
+#if JIT_SUPPORTED
+    if (!lambda->lambda.flonum && !supported(lambda->lambda.body, lambda, 0)) {
+        lambda->lambda.flonum = 1;
+    }
+    if (lambda->lambda.flonum && !supported(lambda->lambda.body, lambda, 1)) {
+        return NULL;
+    }
+    if (trueValue == NULL) {
+        trueValue = makeTrue();
+        falseValue = makeFalse();
+    }
+    Assembler *a = talloc(sizeof(Assembler));
+    memset(a, 0, sizeof(Assembler));
+    a->lambda = lambda;
+    a->flonum = lambda->lambda.flonum;
+
+    // push rbp; mov rbp, rsp; push rbx; sub rsp, 8; mov rbx, rdi
+    emitBytes(a, "\x55\x48\x89\xe5\x53\x48\x83\xec\x08\x48\x89\xfb", 12);
+    // cmp rsp, [stackLimit]; jb bailout
+    emitLoad(a, &stackLimit, 0);
+    emitBytes(a, "\x48\x3b\x20", 3);
+    emitBailout(a, BELOW);
+    compileValue(a, lambda->lambda.body);
+    // mov rbx, [rbp - 8]; leave; ret
+    int exit = a->length;
+    emitBytes(a, "\x48\x8b\x5d\xf8\xc9\xc3", 6);
+    for (int i = 0; i < a->bailoutCount; i++) {
+        patchJcc(a, a->bailouts[i]);
+    }
+    // xor eax, eax; jmp exit
+    emitBytes(a, "\x31\xc0\xe9", 3);
+    emitInt32(a, exit - (a->length + 4));
+
+    void *code = mmap(NULL, a->length, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code == MAP_FAILED) {
+        return NULL;
+    }
+    memcpy(code, a->bytes, a->length);
+    if (mprotect(code, a->length, PROT_READ | PROT_EXEC) != 0) {
+        munmap(code, a->length);
+        return NULL;
+    }
+    return code;
+#else
+    return NULL;
+#endif
+}
+
+// Runs a call of lambda on the argc arguments in argv as native code, counting
+// calls to compile it once it is hot. Returns NULL when the call has to be
+// interpreted instead: the lambda is not compiled (yet), or a guard of its
+// code failed.
+Value *jitCall(Node *lambda, int argc, Value **argv) {
+    if (!jitEnabled) {
+        return NULL;
+    }
+    if (lambda->lambda.native == NULL) {
+        if (lambda->lambda.calls < 0) {
+            return NULL;
+        }
+        lambda->lambda.calls++;
+        if (lambda->lambda.calls < JIT_THRESHOLD) {
+            return NULL;
+        }
+        lambda->lambda.native = compileNative(lambda);
+        if (lambda->lambda.native == NULL) {
+            lambda->lambda.calls = -1;
+            return NULL;
+        }
+        // from now on, calls counts bailouts
+        lambda->lambda.calls = 0;
+    }
+    if (argc != lambda->lambda.paramCount) {
+        return NULL;
+    }
+    if (stackLimit == NULL) {
+        // leave half of the usual 8MB of C stack to the interpreter
+        char here;
+        stackLimit = &here - (1 << 22);
+        if (stackLimit < stackEnd) {
+            stackLimit = stackEnd;
+        }
+    }
+    Value *result = ((nativeCode)lambda->lambda.native)(argv);
+    if (result == NULL) {
+        lambda->lambda.calls++;
+        if (lambda->lambda.calls > JIT_MAX_BAILOUTS) {
+            // code for fixnums gets another chance as code for flonums
+            lambda->lambda.native = NULL;
+            lambda->lambda.calls = lambda->lambda.flonum ? -1 : 0;
+            lambda->lambda.flonum = 1;
+        }
+    }
+    return result;
+}
@@ -0,0 +1,25 @@
+#include "value.h"
+#include "analyzer.h"
+
+#ifndef _JIT
+#define _JIT
+
+// a lambda is compiled to native code once it has been called this many times
+#define JIT_THRESHOLD 100
+
+// native code is dropped after failing this many of its guards
+#define JIT_MAX_BAILOUTS 10
+
+// Runs a call of lambda on the argc arguments in argv as native code, counting
+// calls to compile it once it is hot. Returns NULL when the call has to be
+// interpreted instead: the lambda is not compiled (yet), or a guard of its
+// code failed.
+Value *jitCall(Node *lambda, int argc, Value **argv);
+
+// Turns the JIT off for the rest of the run.
+void disableJit();
+
+// Tells the JIT that the C stack it runs on ends at end.
+void setJitStackEnd(char *end);
+
+#endif
@@ -4,6 +4,7 @@
 #include <stdio.h>
 #include "talloc.h"
 #include "linkedlist.h"
+#include "hashtable.h"
 #include <assert.h>
 
 // Create a new NULL_TYPE value node.
@@ -13,6 +14,34 @@ Value *makeNull() {
   return new;
 }
 
+// Create a new SYMBOL_TYPE value node naming name.
+Value *makeSymbol(char *name) {
+  Value *new = talloc(sizeof(Value));
+  new->type = SYMBOL_TYPE;
+  new->s = intern(name);
+  return new;
+}
+
+// Create a new INT_TYPE value node holding n.
+Value *makeInt(long n) {
+  Value *new = talloc(sizeof(Value));
+  new->type = INT_TYPE;
+  new->i = n;
+  return new;
+}
+
+// Create a new VECTOR_TYPE value node of length elements, each fill.
+Value *makeVector(int length, Value *fill) {
+  Value *new = talloc(sizeof(Value));
+  new->type = VECTOR_TYPE;
+  new->vec.length = length;
+  new->vec.items = talloc(length * sizeof(Value *));
+  for (int i = 0; i < length; i++) {
+    new->vec.items[i] = fill;
+  }
+  return new;
+}
+
 // Create a new CONS_TYPE value node.
 Value *cons(Value *car, Value *cdr) {
   Value *new = talloc(sizeof(Value));
@@ -25,13 +54,13 @@ Value *cons(Value *car, Value *cdr) {
 // Helper function that displays the items of the list
 void display2(Value *list) {
   if (list->type == INT_TYPE) {
-    printf("%i", list->i);
+    printf("%li", list->i);
   }
   else if (list->type == DOUBLE_TYPE){
     printf("%f", list->d);
   }
   else if (list->type == STR_TYPE){
-    printf("%s", list->s);
+    printf("%.*s", (int)list->str.length, list->str.chars);
   }
   else if (list->type == NULL_TYPE){
     printf(")");
@@ -7,6 +7,15 @@
 // Create a new NULL_TYPE value node.
 Value *makeNull();
 
+// Create a new SYMBOL_TYPE value node naming name, which is interned.
+Value *makeSymbol(char *name);
+
+// Create a new INT_TYPE value node holding n.
+Value *makeInt(long n);
+
+// Create a new VECTOR_TYPE value node of length elements, each fill.
+Value *makeVector(int length, Value *fill);
+
 // Create a new CONS_TYPE value node.
 Value *cons(Value *newCar, Value *newCdr);
 
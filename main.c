@@ -1,18 +1,57 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
 #include "tokenizer.h"
 #include "value.h"
 #include "linkedlist.h"
 #include "parser.h"
 #include "talloc.h"
 #include "interpreter.h"
+#include "jit.h"
+#include "optimizer.h"
 
-int main() {
+int main(int argc, char **argv) {
+    // --vm runs the program on the bytecode virtual machine; --no-jit keeps
+    // procedures from being compiled to machine code; --optimize rewrites the
+    // program before running it, and --verbose reports what it changed;
+    // --max-depth n makes evaluation nested more than n deep an error
+    int bytecode = 0;
+    int optimizing = 0;
+    int verbose = 0;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--vm")) {
+            bytecode = 1;
+        }
+        else if (!strcmp(argv[i], "--no-jit")) {
+            disableJit();
+        }
+        else if (!strcmp(argv[i], "--optimize")) {
+            optimizing = 1;
+        }
+        else if (!strcmp(argv[i], "--verbose")) {
+            verbose = 1;
+        }
+        else if (!strcmp(argv[i], "--max-depth")) {
+            char *end = NULL;
+            long depth = i + 1 < argc ? strtol(argv[++i], &end, 10) : 0;
+            if (end == NULL || end == argv[i] || *end != '\0' ||
+                depth <= 0 || depth > INT_MAX) {
+                fprintf(stderr, "--max-depth needs a positive integer\n");
+                return 2;
+            }
+            setMaxDepth(depth);
+        }
+    }
 
     Value *list = tokenize(stdin);
     //displayTokens(list);
     Value *tree = parse(list);
     //printTree(tree);
-    interpret(tree);
+    if (optimizing) {
+        tree = optimize(tree, verbose);
+    }
+    int status = interpret(tree, bytecode);
     tfree();
-    return 0;
+    return status;
 }
\ No newline at end of file
@@ -0,0 +1,566 @@
+// Kernels of the bulk operations on f64vectors and s64vectors. Each runs its
+// main loop over whole SIMD registers, two lanes wide in SSE2, which every
+// x86-64 CPU has, or four in AVX2 where the CPU reports it, and finishes the
+// elements left over one at a time. s64 multiplication and division have no
+// SIMD instructions below AVX-512, so they are always done one at a time.
+
+#include <limits.h>
+#include "numvector.h"
+#include "linkedlist.h"
+#include "talloc.h"
+
+#ifdef __x86_64__
+#include <immintrin.h>
+#define AVX2 __attribute__((target("avx2")))
+#endif
+
+Value *makeNumVector(valueType type, long length) {
+    Value *value = makeNull();
+    value->type = type;
+    value->nv.length = length;
+    value->nv.f64 = NULL;
+    value->nv.s64 = NULL;
+    if (type == F64VECTOR_TYPE) {
+        value->nv.f64 = talloc(length * sizeof(double));
+        for (long i = 0; i < length; i++) {
+            value->nv.f64[i] = 0;
+        }
+    }
+    else {
+        value->nv.s64 = talloc(length * sizeof(long));
+        for (long i = 0; i < length; i++) {
+            value->nv.s64[i] = 0;
+        }
+    }
+    return value;
+}
+
+void *numVectorData(Value *vector) {
+    if (vector->type == F64VECTOR_TYPE) {
+        return vector->nv.f64;
+    }
+    return vector->nv.s64;
+}
+
+// whether the CPU has AVX2: 1 or 0 once known, -1 before
+int avx2Support = -1;
+
+// returns whether the AVX2 kernels can run
+int useAvx2() {
+#ifdef __x86_64__
+    if (avx2Support < 0) {
+        avx2Support = __builtin_cpu_supports("avx2") != 0;
+    }
+    return avx2Support;
+#else
+    return 0;
+#endif
+}
+
+// stores op applied to the elements of a and b from i on, in vectors of
+// width lanes, as long as whole vectors remain
+#define VECTOR_LOOP(width, load, store, op)                                 \
+    for (; i + (width) <= n; i += (width)) {                                \
+        store(out + i, op(load(a + i), load(b + i)));                       \
+    }
+
+#ifdef __x86_64__
+
+// the same loops, comparing the elements and storing 1 for true and 0 for
+// false, given the mask each comparison makes
+#define MASK_LOOP(width, load, compare, one, and, cast, store)             \
+    for (; i + (width) <= n; i += (width)) {                                \
+        store((void *)(out + i),                                            \
+              and(cast(compare(load(a + i), load(b + i))), one));           \
+    }
+
+__m128d lessSse2(__m128d a, __m128d b) {
+    return _mm_cmplt_pd(a, b);
+}
+
+__m128d equalSse2(__m128d a, __m128d b) {
+    return _mm_cmpeq_pd(a, b);
+}
+
+AVX2 __m256d lessAvx2(__m256d a, __m256d b) {
+    return _mm256_cmp_pd(a, b, _CMP_LT_OQ);
+}
+
+AVX2 __m256d equalAvx2(__m256d a, __m256d b) {
+    return _mm256_cmp_pd(a, b, _CMP_EQ_OQ);
+}
+
+AVX2 __m256i loadS64Avx2(long *a) {
+    return _mm256_loadu_si256((void *)a);
+}
+
+AVX2 __m256i lessS64Avx2(__m256i a, __m256i b) {
+    return _mm256_cmpgt_epi64(b, a);
+}
+
+// the kernels return how many elements they did
+
+long f64LanesSse2(laneOp op, double *out, double *a, double *b, long n) {
+    long i = 0;
+    switch (op) {
+     case LANE_ADD: VECTOR_LOOP(2, _mm_loadu_pd, _mm_storeu_pd, _mm_add_pd);
+        break;
+     case LANE_SUB: VECTOR_LOOP(2, _mm_loadu_pd, _mm_storeu_pd, _mm_sub_pd);
+        break;
+     case LANE_MUL: VECTOR_LOOP(2, _mm_loadu_pd, _mm_storeu_pd, _mm_mul_pd);
+        break;
+     default: VECTOR_LOOP(2, _mm_loadu_pd, _mm_storeu_pd, _mm_div_pd);
+        break;
+    }
+    return i;
+}
+
+AVX2 long f64LanesAvx2(laneOp op, double *out, double *a, double *b, long n) {
+    long i = 0;
+    switch (op) {
+     case LANE_ADD:
+        VECTOR_LOOP(4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_add_pd);
+        break;
+     case LANE_SUB:
+        VECTOR_LOOP(4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_sub_pd);
+        break;
+     case LANE_MUL:
+        VECTOR_LOOP(4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_mul_pd);
+        break;
+     default:
+        VECTOR_LOOP(4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_div_pd);
+        break;
+    }
+    return i;
+}
+
+long f64CompareSse2(laneOp op, long *out, double *a, double *b, long n) {
+    long i = 0;
+    __m128i one = _mm_set1_epi64x(1);
+    if (op == LANE_LESS) {
+        MASK_LOOP(2, _mm_loadu_pd, lessSse2, one, _mm_and_si128,
+                  _mm_castpd_si128, _mm_storeu_si128);
+    }
+    else {
+        MASK_LOOP(2, _mm_loadu_pd, equalSse2, one, _mm_and_si128,
+                  _mm_castpd_si128, _mm_storeu_si128);
+    }
+    return i;
+}
+
+AVX2 long f64CompareAvx2(laneOp op, long *out, double *a, double *b, long n) {
+    long i = 0;
+    __m256i one = _mm256_set1_epi64x(1);
+    if (op == LANE_LESS) {
+        MASK_LOOP(4, _mm256_loadu_pd, lessAvx2, one, _mm256_and_si256,
+                  _mm256_castpd_si256, _mm256_storeu_si256);
+    }
+    else {
+        MASK_LOOP(4, _mm256_loadu_pd, equalAvx2, one, _mm256_and_si256,
+                  _mm256_castpd_si256, _mm256_storeu_si256);
+    }
+    return i;
+}
+
+long f64ScaleSse2(double *out, double *a, double k, long n) {
+    long i = 0;
+    __m128d factor = _mm_set1_pd(k);
+    for (; i + 2 <= n; i += 2) {
+        _mm_storeu_pd(out + i, _mm_mul_pd(_mm_loadu_pd(a + i), factor));
+    }
+    return i;
+}
+
+AVX2 long f64ScaleAvx2(double *out, double *a, double k, long n) {
+    long i = 0;
+    __m256d factor = _mm256_set1_pd(k);
+    for (; i + 4 <= n; i += 4) {
+        _mm256_storeu_pd(out + i,
+                         _mm256_mul_pd(_mm256_loadu_pd(a + i), factor));
+    }
+    return i;
+}
+
+// the dot product of a and b, or the sum of a if b is NULL, over whole
+// vectors, stored in *total
+long f64DotSse2(double *a, double *b, long n, double *total) {
+    long i = 0;
+    __m128d sum = _mm_setzero_pd();
+    for (; i + 2 <= n; i += 2) {
+        __m128d x = _mm_loadu_pd(a + i);
+        sum = _mm_add_pd(sum, b ? _mm_mul_pd(x, _mm_loadu_pd(b + i)) : x);
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, sum);
+    *total = lanes[0] + lanes[1];
+    return i;
+}
+
+AVX2 long f64DotAvx2(double *a, double *b, long n, double *total) {
+    long i = 0;
+    __m256d sum = _mm256_setzero_pd();
+    for (; i + 4 <= n; i += 4) {
+        __m256d x = _mm256_loadu_pd(a + i);
+        sum = _mm256_add_pd(sum,
+                            b ? _mm256_mul_pd(x, _mm256_loadu_pd(b + i)) : x);
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, sum);
+    *total = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    return i;
+}
+
+// the extremum of whole vectors of a, stored in *best; n is at least the
+// width
+long f64ExtremumSse2(double *a, long n, int max, double *best) {
+    __m128d result = _mm_loadu_pd(a);
+    long i = 2;
+    for (; i + 2 <= n; i += 2) {
+        __m128d x = _mm_loadu_pd(a + i);
+        result = max ? _mm_max_pd(result, x) : _mm_min_pd(result, x);
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, result);
+    *best = (max ? lanes[1] > lanes[0] : lanes[1] < lanes[0]) ? lanes[1]
+                                                               : lanes[0];
+    return i;
+}
+
+AVX2 long f64ExtremumAvx2(double *a, long n, int max, double *best) {
+    __m256d result = _mm256_loadu_pd(a);
+    long i = 4;
+    for (; i + 4 <= n; i += 4) {
+        __m256d x = _mm256_loadu_pd(a + i);
+        result = max ? _mm256_max_pd(result, x) : _mm256_min_pd(result, x);
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, result);
+    *best = lanes[0];
+    for (int lane = 1; lane < 4; lane++) {
+        if (max ? lanes[lane] > *best : lanes[lane] < *best) {
+            *best = lanes[lane];
+        }
+    }
+    return i;
+}
+
+// sums or differences of s64 lanes, noting in *overflow whether any
+// overflowed: that is when the result's sign differs from both operands'
+// for a sum, or from the first one's and not the second one's for a
+// difference
+long s64AddSse2(laneOp op, long *out, long *a, long *b, long n,
+                int *overflow) {
+    long i = 0;
+    __m128i signs = _mm_setzero_si128();
+    for (; i + 2 <= n; i += 2) {
+        __m128i x = _mm_loadu_si128((void *)(a + i));
+        __m128i y = _mm_loadu_si128((void *)(b + i));
+        __m128i r;
+        if (op == LANE_ADD) {
+            r = _mm_add_epi64(x, y);
+            signs = _mm_or_si128(signs, _mm_and_si128(_mm_xor_si128(x, r),
+                                                      _mm_xor_si128(y, r)));
+        }
+        else {
+            r = _mm_sub_epi64(x, y);
+            signs = _mm_or_si128(signs, _mm_and_si128(_mm_xor_si128(x, y),
+                                                      _mm_xor_si128(x, r)));
+        }
+        _mm_storeu_si128((void *)(out + i), r);
+    }
+    *overflow = _mm_movemask_pd(_mm_castsi128_pd(signs)) != 0;
+    return i;
+}
+
+AVX2 long s64AddAvx2(laneOp op, long *out, long *a, long *b, long n,
+                     int *overflow) {
+    long i = 0;
+    __m256i signs = _mm256_setzero_si256();
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_loadu_si256((void *)(a + i));
+        __m256i y = _mm256_loadu_si256((void *)(b + i));
+        __m256i r;
+        if (op == LANE_ADD) {
+            r = _mm256_add_epi64(x, y);
+            signs = _mm256_or_si256(signs,
+                                    _mm256_and_si256(_mm256_xor_si256(x, r),
+                                                     _mm256_xor_si256(y, r)));
+        }
+        else {
+            r = _mm256_sub_epi64(x, y);
+            signs = _mm256_or_si256(signs,
+                                    _mm256_and_si256(_mm256_xor_si256(x, y),
+                                                     _mm256_xor_si256(x, r)));
+        }
+        _mm256_storeu_si256((void *)(out + i), r);
+    }
+    *overflow = _mm256_movemask_pd(_mm256_castsi256_pd(signs)) != 0;
+    return i;
+}
+
+// SSE2 has no 64-bit comparisons, so only AVX2 compares s64 lanes
+AVX2 long s64CompareAvx2(laneOp op, long *out, long *a, long *b, long n) {
+    long i = 0;
+    __m256i one = _mm256_set1_epi64x(1);
+    if (op == LANE_LESS) {
+        MASK_LOOP(4, loadS64Avx2, lessS64Avx2, one, _mm256_and_si256,
+                  , _mm256_storeu_si256);
+    }
+    else {
+        MASK_LOOP(4, loadS64Avx2, _mm256_cmpeq_epi64, one,
+                  _mm256_and_si256, , _mm256_storeu_si256);
+    }
+    return i;
+}
+
+// the sum of whole vectors of a in *total, which is only right if
+// *overflow is not set
+AVX2 long s64SumAvx2(long *a, long n, long *total, int *overflow) {
+    long i = 0;
+    __m256i sum = _mm256_setzero_si256();
+    __m256i signs = _mm256_setzero_si256();
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_loadu_si256((void *)(a + i));
+        __m256i r = _mm256_add_epi64(sum, x);
+        signs = _mm256_or_si256(signs,
+                                _mm256_and_si256(_mm256_xor_si256(sum, r),
+                                                 _mm256_xor_si256(x, r)));
+        sum = r;
+    }
+    long lanes[4];
+    _mm256_storeu_si256((void *)lanes, sum);
+    *overflow = _mm256_movemask_pd(_mm256_castsi256_pd(signs)) != 0;
+    *total = 0;
+    for (int lane = 0; lane < 4; lane++) {
+        if (__builtin_add_overflow(*total, lanes[lane], total)) {
+            *overflow = 1;
+        }
+    }
+    return i;
+}
+
+AVX2 long s64ExtremumAvx2(long *a, long n, int max, long *best) {
+    __m256i result = _mm256_loadu_si256((void *)a);
+    long i = 4;
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_loadu_si256((void *)(a + i));
+        __m256i greater = _mm256_cmpgt_epi64(x, result);
+        // takes x where it is greater for max, and where it is not for min
+        result = max ? _mm256_blendv_epi8(result, x, greater)
+                     : _mm256_blendv_epi8(x, result, greater);
+    }
+    long lanes[4];
+    _mm256_storeu_si256((void *)lanes, result);
+    *best = lanes[0];
+    for (int lane = 1; lane < 4; lane++) {
+        if (max ? lanes[lane] > *best : lanes[lane] < *best) {
+            *best = lanes[lane];
+        }
+    }
+    return i;
+}
+
+#endif
+
+void f64Lanes(laneOp op, double *out, double *a, double *b, long n) {
+    long i = 0;
+#ifdef __x86_64__
+    i = useAvx2() ? f64LanesAvx2(op, out, a, b, n)
+                  : f64LanesSse2(op, out, a, b, n);
+#endif
+    for (; i < n; i++) {
+        switch (op) {
+         case LANE_ADD: out[i] = a[i] + b[i];
+            break;
+         case LANE_SUB: out[i] = a[i] - b[i];
+            break;
+         case LANE_MUL: out[i] = a[i] * b[i];
+            break;
+         default: out[i] = a[i] / b[i];
+            break;
+        }
+    }
+}
+
+void f64Compare(laneOp op, long *out, double *a, double *b, long n) {
+    long i = 0;
+#ifdef __x86_64__
+    i = useAvx2() ? f64CompareAvx2(op, out, a, b, n)
+                  : f64CompareSse2(op, out, a, b, n);
+#endif
+    for (; i < n; i++) {
+        out[i] = op == LANE_LESS ? a[i] < b[i] : a[i] == b[i];
+    }
+}
+
+void f64Scale(double *out, double *a, double k, long n) {
+    long i = 0;
+#ifdef __x86_64__
+    i = useAvx2() ? f64ScaleAvx2(out, a, k, n) : f64ScaleSse2(out, a, k, n);
+#endif
+    for (; i < n; i++) {
+        out[i] = a[i] * k;
+    }
+}
+
+// the dot product of a and b, or with b NULL, the sum of a
+double f64Total(double *a, double *b, long n) {
+    long i = 0;
+    double total = 0;
+#ifdef __x86_64__
+    i = useAvx2() ? f64DotAvx2(a, b, n, &total)
+                  : f64DotSse2(a, b, n, &total);
+#endif
+    for (; i < n; i++) {
+        total += b ? a[i] * b[i] : a[i];
+    }
+    return total;
+}
+
+double f64Dot(double *a, double *b, long n) {
+    return f64Total(a, b, n);
+}
+
+double f64Sum(double *a, long n) {
+    return f64Total(a, NULL, n);
+}
+
+double f64Extremum(double *a, long n, int max) {
+    long i = 1;
+    double best = a[0];
+#ifdef __x86_64__
+    if (useAvx2() && n >= 4) {
+        i = f64ExtremumAvx2(a, n, max, &best);
+    }
+    else if (n >= 2) {
+        i = f64ExtremumSse2(a, n, max, &best);
+    }
+#endif
+    for (; i < n; i++) {
+        if (max ? a[i] > best : a[i] < best) {
+            best = a[i];
+        }
+    }
+    return best;
+}
+
+laneStatus s64Lanes(laneOp op, long *out, long *a, long *b, long n) {
+    long i = 0;
+#ifdef __x86_64__
+    if (op == LANE_ADD || op == LANE_SUB) {
+        int overflow;
+        i = useAvx2() ? s64AddAvx2(op, out, a, b, n, &overflow)
+                      : s64AddSse2(op, out, a, b, n, &overflow);
+        if (overflow) {
+            return LANES_OVERFLOW;
+        }
+    }
+#endif
+    for (; i < n; i++) {
+        int overflow;
+        switch (op) {
+         case LANE_ADD:
+            overflow = __builtin_add_overflow(a[i], b[i], &out[i]);
+            break;
+         case LANE_SUB:
+            overflow = __builtin_sub_overflow(a[i], b[i], &out[i]);
+            break;
+         case LANE_MUL:
+            overflow = __builtin_mul_overflow(a[i], b[i], &out[i]);
+            break;
+         default:
+            if (b[i] == 0) {
+                return LANES_DIVIDE_BY_ZERO;
+            }
+            overflow = a[i] == LONG_MIN && b[i] == -1;
+            if (!overflow) {
+                out[i] = a[i] / b[i];
+            }
+            break;
+        }
+        if (overflow) {
+            return LANES_OVERFLOW;
+        }
+    }
+    return LANES_OK;
+}
+
+void s64Compare(laneOp op, long *out, long *a, long *b, long n) {
+    long i = 0;
+#ifdef __x86_64__
+    if (useAvx2()) {
+        i = s64CompareAvx2(op, out, a, b, n);
+    }
+#endif
+    for (; i < n; i++) {
+        out[i] = op == LANE_LESS ? a[i] < b[i] : a[i] == b[i];
+    }
+}
+
+laneStatus s64Scale(long *out, long *a, long k, long n) {
+    for (long i = 0; i < n; i++) {
+        if (__builtin_mul_overflow(a[i], k, &out[i])) {
+            return LANES_OVERFLOW;
+        }
+    }
+    return LANES_OK;
+}
+
+long s64Dot(long *a, long *b, long n, long *result) {
+    long total = 0;
+    long i = 0;
+    for (; i < n; i++) {
+        long product;
+        long next;
+        if (__builtin_mul_overflow(a[i], b[i], &product) ||
+            __builtin_add_overflow(total, product, &next)) {
+            break;
+        }
+        total = next;
+    }
+    *result = total;
+    return i;
+}
+
+long s64Sum(long *a, long n, long *result) {
+    long i = 0;
+    long total = 0;
+#ifdef __x86_64__
+    if (useAvx2()) {
+        int overflow;
+        i = s64SumAvx2(a, n, &total, &overflow);
+        if (overflow) {
+            // a lane overflowing says nothing of the total, so the sum is
+            // done again one element at a time
+            i = 0;
+            total = 0;
+        }
+    }
+#endif
+    for (; i < n; i++) {
+        // total only takes sums that fit, since the caller goes on from it
+        long next;
+        if (__builtin_add_overflow(total, a[i], &next)) {
+            break;
+        }
+        total = next;
+    }
+    *result = total;
+    return i;
+}
+
+long s64Extremum(long *a, long n, int max) {
+    long i = 1;
+    long best = a[0];
+#ifdef __x86_64__
+    if (useAvx2() && n >= 4) {
+        i = s64ExtremumAvx2(a, n, max, &best);
+    }
+#endif
+    for (; i < n; i++) {
+        if (max ? a[i] > best : a[i] < best) {
+            best = a[i];
+        }
+    }
+    return best;
+}
@@ -0,0 +1,52 @@
+#include "value.h"
+
+#ifndef _NUMVECTOR
+#define _NUMVECTOR
+
+// The kernels of the bulk operations on f64vectors and s64vectors, whose
+// elements are unboxed doubles and longs. On x86-64 they run in SSE2, or in
+// AVX2 where the CPU has it; elsewhere they are plain loops.
+
+// what a kernel computes for each pair of elements
+typedef enum {LANE_ADD, LANE_SUB, LANE_MUL, LANE_DIV, LANE_LESS,
+              LANE_EQUAL} laneOp;
+
+// what an s64 kernel can run into
+typedef enum {LANES_OK, LANES_OVERFLOW, LANES_DIVIDE_BY_ZERO} laneStatus;
+
+// Returns a new F64VECTOR_TYPE or S64VECTOR_TYPE value of length elements,
+// all zero.
+Value *makeNumVector(valueType type, long length);
+
+// Returns the elements of an f64vector or s64vector, which are 8 bytes each.
+void *numVectorData(Value *vector);
+
+// out[i] = a[i] op b[i], for op from LANE_ADD to LANE_DIV.
+void f64Lanes(laneOp op, double *out, double *a, double *b, long n);
+
+// out[i] = 1 if a[i] op b[i], or 0 otherwise, for LANE_LESS or LANE_EQUAL.
+void f64Compare(laneOp op, long *out, double *a, double *b, long n);
+
+void f64Scale(double *out, double *a, double k, long n);
+double f64Dot(double *a, double *b, long n);
+double f64Sum(double *a, long n);
+
+// Returns the greatest element of a if max is set, the least otherwise; n
+// is at least 1.
+double f64Extremum(double *a, long n, int max);
+
+// The s64 versions: quotients are truncated, and results that overflow a
+// long make the kernel stop and say so.
+laneStatus s64Lanes(laneOp op, long *out, long *a, long *b, long n);
+void s64Compare(laneOp op, long *out, long *a, long *b, long n);
+laneStatus s64Scale(long *out, long *a, long k, long n);
+long s64Extremum(long *a, long n, int max);
+
+// The sum of the products of the elements of a and b, and the sum of the
+// elements of a, as far as they fit a long: these return how many elements,
+// from the first, the total in *result covers, which is n unless adding the
+// next one overflows, so that the caller can go on from there exactly.
+long s64Dot(long *a, long *b, long n, long *result);
+long s64Sum(long *a, long n, long *result);
+
+#endif
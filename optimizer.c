@@ -0,0 +1,902 @@
+// A source-to-source optimization pass over the output of parse(). It works
+// on the tree the analyzer would see, so every rewrite has to keep its
+// meaning exactly the same, errors included:
+// - only calls of primitives whose names the program never rebinds (by
+//   define, set!, or as a parameter or let variable) are folded, and only
+//   when the primitive cannot fail on the literal arguments;
+// - code containing a define is never dropped, since the analyzer gives
+//   every define a slot in the enclosing frame;
+// - only bindings and definitions whose value is a constant or a lambda are
+//   dropped, since evaluating those has no effect;
+// - only procedures bound once by a top-level define, and by nothing else in
+//   the program, are inlined, and only at calls after the definition. Their
+//   variables are renamed, and free names of the body must not be bound
+//   anywhere but at top level, so that nothing at the call site can capture
+//   them.
+
+#include <stdio.h>
+#include <string.h>
+#include "optimizer.h"
+#include "interpreter.h"
+#include "analyzer.h"
+#include "linkedlist.h"
+#include "talloc.h"
+#include "bignum.h"
+#include "text.h"
+
+// A primitive the optimizer can evaluate at compile time.
+typedef struct Foldable {
+    char *name;
+    Value *(*function)(int, Value **);
+    int minArgs;
+} Foldable;
+
+Foldable foldables[] = {
+    {"+", primitiveAdd, 0},
+    {"-", primitiveSub, 0},
+    {"*", primitiveMult, 0},
+    {"/", primitiveDiv, 1},
+    {"modulo", primitiveMod, 2},
+    {"quotient", primitiveQuotient, 2},
+    {"remainder", primitiveRemainder, 2},
+    {"abs", primitiveAbs, 1},
+    {"min", primitiveMin, 1},
+    {"max", primitiveMax, 1},
+    {"<", primitiveLess, 2},
+    {">", primitiveGreater, 2},
+    {"<=", primitiveLessEq, 2},
+    {">=", primitiveGrEq, 2},
+    {"=", primitiveEqual, 2}
+};
+
+char *keywords[] = {"quote", "lambda", "define", "set!", "let", "let*",
+                    "letrec", "if", "cond", "else", "begin", "and", "or",
+                    "guard", "delay", "delay-force", "cons-stream"};
+
+int reporting = 0;
+
+// symbols the program binds anywhere
+Value *rebound;
+
+// symbols the program binds anywhere but in top-level defines
+Value *localNames;
+
+// the top-level definitions of the procedures that calls may be inlined from
+Value *inlinable;
+
+// symbols assigned by a define or set! anywhere in the program
+Value *assigned;
+
+// the local variables in scope at the expression being optimized
+Value *scope;
+
+// set when an expression cannot be renamed without changing its meaning
+int unsafe = 0;
+
+int freshNames = 0;
+
+Value *optimizeExpr(Value *expr);
+
+// writes value as Scheme source
+void writeValue(FILE *out, Value *value) {
+    switch (value->type) {
+     case INT_TYPE: {
+        fprintf(out, "%li", value->i);
+        break;
+     }
+     case BIGNUM_TYPE: {
+        fprintf(out, "%s", integerToString(value));
+        break;
+     }
+     case DOUBLE_TYPE: {
+        fprintf(out, "%f", value->d);
+        break;
+     }
+     case BOOL_TYPE: {
+        fprintf(out, value->i ? "#t" : "#f");
+        break;
+     }
+     case STR_TYPE:
+     case CHAR_TYPE: {
+        writeText(out, value);
+        break;
+     }
+     case SYMBOL_TYPE: {
+        fprintf(out, "%s", value->s);
+        break;
+     }
+     case CONS_TYPE: {
+        fprintf(out, "(");
+        while (value->type == CONS_TYPE) {
+            writeValue(out, car(value));
+            value = cdr(value);
+            if (value->type == CONS_TYPE) {
+                fprintf(out, " ");
+            }
+        }
+        if (value->type != NULL_TYPE) {
+            fprintf(out, " . ");
+            writeValue(out, value);
+        }
+        fprintf(out, ")");
+        break;
+     }
+     case VECTOR_TYPE: {
+        fprintf(out, "#(");
+        for (int i = 0; i < value->vec.length; i++) {
+            if (i > 0) {
+                fprintf(out, " ");
+            }
+            if (value->vec.items[i]->type == NULL_TYPE) {
+                fprintf(out, "()");
+            }
+            else {
+                writeValue(out, value->vec.items[i]);
+            }
+        }
+        fprintf(out, ")");
+        break;
+     }
+     default: {
+        break;
+     }
+    }
+}
+
+// reports in verbose mode that before was rewritten as after
+void report(char *what, Value *before, Value *after) {
+    if (!reporting) {
+        return;
+    }
+    fprintf(stderr, "optimizer: %s ", what);
+    writeValue(stderr, before);
+    if (after != NULL) {
+        fprintf(stderr, " => ");
+        writeValue(stderr, after);
+    }
+    fprintf(stderr, "\n");
+}
+
+int isSymbol(Value *value, char *name) {
+    return value->type == SYMBOL_TYPE && !strcmp(value->s, name);
+}
+
+// returns the length of a proper list, or -1 for anything else
+int formLength(Value *list) {
+    int count = 0;
+    while (list->type == CONS_TYPE) {
+        count++;
+        list = cdr(list);
+    }
+    return list->type == NULL_TYPE ? count : -1;
+}
+
+// returns how many times the symbol name occurs in tree
+int countSymbol(Value *tree, char *name) {
+    if (tree->type == SYMBOL_TYPE) {
+        return !strcmp(tree->s, name);
+    }
+    int count = 0;
+    while (tree->type == CONS_TYPE) {
+        count += countSymbol(car(tree), name);
+        tree = cdr(tree);
+    }
+    return count + (tree->type == SYMBOL_TYPE && !strcmp(tree->s, name));
+}
+
+void addBinding(Value *symbol, Value **names) {
+    if (symbol->type == SYMBOL_TYPE) {
+        *names = cons(symbol, *names);
+    }
+}
+
+// adds every symbol that tree binds, at any depth, to names; set! counts as
+// binding if assignments is set
+void collectBindings(Value *tree, int assignments, Value **names) {
+    if (tree->type != CONS_TYPE) {
+        return;
+    }
+    Value *first = car(tree);
+    Value *rest = cdr(tree);
+    if ((isSymbol(first, "define") ||
+         (assignments && isSymbol(first, "set!"))) &&
+        rest->type == CONS_TYPE) {
+        addBinding(car(rest), names);
+    }
+    else if (isSymbol(first, "lambda") && rest->type == CONS_TYPE) {
+        Value *params = car(rest);
+        while (params->type == CONS_TYPE) {
+            addBinding(car(params), names);
+            params = cdr(params);
+        }
+        addBinding(params, names);
+    }
+    else if ((isSymbol(first, "let") || isSymbol(first, "let*") ||
+              isSymbol(first, "letrec")) && rest->type == CONS_TYPE) {
+        for (Value *b = car(rest); b->type == CONS_TYPE; b = cdr(b)) {
+            if (car(b)->type == CONS_TYPE) {
+                addBinding(car(car(b)), names);
+            }
+        }
+    }
+    while (tree->type == CONS_TYPE) {
+        collectBindings(car(tree), assignments, names);
+        tree = cdr(tree);
+    }
+}
+
+int isMember(Value *names, char *name) {
+    for (; names->type == CONS_TYPE; names = cdr(names)) {
+        if (!strcmp(car(names)->s, name)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int isKeyword(char *name) {
+    for (int i = 0; i < sizeof(keywords) / sizeof(char *); i++) {
+        if (!strcmp(keywords[i], name)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// adds every symbol that a define or set! in tree assigns to assigned
+void collectAssigned(Value *tree) {
+    if (tree->type != CONS_TYPE) {
+        return;
+    }
+    if ((isSymbol(car(tree), "define") || isSymbol(car(tree), "set!")) &&
+        cdr(tree)->type == CONS_TYPE) {
+        addBinding(car(cdr(tree)), &assigned);
+    }
+    while (tree->type == CONS_TYPE) {
+        collectAssigned(car(tree));
+        tree = cdr(tree);
+    }
+}
+
+// returns how many define and set! forms in tree assign to name
+int countAssignments(Value *tree, char *name) {
+    if (tree->type != CONS_TYPE) {
+        return 0;
+    }
+    int count = (isSymbol(car(tree), "define") ||
+                 isSymbol(car(tree), "set!")) &&
+                cdr(tree)->type == CONS_TYPE && isSymbol(car(cdr(tree)), name);
+    while (tree->type == CONS_TYPE) {
+        count += countAssignments(car(tree), name);
+        tree = cdr(tree);
+    }
+    return count;
+}
+
+// returns the number of atoms in tree
+int formSize(Value *tree) {
+    int size = 0;
+    while (tree->type == CONS_TYPE) {
+        size += formSize(car(tree));
+        tree = cdr(tree);
+    }
+    return size + (tree->type != NULL_TYPE);
+}
+
+// returns whether evaluating expr can neither fail nor have an effect
+int isPure(Value *expr) {
+    nodeKind kind = analyze(expr)->kind;
+    return kind == CONST_NODE || kind == LAMBDA_NODE;
+}
+
+int isNumber(Value *value) {
+    return value->type == INT_TYPE || value->type == BIGNUM_TYPE ||
+           value->type == DOUBLE_TYPE;
+}
+
+// returns whether expr is a literal, setting *truth to its truth value
+int isConstantTest(Value *expr, int *truth) {
+    if (expr->type == INT_TYPE || expr->type == BIGNUM_TYPE ||
+        expr->type == DOUBLE_TYPE || expr->type == STR_TYPE ||
+        expr->type == CHAR_TYPE || expr->type == VECTOR_TYPE) {
+        *truth = 1;
+        return 1;
+    }
+    if (expr->type == BOOL_TYPE) {
+        *truth = expr->i != 0;
+        return 1;
+    }
+    return 0;
+}
+
+Foldable *findFoldable(char *name) {
+    for (int i = 0; i < sizeof(foldables) / sizeof(Foldable); i++) {
+        if (!strcmp(foldables[i].name, name)) {
+            return &foldables[i];
+        }
+    }
+    return NULL;
+}
+
+// returns the value of a call of a primitive on literal numbers, or NULL if
+// it cannot be folded
+Value *fold(Value *expr) {
+    Value *first = car(expr);
+    if (first->type != SYMBOL_TYPE || isMember(rebound, first->s)) {
+        return NULL;
+    }
+    Foldable *foldable = findFoldable(first->s);
+    int argc = formLength(cdr(expr));
+    if (foldable == NULL || argc < foldable->minArgs) {
+        return NULL;
+    }
+    Value **argv = talloc((argc + 1) * sizeof(Value *));
+    Value *args = cdr(expr);
+    for (int i = 0; i < argc; i++) {
+        argv[i] = car(args);
+        if (!isNumber(argv[i])) {
+            return NULL;
+        }
+        args = cdr(args);
+    }
+    if (foldable->function == primitiveMod ||
+        foldable->function == primitiveQuotient ||
+        foldable->function == primitiveRemainder) {
+        // anything but two fixnums could fail
+        if (argc != 2 || argv[0]->type != INT_TYPE ||
+            argv[1]->type != INT_TYPE || argv[1]->i == 0) {
+            return NULL;
+        }
+    }
+    if (foldable->function == primitiveAbs && argc != 1) {
+        return NULL;
+    }
+    return foldable->function(argc, argv);
+}
+
+Value *renameExpr(Value *expr, Value *env);
+
+// returns whether names is a proper list of distinct symbols that are not
+// keywords, which renaming cannot change the meaning of
+int renamable(Value *names) {
+    if (formLength(names) < 0) {
+        return 0;
+    }
+    for (; names->type == CONS_TYPE; names = cdr(names)) {
+        Value *name = car(names);
+        if (name->type != SYMBOL_TYPE || isKeyword(name->s) ||
+            isMember(cdr(names), name->s)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// returns the parameters of a lambda as a list; () parses as a list holding
+// an empty value
+Value *paramList(Value *params) {
+    if (params->type == CONS_TYPE && car(params)->type == NULL_TYPE) {
+        return cdr(params);
+    }
+    return params;
+}
+
+// binds each of names to a fresh symbol in env, and returns the fresh symbols
+Value *bindFresh(Value *names, Value **env) {
+    Value *fresh = makeNull();
+    for (; names->type == CONS_TYPE; names = cdr(names)) {
+        char *name = car(names)->s;
+        char *freshName = talloc(strlen(name) + 16);
+        sprintf(freshName, "%s#%i", name, ++freshNames);
+        Value *symbol = makeSymbol(freshName);
+        *env = cons(cons(car(names), symbol), *env);
+        fresh = cons(symbol, fresh);
+    }
+    return reverse(fresh);
+}
+
+// returns the symbol env renames symbol to, or NULL
+Value *lookupRename(Value *env, Value *symbol) {
+    for (; env->type == CONS_TYPE; env = cdr(env)) {
+        if (!strcmp(car(car(env))->s, symbol->s)) {
+            return cdr(car(env));
+        }
+    }
+    return NULL;
+}
+
+Value *renameList(Value *list, Value *env) {
+    Value *renamed = makeNull();
+    for (; list->type == CONS_TYPE; list = cdr(list)) {
+        renamed = cons(renameExpr(car(list), env), renamed);
+    }
+    return reverse(renamed);
+}
+
+// renames a let, let* or letrec
+Value *renameLet(Value *expr, Value *env) {
+    Value *bindings = car(cdr(expr));
+    Value *names = makeNull();
+    for (Value *b = bindings; b->type == CONS_TYPE; b = cdr(b)) {
+        if (formLength(car(b)) != 2) {
+            unsafe = 1;
+            return expr;
+        }
+        names = cons(car(car(b)), names);
+    }
+    names = reverse(names);
+    if (!renamable(names)) {
+        unsafe = 1;
+        return expr;
+    }
+    Value *inner = env;
+    Value *fresh = makeNull();
+    if (isSymbol(car(expr), "letrec")) {
+        fresh = bindFresh(names, &inner);
+    }
+    Value *renamed = makeNull();
+    for (Value *b = bindings; b->type == CONS_TYPE; b = cdr(b)) {
+        Value *init = car(cdr(car(b)));
+        Value *name;
+        if (isSymbol(car(expr), "letrec")) {
+            init = renameExpr(init, inner);
+            name = car(fresh);
+            fresh = cdr(fresh);
+        }
+        else {
+            // let* inits see the earlier bindings, let inits none of them
+            init = renameExpr(init, isSymbol(car(expr), "let*") ? inner : env);
+            name = car(bindFresh(cons(car(car(b)), makeNull()), &inner));
+        }
+        renamed = cons(cons(name, cons(init, makeNull())), renamed);
+    }
+    return cons(car(expr), cons(reverse(renamed),
+                                renameList(cdr(cdr(expr)), inner)));
+}
+
+// returns a copy of expr with every variable it binds renamed to a fresh
+// symbol, and the variables env maps renamed accordingly; sets unsafe when
+// the copy might not mean the same
+Value *renameExpr(Value *expr, Value *env) {
+    if (expr->type == SYMBOL_TYPE) {
+        Value *renamed = lookupRename(env, expr);
+        if (renamed != NULL) {
+            return renamed;
+        }
+        if (isMember(localNames, expr->s)) {
+            unsafe = 1;
+        }
+        return expr;
+    }
+    if (expr->type != CONS_TYPE || car(expr)->type == NULL_TYPE ||
+        isSymbol(car(expr), "quote")) {
+        return expr;
+    }
+    if (formLength(expr) < 0 || isSymbol(car(expr), "define") ||
+        isSymbol(car(expr), "guard")) {
+        unsafe = 1;
+        return expr;
+    }
+    Value *first = car(expr);
+    if (isSymbol(first, "lambda") || isSymbol(first, "let") ||
+        isSymbol(first, "let*") || isSymbol(first, "letrec")) {
+        if (formLength(expr) < 3) {
+            unsafe = 1;
+            return expr;
+        }
+        if (!isSymbol(first, "lambda")) {
+            return renameLet(expr, env);
+        }
+        Value *params = car(cdr(expr));
+        if (!renamable(paramList(params))) {
+            unsafe = 1;
+            return expr;
+        }
+        if (paramList(params)->type == CONS_TYPE) {
+            params = bindFresh(paramList(params), &env);
+        }
+        return cons(first, cons(params, renameList(cdr(cdr(expr)), env)));
+    }
+    return renameList(expr, env);
+}
+
+// remembers form if it defines a procedure that calls may be inlined from:
+// small, not recursive, and bound by nothing else in the whole program tree
+void addInlinable(Value *form, Value *tree) {
+    if (formLength(form) != 3 || !isSymbol(car(form), "define") ||
+        car(cdr(form))->type != SYMBOL_TYPE) {
+        return;
+    }
+    char *name = car(cdr(form))->s;
+    Value *lambda = car(cdr(cdr(form)));
+    if (formLength(lambda) != 3 || !isSymbol(car(lambda), "lambda") ||
+        isMember(localNames, name) || countAssignments(tree, name) != 1 ||
+        countSymbol(lambda, name) > 0 ||
+        formSize(car(cdr(cdr(lambda)))) > INLINE_BUDGET) {
+        return;
+    }
+    unsafe = 0;
+    renameExpr(lambda, makeNull());
+    if (!unsafe) {
+        inlinable = cons(form, inlinable);
+    }
+}
+
+// returns whether an argument can be substituted for a parameter instead of
+// being bound to it: evaluating it again, later, or not at all changes
+// nothing, which holds for literal numbers and booleans and for local
+// variables that are never assigned
+int isTrivial(Value *arg) {
+    if (arg->type == INT_TYPE || arg->type == DOUBLE_TYPE ||
+        arg->type == BOOL_TYPE) {
+        return 1;
+    }
+    return arg->type == SYMBOL_TYPE && isMember(scope, arg->s) &&
+           !isMember(assigned, arg->s);
+}
+
+// returns whether param, one of params, gets a trivial argument from args
+int hasTrivialArg(Value *param, Value *params, Value *args) {
+    for (; params->type == CONS_TYPE; params = cdr(params)) {
+        if (isSymbol(param, car(params)->s)) {
+            return isTrivial(car(args));
+        }
+        args = cdr(args);
+    }
+    return 0;
+}
+
+// returns whether all arguments can replace their parameters in body, even
+// those that are not trivial. This holds when body is a call of a primitive
+// that takes the parameters with non-trivial arguments directly, each once
+// and in order, and otherwise only literals and trivial parameters, so the
+// arguments are still evaluated in the same order with nothing in between
+// that could tell the difference.
+int substitutable(Value *body, Value *params, Value *args) {
+    if (body->type != CONS_TYPE || car(body)->type != SYMBOL_TYPE ||
+        isMember(rebound, car(body)->s) || findFoldable(car(body)->s) == NULL) {
+        return 0;
+    }
+    Value *pending = params;
+    Value *values = args;
+    for (Value *a = cdr(body); ; a = cdr(a)) {
+        while (pending->type == CONS_TYPE && isTrivial(car(values))) {
+            pending = cdr(pending);
+            values = cdr(values);
+        }
+        if (a->type != CONS_TYPE) {
+            break;
+        }
+        Value *arg = car(a);
+        if (pending->type == CONS_TYPE && isSymbol(arg, car(pending)->s) &&
+            countSymbol(body, arg->s) == 1) {
+            pending = cdr(pending);
+            values = cdr(values);
+        }
+        else if (!isNumber(arg) && arg->type != BOOL_TYPE &&
+                 !hasTrivialArg(arg, params, args)) {
+            return 0;
+        }
+    }
+    return pending->type == NULL_TYPE;
+}
+
+// returns expr, a call, with the procedure's body substituted for it, or
+// NULL if it cannot be inlined
+Value *inlineCall(Value *expr) {
+    if (car(expr)->type != SYMBOL_TYPE) {
+        return NULL;
+    }
+    for (Value *list = inlinable; list->type == CONS_TYPE; list = cdr(list)) {
+        Value *form = car(list);
+        if (strcmp(car(cdr(form))->s, car(expr)->s)) {
+            continue;
+        }
+        Value *lambda = car(cdr(cdr(form)));
+        Value *params = paramList(car(cdr(lambda)));
+        Value *body = car(cdr(cdr(lambda)));
+        if (formLength(params) != formLength(cdr(expr))) {
+            return NULL;
+        }
+        // trivial arguments replace their parameters; the others are bound
+        // by a let, so they are evaluated in order before the body as in a
+        // call
+        Value *env = makeNull();
+        Value *bindings = makeNull();
+        Value *args = cdr(expr);
+        int direct = substitutable(body, params, args);
+        for (; params->type == CONS_TYPE; params = cdr(params)) {
+            Value *arg = car(args);
+            if (direct || (isTrivial(arg) &&
+                           countAssignments(body, car(params)->s) == 0)) {
+                env = cons(cons(car(params), arg), env);
+            }
+            else {
+                Value *fresh = car(bindFresh(cons(car(params), makeNull()),
+                                             &env));
+                bindings = cons(cons(fresh, cons(arg, makeNull())), bindings);
+            }
+            args = cdr(args);
+        }
+        body = renameExpr(body, env);
+        if (bindings->type == NULL_TYPE) {
+            return body;
+        }
+        return cons(makeSymbol("let"),
+                    cons(reverse(bindings), cons(body, makeNull())));
+    }
+    return NULL;
+}
+
+// adds the symbols in names, a list of parameters or variables, to scope
+void bindLocals(Value *names) {
+    while (names->type == CONS_TYPE) {
+        addBinding(car(names), &scope);
+        names = cdr(names);
+    }
+    addBinding(names, &scope);
+}
+
+// returns the variables a list of let bindings binds
+Value *letNames(Value *bindings) {
+    Value *names = makeNull();
+    for (; bindings->type == CONS_TYPE; bindings = cdr(bindings)) {
+        if (car(bindings)->type == CONS_TYPE) {
+            names = cons(car(car(bindings)), names);
+        }
+    }
+    return names;
+}
+
+// optimizes each element of list in place
+void optimizeList(Value *list) {
+    while (list->type == CONS_TYPE) {
+        list->c.car = optimizeExpr(car(list));
+        list = cdr(list);
+    }
+}
+
+Value *optimizeIf(Value *expr) {
+    optimizeList(cdr(expr));
+    int truth;
+    if (formLength(expr) != 4 || !isConstantTest(car(cdr(expr)), &truth)) {
+        return expr;
+    }
+    Value *kept = car(cdr(cdr(expr)));
+    Value *dropped = car(cdr(cdr(cdr(expr))));
+    if (!truth) {
+        Value *swap = kept;
+        kept = dropped;
+        dropped = swap;
+    }
+    if (countSymbol(dropped, "define") > 0) {
+        return expr;
+    }
+    report("pruned", expr, kept);
+    return kept;
+}
+
+Value *optimizeCond(Value *expr) {
+    for (Value *c = cdr(expr); c->type == CONS_TYPE; c = cdr(c)) {
+        if (formLength(car(c)) > 0) {
+            optimizeList(car(c));
+        }
+    }
+    if (formLength(expr) < 2) {
+        return expr;
+    }
+    // rebuild the clauses, without those whose test is always false, and
+    // ending at the first whose test is always true
+    Value *clauses = makeNull();
+    int changed = 0;
+    for (Value *c = cdr(expr); c->type == CONS_TYPE; c = cdr(c)) {
+        Value *clause = car(c);
+        int truth;
+        int constant = formLength(clause) > 0 &&
+                       isConstantTest(car(clause), &truth) &&
+                       countSymbol(clause, "define") == 0;
+        if (constant && !truth &&
+            (clauses->type != NULL_TYPE || cdr(c)->type != NULL_TYPE)) {
+            changed = 1;
+            continue;
+        }
+        if (constant && truth && countSymbol(cdr(c), "define") == 0) {
+            Value *body = cdr(clause);
+            if (body->type == NULL_TYPE) {
+                body = cons(car(clause), body);
+            }
+            clauses = cons(cons(makeSymbol("else"), body), clauses);
+            changed = changed || cdr(c)->type != NULL_TYPE;
+            break;
+        }
+        clauses = cons(clause, clauses);
+    }
+    if (!changed) {
+        return expr;
+    }
+    clauses = reverse(clauses);
+    Value *result = cons(car(expr), clauses);
+    // a lone else clause with one expression is just that expression
+    Value *only = car(clauses);
+    if (cdr(clauses)->type == NULL_TYPE && isSymbol(car(only), "else") &&
+        formLength(only) == 2 && countSymbol(only, "define") == 0) {
+        result = car(cdr(only));
+    }
+    report("pruned", expr, result);
+    return result;
+}
+
+// optimizes a let or let*, then drops the bindings nothing refers to
+Value *optimizeLet(Value *expr) {
+    int sequential = isSymbol(car(expr), "let*");
+    Value *bindings = car(cdr(expr));
+    Value *body = cdr(cdr(expr));
+    Value *outer = scope;
+    for (Value *b = bindings; b->type == CONS_TYPE; b = cdr(b)) {
+        if (formLength(car(b)) == 2) {
+            optimizeList(cdr(car(b)));
+            if (sequential) {
+                addBinding(car(car(b)), &scope);
+            }
+        }
+    }
+    bindLocals(letNames(bindings));
+    optimizeList(body);
+    scope = outer;
+    if (formLength(bindings) < 1 || formLength(body) < 1) {
+        return expr;
+    }
+
+    Value *kept = makeNull();
+    int removed = 0;
+    for (Value *b = bindings; b->type == CONS_TYPE; b = cdr(b)) {
+        Value *binding = car(b);
+        if (formLength(binding) != 2 || car(binding)->type != SYMBOL_TYPE) {
+            return expr;
+        }
+        char *name = car(binding)->s;
+        int used = countSymbol(body, name) > 0 ||
+                   (sequential && countSymbol(cdr(b), name) > 0);
+        if (!used && isPure(car(cdr(binding)))) {
+            report("removed unused binding", binding, NULL);
+            removed++;
+        }
+        else {
+            kept = cons(binding, kept);
+        }
+    }
+    if (removed == 0) {
+        return expr;
+    }
+    if (kept->type == CONS_TYPE) {
+        return cons(car(expr), cons(reverse(kept), body));
+    }
+    // with no bindings left, a body of one expression needs no let at all
+    if (cdr(body)->type == NULL_TYPE && countSymbol(body, "define") == 0) {
+        return car(body);
+    }
+    return expr;
+}
+
+// returns an optimized version of expr, which may share structure with it
+Value *optimizeExpr(Value *expr) {
+    if (expr->type != CONS_TYPE || car(expr)->type == NULL_TYPE ||
+        formLength(expr) < 0) {
+        return expr;
+    }
+    Value *first = car(expr);
+    if (isSymbol(first, "quote")) {
+        return expr;
+    }
+    if (isSymbol(first, "lambda")) {
+        if (cdr(expr)->type == CONS_TYPE) {
+            Value *outer = scope;
+            bindLocals(paramList(car(cdr(expr))));
+            optimizeList(cdr(cdr(expr)));
+            scope = outer;
+        }
+        return expr;
+    }
+    if (isSymbol(first, "define") || isSymbol(first, "set!")) {
+        if (cdr(expr)->type == CONS_TYPE) {
+            optimizeList(cdr(cdr(expr)));
+        }
+        return expr;
+    }
+    if (isSymbol(first, "let") || isSymbol(first, "let*") ||
+        isSymbol(first, "letrec")) {
+        if (cdr(expr)->type != CONS_TYPE) {
+            return expr;
+        }
+        if (isSymbol(first, "letrec")) {
+            // the inits of a letrec may refer to any of its variables, so
+            // its bindings are left alone
+            for (Value *b = car(cdr(expr)); b->type == CONS_TYPE;
+                 b = cdr(b)) {
+                if (formLength(car(b)) == 2) {
+                    optimizeList(cdr(car(b)));
+                }
+            }
+            Value *outer = scope;
+            bindLocals(letNames(car(cdr(expr))));
+            optimizeList(cdr(cdr(expr)));
+            scope = outer;
+            return expr;
+        }
+        return optimizeLet(expr);
+    }
+    if (isSymbol(first, "guard")) {
+        // the clauses are left alone, as the variable they bind is not in
+        // scope
+        if (cdr(expr)->type == CONS_TYPE) {
+            optimizeList(cdr(cdr(expr)));
+        }
+        return expr;
+    }
+    if (isSymbol(first, "if")) {
+        return optimizeIf(expr);
+    }
+    if (isSymbol(first, "cond")) {
+        return optimizeCond(expr);
+    }
+    optimizeList(expr);
+    if (isSymbol(first, "begin") || isSymbol(first, "and") ||
+        isSymbol(first, "or")) {
+        return expr;
+    }
+    Value *inlined = inlineCall(expr);
+    if (inlined != NULL) {
+        report("inlined", expr, inlined);
+        // the body may fold now that it has the arguments
+        return optimizeExpr(inlined);
+    }
+    Value *folded = fold(expr);
+    if (folded != NULL) {
+        report("folded", expr, folded);
+        return folded;
+    }
+    return expr;
+}
+
+// Rewrites a parse tree into an equivalent, cheaper one: primitive calls on
+// literals are folded, branches that can never run are pruned, and unused
+// pure let bindings and unreferenced top-level definitions are removed. With
+// verbose set, each change is reported on stderr.
+Value *optimize(Value *tree, int verbose) {
+    reporting = verbose;
+    rebound = makeNull();
+    collectBindings(tree, 1, &rebound);
+    assigned = makeNull();
+    collectAssigned(tree);
+    scope = makeNull();
+    localNames = makeNull();
+    for (Value *list = tree; list->type == CONS_TYPE; list = cdr(list)) {
+        Value *form = car(list);
+        if (formLength(form) > 1 && isSymbol(car(form), "define")) {
+            form = cdr(cdr(form));
+        }
+        collectBindings(form, 0, &localNames);
+    }
+
+    // procedures become inlinable once defined, so only later calls inline
+    inlinable = makeNull();
+    for (Value *list = tree; list->type == CONS_TYPE; list = cdr(list)) {
+        list->c.car = optimizeExpr(car(list));
+        addInlinable(car(list), tree);
+    }
+
+    // a definition is unreferenced if its symbol occurs nowhere else
+    Value *forms = makeNull();
+    for (Value *list = tree; list->type == CONS_TYPE; list = cdr(list)) {
+        Value *form = car(list);
+        if (formLength(form) == 3 && isSymbol(car(form), "define") &&
+            car(cdr(form))->type == SYMBOL_TYPE &&
+            countSymbol(tree, car(cdr(form))->s) == 1 &&
+            isPure(car(cdr(cdr(form))))) {
+            report("removed unreferenced definition", form, NULL);
+            continue;
+        }
+        forms = cons(form, forms);
+    }
+    return reverse(forms);
+}
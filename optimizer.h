@@ -0,0 +1,16 @@
+#include "value.h"
+
+#ifndef _OPTIMIZER
+#define _OPTIMIZER
+
+// a procedure is inlined only if the body has at most this many atoms
+#define INLINE_BUDGET 24
+
+// Rewrites a parse tree into an equivalent, cheaper one: primitive calls on
+// literals are folded, small procedures are inlined, branches that can never
+// run are pruned, and unused pure let bindings and unreferenced top-level
+// definitions are removed. With verbose set, each change is reported on
+// stderr.
+Value *optimize(Value *tree, int verbose);
+
+#endif
@@ -1,14 +1,20 @@
 // Alex Walker, May 7, 2017
 
 #include <stdio.h>
+#include <string.h>
 #include "tokenizer.h"
 #include "value.h"
 #include "linkedlist.h"
 #include "talloc.h"
 #include "parser.h"
+#include "bignum.h"
+#include "text.h"
 
 // handles Errors in parser.c
 void handleParseError(int i) {
+    if (syntaxErrorJump != NULL) {
+        longjmp(*syntaxErrorJump, 1);
+    }
     if (i == 0) {
         printf("Syntax Error: error in stack.\n");
     }
@@ -19,7 +25,7 @@ void handleParseError(int i) {
         printf("Syntax Error: mismatched parentheses--too many '('.\n");
     }
     tfree();
-    exit(0);
+    exit(1);
 }
 
 // stack function, tells whether the stack is empty
@@ -66,10 +72,7 @@ Value *pop(Value *stack) {
 }
 
 Value *makeQuote() {
-    Value *quote = makeNull();
-    quote->type = SYMBOL_TYPE;
-    quote->s = "quote";
-    return quote;
+    return makeSymbol("quote");
 }
 
 Value *findQuotes(Value *tree) {
@@ -103,6 +106,24 @@ Value *findQuotes(Value *tree) {
     return tempTree;
 }
 
+// returns a vector of the items of a list of parse trees, the contents of a
+// #( ... ) literal
+Value *makeVectorLiteral(Value *items) {
+    items = findQuotes(items);
+    Value *vector = makeVector(length(items), NULL);
+    for (int i = 0; items->type == CONS_TYPE; i++) {
+        Value *item = car(items);
+        // () is parsed as a list holding a null
+        if (item->type == CONS_TYPE && car(item)->type == NULL_TYPE &&
+            cdr(item)->type == NULL_TYPE) {
+            item = car(item);
+        }
+        vector->vec.items[i] = item;
+        items = cdr(items);
+    }
+    return vector;
+}
+
 // Takes a list of tokens from a Racket program, and returns a pointer to a
 // parse tree representing that program.
 Value *parse(Value *tokens) {
@@ -138,7 +159,10 @@ Value *parse(Value *tokens) {
                 newParseTree = push(newParseTree, poppedToken);
                 poppedToken = pop(stack);
             }
-            if (empty(newParseTree)) {
+            if (!strcmp(poppedToken->s, "#(")) {
+                newParseTree = makeVectorLiteral(newParseTree);
+            }
+            else if (empty(newParseTree)) {
                 newParseTree = cons(makeNull(), newParseTree);
             }
             stack = push(stack, newParseTree);
@@ -160,6 +184,50 @@ Value *parse(Value *tokens) {
     return finalParseTree;
 }
 
+// returns the datum that starts with token, reading the rest of it from
+// port; the items of a list are read in a loop, and only nested lists
+// recurse
+Value *readDatumFrom(Port *port, Value *token) {
+    if (token->type == QUOTE_TYPE) {
+        Value *quoted = readDatum(port);
+        if (quoted == NULL) {
+            handleParseError(0);
+        }
+        return cons(makeQuote(), cons(quoted, makeNull()));
+    }
+    if (token->type == CLOSE_TYPE) {
+        handleParseError(1);
+    }
+    if (token->type != OPEN_TYPE) {
+        return token;
+    }
+    Value *items = makeNull();
+    Value **tail = &items;
+    Value *next = readToken(port);
+    while (next == NULL || next->type != CLOSE_TYPE) {
+        if (next == NULL) {
+            handleParseError(2);
+        }
+        *tail = cons(readDatumFrom(port, next), makeNull());
+        tail = &(*tail)->c.cdr;
+        next = readToken(port);
+    }
+    if (strcmp(token->s, "#(")) {
+        return items;
+    }
+    Value *vector = makeVector(length(items), NULL);
+    for (int i = 0; items->type == CONS_TYPE; i++) {
+        vector->vec.items[i] = car(items);
+        items = cdr(items);
+    }
+    return vector;
+}
+
+Value *readDatum(Port *port) {
+    Value *token = readToken(port);
+    return token == NULL ? NULL : readDatumFrom(port, token);
+}
+
 // Displays the value stored in a given token, provided
 // it's not a cons cell
 void displayValue(Value *value) {
@@ -167,13 +235,16 @@ void displayValue(Value *value) {
         handleParseError(0);
     }
     if (value->type == INT_TYPE) {
-        printf("%i", value->i);
+        printf("%li", value->i);
     }
     else if (value->type == DOUBLE_TYPE) {
         printf("%f", value->d);
     }
-    else if (value->type == STR_TYPE) {
-        printf("%s", value->s);
+    else if (value->type == BIGNUM_TYPE) {
+        printf("%s", integerToString(value));
+    }
+    else if (value->type == STR_TYPE || value->type == CHAR_TYPE) {
+        writeText(stdout, value);
     }
     else if (value->type == OPEN_TYPE) {
         printf("%s", value->s);
@@ -1,4 +1,5 @@
 #include "value.h"
+#include "tokenizer.h"
 
 #ifndef _PARSER
 #define _PARSER
@@ -7,6 +8,11 @@
 // parse tree representing that program.
 Value *parse(Value *tokens);
 
+// Reads the next datum from port, as read does, without reading any further,
+// or returns NULL at the end of the file. Unlike in a parse tree, () is the
+// empty list.
+Value *readDatum(Port *port);
+
 
 // Prints the tree to the screen in a readable fashion. It should look just like
 // Racket code; use parentheses to indicate subtrees.
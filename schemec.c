@@ -0,0 +1,634 @@
+// schemec: compiles a Scheme program, read from standard input, to a C
+// program written to standard output. The generated program links against
+// libscheme.a, the interpreter without its main(), and prints exactly what
+// the interpreter would:
+//     ./schemec < program.scm > program.c
+//     clang -I. program.c libscheme.a -o program
+// Each form is analyzed as the interpreter would analyze it. Every lambda
+// becomes a C function whose frame is laid out as the bytecode compiler lays
+// it out: lets get slots of the enclosing procedure's frame, a C array.
+// Closures copy the variables they capture, boxed if they are assigned.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <limits.h>
+#include "tokenizer.h"
+#include "parser.h"
+#include "linkedlist.h"
+#include "talloc.h"
+#include "analyzer.h"
+#include "bignum.h"
+#include "text.h"
+
+// A C function under construction, for a lambda or a top-level form.
+typedef struct Function {
+    FILE *out;
+    char *text;
+    size_t size;
+    int indent;
+    int isLambda;
+    int paramCount;
+    int frameSize;
+    int nextSlot;
+    struct Function *parent;
+} Function;
+
+// The slots, starting at offset, that hold the variables of one analyzer
+// scope in the frame of the function being compiled.
+typedef struct Region {
+    int offset;
+    struct Region *parent;
+} Region;
+
+// the parts of the output that are complete
+FILE *prototypes;
+FILE *functions;
+FILE *constants;
+
+int tempCount = 0;
+int lambdaCount = 0;
+int constCount = 0;
+
+// symbols of the global variables referred to; global i is the GLOBAL_NODE
+// gi of the generated program
+Value *globalNames;
+int globalCount = 0;
+
+char *compileExpr(Function *f, Region *region, Node *node, int tail);
+
+// writes one indented line of the body of f
+void line(Function *f, const char *format, ...) {
+    va_list args;
+    fprintf(f->out, "%*s", 4 * f->indent, "");
+    va_start(args, format);
+    vfprintf(f->out, format, args);
+    va_end(args);
+    fprintf(f->out, "\n");
+}
+
+// returns a string formatted like printf, allocated with talloc
+char *format(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int size = vsnprintf(NULL, 0, format, args) + 1;
+    va_end(args);
+    char *string = talloc(size);
+    va_start(args, format);
+    vsnprintf(string, size, format, args);
+    va_end(args);
+    return string;
+}
+
+// returns the name of a new temporary, declared by the caller
+char *newTemp() {
+    tempCount++;
+    return format("t%i", tempCount);
+}
+
+// writes a C string literal holding s
+void writeString(FILE *out, char *s) {
+    fprintf(out, "\"");
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') {
+            fprintf(out, "\\%c", *s);
+        }
+        else if (*s < ' ' || *s > '~') {
+            fprintf(out, "\\%03o", (unsigned char)*s);
+        }
+        else {
+            fprintf(out, "%c", *s);
+        }
+    }
+    fprintf(out, "\"");
+}
+
+// writes code building a copy of value into the constants, and returns the
+// name of the constant
+char *compileConst(Value *value) {
+    char *car = NULL;
+    char *cdr = NULL;
+    char **items = NULL;
+    if (value->type == CONS_TYPE) {
+        car = compileConst(value->c.car);
+        cdr = compileConst(value->c.cdr);
+    }
+    if (value->type == VECTOR_TYPE) {
+        items = talloc(value->vec.length * sizeof(char *));
+        for (int i = 0; i < value->vec.length; i++) {
+            items[i] = compileConst(value->vec.items[i]);
+        }
+    }
+    constCount++;
+    char *name = format("c%i", constCount);
+    fprintf(prototypes, "static Value *%s;\n", name);
+    if (value->type == CONS_TYPE) {
+        fprintf(constants, "    %s = cons(%s, %s);\n", name, car, cdr);
+        return name;
+    }
+    if (value->type == VECTOR_TYPE) {
+        fprintf(constants, "    %s = makeVector(%i, NULL);\n", name,
+                value->vec.length);
+        for (int i = 0; i < value->vec.length; i++) {
+            fprintf(constants, "    %s->vec.items[%i] = %s;\n", name, i,
+                    items[i]);
+        }
+        return name;
+    }
+    if (value->type == STR_TYPE) {
+        fprintf(constants, "    %s = makeString(", name);
+        writeString(constants, stringToC(value));
+        fprintf(constants, ");\n");
+        return name;
+    }
+    if (value->type == BIGNUM_TYPE) {
+        fprintf(constants, "    %s = parseInteger(\"%s\");\n", name,
+                integerToString(value));
+        return name;
+    }
+    fprintf(constants, "    %s = makeNull();\n", name);
+    fprintf(constants, "    %s->type = %i;\n", name, value->type);
+    switch (value->type) {
+     case INT_TYPE:
+     case CHAR_TYPE:
+     case BOOL_TYPE: {
+        if (value->i == LONG_MIN) {
+            // -9223372036854775808L would negate a literal too big for a long
+            fprintf(constants, "    %s->i = -%liL - 1;\n", name, LONG_MAX);
+            break;
+        }
+        fprintf(constants, "    %s->i = %liL;\n", name, value->i);
+        break;
+     }
+     case DOUBLE_TYPE: {
+        fprintf(constants, "    %s->d = %a;\n", name, value->d);
+        break;
+     }
+     case SYMBOL_TYPE: {
+        fprintf(constants, "    %s->s = intern(", name);
+        writeString(constants, value->s);
+        fprintf(constants, ");\n");
+        break;
+     }
+     default: {
+        break;
+     }
+    }
+    return name;
+}
+
+// returns the name of the GLOBAL_NODE standing for a global variable
+char *compileGlobal(Node *node) {
+    int index = 0;
+    for (Value *name = globalNames; name->type != NULL_TYPE;
+         name = cdr(name)) {
+        if (!strcmp(car(name)->s, node->var.symbol->s)) {
+            return format("g%i", globalCount - index);
+        }
+        index++;
+    }
+    globalCount++;
+    globalNames = cons(node->var.symbol, globalNames);
+    char *name = format("g%i", globalCount);
+    fprintf(prototypes, "static Node *%s;\n", name);
+    fprintf(constants, "    %s = makeGlobal(%s);\n", name,
+            compileConst(node->var.symbol));
+    return name;
+}
+
+// returns the C lvalue of the slot or free variable holding a local
+// variable, which is in a box if node->var.boxed
+char *slotOf(Region *region, Node *node) {
+    if (node->kind == FREE_NODE) {
+        return format("freeVars[%i]", node->var.index);
+    }
+    for (int i = 0; i < node->var.depth; i++) {
+        region = region->parent;
+    }
+    return format("slots[%i]", region->offset + node->var.index);
+}
+
+char *compileVariable(Function *f, Region *region, Node *node) {
+    char *temp = newTemp();
+    if (node->kind == GLOBAL_NODE) {
+        line(f, "Value *%s = binding(%s)->c.cdr;", temp, compileGlobal(node));
+        return temp;
+    }
+    line(f, "Value *%s = %s%s;", temp, slotOf(region, node),
+         node->var.boxed ? "->box" : "");
+    // parameters, and unboxed variables closures captured, always have a
+    // value
+    if (node->var.boxed || (node->kind == LOCAL_NODE &&
+                            (node->var.depth > 0 || region->offset > 0 ||
+                             node->var.index >= f->paramCount))) {
+        line(f, "if (%s == NULL) {", temp);
+        line(f, "    handleUnbound(%s);", compileConst(node->var.symbol));
+        line(f, "}");
+    }
+    return temp;
+}
+
+char *compileAssign(Function *f, Region *region, Node *node) {
+    char *value = compileExpr(f, region, node->assign.expr, 0);
+    Node *var = node->assign.var;
+    if (var->kind != GLOBAL_NODE) {
+        line(f, "%s%s = %s;", slotOf(region, var),
+             var->var.boxed ? "->box" : "", value);
+    }
+    else if (node->kind == DEFINE_NODE) {
+        line(f, "defineGlobal(%s, %s, globalFrame);", compileGlobal(var),
+             value);
+    }
+    else {
+        char *global = compileGlobal(var);
+        line(f, "if (resolveGlobal(%s, globalFrame) == NULL) {", global);
+        line(f, "    handleInterpError(172);");
+        line(f, "}");
+        line(f, "%s->var.binding->c.cdr = %s;", global, value);
+    }
+    return "voidValue";
+}
+
+char *compileIf(Function *f, Region *region, Node *node, int tail) {
+    char *test = compileExpr(f, region, node->branch.test, 0);
+    char *temp = newTemp();
+    line(f, "Value *%s;", temp);
+    line(f, "if (!IS_FALSE(%s)) {", test);
+    f->indent++;
+    line(f, "%s = %s;", temp,
+         compileExpr(f, region, node->branch.conseq, tail));
+    f->indent--;
+    line(f, "}");
+    line(f, "else {");
+    f->indent++;
+    line(f, "%s = %s;", temp,
+         compileExpr(f, region, node->branch.alt, tail));
+    f->indent--;
+    line(f, "}");
+    return temp;
+}
+
+// starts a function with a frame of size slots, the first paramCount of
+// them being its parameters
+Function *makeFunction(Function *parent, int isLambda, int paramCount,
+                       int size) {
+    Function *f = talloc(sizeof(Function));
+    f->out = open_memstream(&f->text, &f->size);
+    f->indent = 1;
+    f->isLambda = isLambda;
+    f->paramCount = paramCount;
+    f->frameSize = size;
+    f->nextSlot = 0;
+    f->parent = parent;
+    return f;
+}
+
+// writes out f, now that its body has been compiled, as a function with
+// the given header returning result
+void finishFunction(Function *f, char *header, char *result) {
+    fclose(f->out);
+    fprintf(prototypes, "static %s;\n", header);
+    fprintf(functions, "static %s {\n", header);
+    if (f->isLambda) {
+        fprintf(functions, "    if (argc != %i) {\n", f->paramCount);
+        fprintf(functions, "        handleInterpError(%i);\n",
+                f->paramCount ? 5 : 6);
+        fprintf(functions, "    }\n");
+        fprintf(functions, "    Value **freeVars = self->cl.freeVars;\n");
+        fprintf(functions, "    checkStack();\n");
+    }
+    if (f->frameSize > 0) {
+        fprintf(functions, "    Value *slots[%i];\n", f->frameSize);
+    }
+    for (int i = 0; i < f->frameSize; i++) {
+        if (i < f->paramCount) {
+            fprintf(functions, "    slots[%i] = argv[%i];\n", i, i);
+        }
+        else {
+            fprintf(functions, "    slots[%i] = NULL;\n", i);
+        }
+    }
+    fwrite(f->text, 1, f->size, functions);
+    fprintf(functions, "    return %s;\n}\n\n", result);
+    free(f->text);
+}
+
+// puts the slots, from offset on, that boxed flags in new boxes
+void compileBoxes(Function *f, char *boxed, int offset, int size) {
+    for (int i = 0; boxed != NULL && i < size; i++) {
+        if (boxed[i]) {
+            line(f, "slots[%i] = makeBox(slots[%i]);", offset + i,
+                 offset + i);
+        }
+    }
+}
+
+char *compileLambda(Function *f, Region *region, Node *node) {
+    Node *body = node->lambda.body;
+    Function *inner = makeFunction(f, 1, node->lambda.paramCount,
+                                   node->lambda.frameSize + countSlots(body));
+    inner->nextSlot = node->lambda.frameSize;
+    Region *newRegion = talloc(sizeof(Region));
+    newRegion->offset = 0;
+    newRegion->parent = NULL;
+
+    lambdaCount++;
+    int index = lambdaCount;
+    compileBoxes(inner, node->lambda.boxed, 0, node->lambda.frameSize);
+    char *result = compileExpr(inner, newRegion, body, 1);
+    finishFunction(inner, format("Value *lambda%i(Value *self, int argc, "
+                                 "Value **argv)", index), result);
+
+    char *temp = newTemp();
+    line(f, "Value *%s = makeCompiledClosure(lambda%i, %i);", temp, index,
+         node->lambda.freeCount);
+    for (int i = 0; i < node->lambda.freeCount; i++) {
+        line(f, "%s->cl.freeVars[%i] = %s;", temp, i,
+             slotOf(region, node->lambda.freeVars[i]));
+    }
+    return temp;
+}
+
+char *compileLet(Function *f, Region *region, Node *node, int tail) {
+    Region *newRegion = talloc(sizeof(Region));
+    newRegion->offset = f->nextSlot;
+    newRegion->parent = region;
+    f->nextSlot += node->let.frameSize;
+
+    compileBoxes(f, node->let.boxed, newRegion->offset, node->let.frameSize);
+    Region *initRegion = node->kind == LET_NODE ? region : newRegion;
+    for (int i = 0; i < node->let.count; i++) {
+        char *value = compileExpr(f, initRegion, node->let.inits[i], 0);
+        int boxed = node->let.boxed != NULL && node->let.boxed[i];
+        line(f, "slots[%i]%s = %s;", newRegion->offset + i,
+             boxed ? "->box" : "", value);
+    }
+    return compileExpr(f, newRegion, node->let.body, tail);
+}
+
+char *compileBegin(Function *f, Region *region, Node *node, int tail) {
+    char *result = "voidValue";
+    for (int i = 0; i < node->seq.count; i++) {
+        result = compileExpr(f, region, node->seq.exprs[i],
+                             tail && i == node->seq.count - 1);
+    }
+    return result;
+}
+
+// compiles and/or as a chain of nested ifs, each testing the value of the
+// operand before it
+char *compileLogical(Function *f, Region *region, Node *node, int tail) {
+    int isAnd = node->kind == AND_NODE;
+    if (node->seq.count == 0) {
+        return isAnd ? "trueValue" : "falseValue";
+    }
+    char *temp = newTemp();
+    line(f, "Value *%s = %s;", temp,
+         compileExpr(f, region, node->seq.exprs[0],
+                     tail && node->seq.count == 1));
+    for (int i = 1; i < node->seq.count; i++) {
+        line(f, isAnd ? "if (!IS_FALSE(%s)) {" : "if (IS_FALSE(%s)) {",
+             temp);
+        f->indent++;
+        line(f, "%s = %s;", temp,
+             compileExpr(f, region, node->seq.exprs[i],
+                         tail && i == node->seq.count - 1));
+    }
+    for (int i = 1; i < node->seq.count; i++) {
+        f->indent--;
+        line(f, "}");
+    }
+    return temp;
+}
+
+char *compileCond(Function *f, Region *region, Node *node, int tail) {
+    char *temp = newTemp();
+    line(f, "Value *%s = voidValue;", temp);
+    int depth = 0;
+    for (int i = 0; i < node->cond.count; i++) {
+        if (node->cond.tests[i] == NULL) {
+            line(f, "%s = %s;", temp,
+                 compileExpr(f, region, node->cond.bodies[i], tail));
+            break;
+        }
+        char *test = compileExpr(f, region, node->cond.tests[i], 0);
+        line(f, "if (!IS_FALSE(%s)) {", test);
+        f->indent++;
+        if (node->cond.bodies[i] == NULL) {
+            line(f, "%s = %s;", temp, test);
+        }
+        else {
+            line(f, "%s = %s;", temp,
+                 compileExpr(f, region, node->cond.bodies[i], tail));
+        }
+        f->indent--;
+        line(f, "}");
+        line(f, "else {");
+        f->indent++;
+        depth++;
+    }
+    for (int i = 0; i < depth; i++) {
+        f->indent--;
+        line(f, "}");
+    }
+    return temp;
+}
+
+// a call in tail position is handed to tailCall, to be made once the
+// function has returned its value
+char *compileCall(Function *f, Region *region, Node *node, int tail) {
+    char *function = compileExpr(f, region, node->call.fn, 0);
+    int argc = node->call.argc;
+    char **args = talloc((argc + 1) * sizeof(char *));
+    for (int i = 0; i < argc; i++) {
+        args[i] = compileExpr(f, region, node->call.args[i], 0);
+    }
+    char *argv = newTemp();
+    if (argc == 0) {
+        line(f, "Value **%s = NULL;", argv);
+    }
+    else {
+        fprintf(f->out, "%*sValue *%s[%i] = {", 4 * f->indent, "", argv,
+                argc);
+        for (int i = 0; i < argc; i++) {
+            fprintf(f->out, i ? ", %s" : "%s", args[i]);
+        }
+        fprintf(f->out, "};\n");
+    }
+    char *temp = newTemp();
+    line(f, "Value *%s = %s(%s, %i, %s);", temp, tail ? "tailCall" : "apply",
+         function, argc, argv);
+    return temp;
+}
+
+// writes the code evaluating node into f and returns the C expression, a
+// temporary or constant, that holds its value afterwards; tail is set if
+// that is the value the function returns
+char *compileExpr(Function *f, Region *region, Node *node, int tail) {
+    switch (node->kind) {
+     case CONST_NODE: {
+        return compileConst(node->value);
+     }
+     case LOCAL_NODE:
+     case FREE_NODE:
+     case GLOBAL_NODE: {
+        return compileVariable(f, region, node);
+     }
+     case DEFINE_NODE:
+     case SET_NODE: {
+        return compileAssign(f, region, node);
+     }
+     case IF_NODE: {
+        return compileIf(f, region, node, tail);
+     }
+     case LAMBDA_NODE: {
+        return compileLambda(f, region, node);
+     }
+     case LET_NODE:
+     case LETSTAR_NODE:
+     case LETREC_NODE: {
+        return compileLet(f, region, node, tail);
+     }
+     case BEGIN_NODE: {
+        return compileBegin(f, region, node, tail);
+     }
+     case AND_NODE:
+     case OR_NODE: {
+        return compileLogical(f, region, node, tail);
+     }
+     case COND_NODE: {
+        return compileCond(f, region, node, tail);
+     }
+     case CALL_NODE:
+     case FIXNUM_CALL_NODE:
+     case FLONUM_CALL_NODE:
+     case NUMERIC_CALL_NODE: {
+        return compileCall(f, region, node, tail);
+     }
+     default: {
+        line(f, "handleInterpError(%i);", node->error);
+        return "voidValue";
+     }
+    }
+}
+
+// the start of every generated program; its names are static so that they
+// cannot clash with the runtime's
+const char *prelude =
+    "// generated by schemec\n"
+    "\n"
+    "#include <stdio.h>\n"
+    "#include \"interpreter.h\"\n"
+    "#include \"linkedlist.h\"\n"
+    "#include \"talloc.h\"\n"
+    "#include \"bignum.h\"\n"
+    "#include \"hashtable.h\"\n"
+    "#include \"text.h\"\n"
+    "\n"
+    "#define IS_FALSE(value) ((value)->type == BOOL_TYPE && !(value)->i)\n"
+    "\n"
+    "static Frame *globalFrame;\n"
+    "static Value *voidValue;\n"
+    "static Value *trueValue;\n"
+    "static Value *falseValue;\n"
+    "\n"
+    "static Node *makeGlobal(Value *symbol) {\n"
+    "    Node *node = talloc(sizeof(Node));\n"
+    "    node->kind = GLOBAL_NODE;\n"
+    "    node->var.symbol = symbol;\n"
+    "    node->var.binding = NULL;\n"
+    "    return node;\n"
+    "}\n"
+    "\n"
+    "static Value *binding(Node *var) {\n"
+    "    if (var->var.binding == NULL &&\n"
+    "        resolveGlobal(var, globalFrame) == NULL) {\n"
+    "        handleUnbound(var->var.symbol);\n"
+    "    }\n"
+    "    return var->var.binding;\n"
+    "}\n"
+    "\n"
+    "static Value *makeCompiledClosure(Value *(*code)(Value *, int,\n"
+    "                                                 Value **),\n"
+    "                                  int freeCount) {\n"
+    "    Value *value = makeNull();\n"
+    "    value->type = CLOSURE_TYPE;\n"
+    "    value->cl.lambda = NULL;\n"
+    "    value->cl.frame = globalFrame;\n"
+    "    value->cl.freeVars = talloc(freeCount * sizeof(Value *));\n"
+    "    value->cl.code = NULL;\n"
+    "    value->cl.compiled = code;\n"
+    "    return value;\n"
+    "}\n"
+    "\n";
+
+int main() {
+    Value *list = tokenize(stdin);
+    Value *tree = parse(list);
+    globalNames = makeNull();
+
+    char *prototypesText;
+    char *functionsText;
+    char *constantsText;
+    size_t prototypesSize;
+    size_t functionsSize;
+    size_t constantsSize;
+    prototypes = open_memstream(&prototypesText, &prototypesSize);
+    functions = open_memstream(&functionsText, &functionsSize);
+    constants = open_memstream(&constantsText, &constantsSize);
+
+    // each top-level form becomes a function form<i>
+    int formCount = 0;
+    for (; tree->type != NULL_TYPE; tree = cdr(tree)) {
+        Node *node = analyze(car(tree));
+        Function *f = makeFunction(NULL, 0, 0, countSlots(node));
+        char *result = compileExpr(f, NULL, node, 0);
+        formCount++;
+        finishFunction(f, format("Value *form%i(void *data)", formCount), result);
+    }
+
+    fclose(prototypes);
+    fclose(functions);
+    fclose(constants);
+    printf("%s", prelude);
+    fwrite(prototypesText, 1, prototypesSize, stdout);
+    printf("\n");
+    fwrite(functionsText, 1, functionsSize, stdout);
+    printf("static void initConstants() {\n");
+    fwrite(constantsText, 1, constantsSize, stdout);
+    printf("}\n\n");
+    printf("static void runForms() {\n");
+    printf("    Value *(*forms[])(void *) = {");
+    for (int i = 1; i <= formCount; i++) {
+        printf(i > 1 ? ", form%i" : "form%i", i);
+    }
+    printf("%s};\n", formCount ? "" : "NULL");
+    printf("    for (int i = 0; i < %i; i++) {\n", formCount);
+    printf("        Value *val = runTopLevel(forms[i], NULL);\n");
+    printf("        if (val == NULL) {\n");
+    printf("            continue;\n");
+    printf("        }\n");
+    printf("        printVal(val);\n");
+    printf("        if (val->type != VOID_TYPE) {\n");
+    printf("            printf(\"\\n\");\n");
+    printf("        }\n");
+    printf("    }\n");
+    printf("}\n\n");
+    printf("int main() {\n");
+    printf("    globalFrame = makeGlobalFrame();\n");
+    printf("    voidValue = makeVoid();\n");
+    printf("    trueValue = makeTrue();\n");
+    printf("    falseValue = makeFalse();\n");
+    printf("    initConstants();\n");
+    printf("    runDeep(runForms);\n");
+    printf("    tfree();\n");
+    printf("    return uncaughtErrors > 0;\n");
+    printf("}\n");
+
+    free(prototypesText);
+    free(functionsText);
+    free(constantsText);
+    tfree();
+    return 0;
+}
@@ -15,6 +15,16 @@ typedef struct Cell Cell;
 
 Cell *tlist;
 
+// allocations are carved out of chunks of this many bytes, so that most
+// calls to talloc cost a pointer bump rather than two mallocs
+#define CHUNK_SIZE (1 << 20)
+
+// every allocation is aligned like malloc's
+#define ALIGNMENT 16
+
+char *freeSpace;
+char *chunkEnd;
+
 /* Replacement for malloc that stores the pointers allocated. 
  * It should store the pointers in some kind of list; 
  * a linked list would do fine, but insert here whatever code
@@ -22,23 +32,34 @@ Cell *tlist;
  * linkedlist.h. Otherwise you'll end up with circular
  * dependencies, since you're going to modify the linked list 
  * to use talloc.
+ * The list holds whole chunks; objects too big to share a chunk get one of
+ * their own.
  */
+void *chunk(size_t size){
+    Cell *temp = tlist;
+    tlist = malloc(sizeof(Cell));
+    tlist->type = CONS_TYPE;
+    tlist->car = malloc(size);
+    tlist->cdr = temp;
+    if(!(tlist->car)){
+        printf("Out of memory\n");
+        texit(1);
+    }
+    return tlist->car;
+}
+
 void *talloc(size_t size){
-    if(!(tlist)){
-        tlist = malloc(sizeof(Cell));
-        tlist->type = CONS_TYPE;
-        tlist->car = malloc(size);
-        tlist->cdr = malloc(sizeof(Cell));
-        tlist->cdr->type = NULL_TYPE;
+    size = (size + ALIGNMENT - 1) & ~(size_t)(ALIGNMENT - 1);
+    if(size > CHUNK_SIZE / 4){
+        return chunk(size);
     }
-    else{
-        Cell *temp = tlist;
-        tlist = malloc(sizeof(Cell));
-        tlist->type = CONS_TYPE;
-        tlist->car = malloc(size);
-        tlist->cdr = temp;
+    if(!(freeSpace) || (size_t)(chunkEnd - freeSpace) < size){
+        freeSpace = chunk(CHUNK_SIZE);
+        chunkEnd = freeSpace + CHUNK_SIZE;
     }
-    return tlist->car;
+    void *pointer = freeSpace;
+    freeSpace += size;
+    return pointer;
 }
 
 /* Frees up all memory directly or indirectly referred to by list.
@@ -46,18 +67,13 @@ void *talloc(size_t size){
  * so you'll need to clean them up as well.
  */
 void cleanup(Cell *list){
-    if(!(list)){
-        return;
-    }
-    if(list->type != CONS_TYPE){
-        free(list);
-        return;
-    }
-    else{
+    // iterative, since long runs allocate far more cells than the C stack
+    // could hold frames for
+    while(list){
+        Cell *rest = list->cdr;
         free(list->car);
-        cleanup(list->cdr);
         free(list);
-        return;
+        list = rest;
     }
 }
 
@@ -67,6 +83,8 @@ void cleanup(Cell *list){
 void tfree(){
     cleanup(tlist);
     tlist = NULL;
+    freeSpace = NULL;
+    chunkEnd = NULL;
 }
 
 /* Replacement for the C function "exit", that consists
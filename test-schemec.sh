@@ -0,0 +1,23 @@
+#!/bin/bash
+
+# compiles every test with schemec and reports where the compiled program's
+# output differs from the interpreter's, running one at a time since some
+# tests write files; needs make schemec first
+CC=${CC:-clang}
+dir=$(mktemp -d)
+status=0
+for input in interpreter-test.input.*; do
+    ./schemec < $input > $dir/program.c
+    if ! $CC -I. $dir/program.c libscheme.a -lm -o $dir/program; then
+        echo "schemec output for $input does not compile"
+        status=1
+        continue
+    fi
+    ./interpreter < $input > $dir/expected
+    if ! $dir/program < $input | diff $dir/expected - > /dev/null; then
+        echo "compiled $input differs"
+        status=1
+    fi
+done
+rm -r $dir
+exit $status
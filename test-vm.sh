@@ -0,0 +1,29 @@
+#!/bin/bash
+
+# runs every test on the bytecode VM, with the JIT turned off and through the
+# optimizer, and reports where the output differs from the tree-walking
+# evaluator's; the runs go one at a time, since some tests write files
+status=0
+expected=$(mktemp)
+for input in interpreter-test.input.*; do
+    ./interpreter < $input > $expected
+    for mode in "--vm" "--no-jit" "--vm --no-jit" "--optimize" "--vm --optimize"; do
+        if ! ./interpreter $mode < $input | diff $expected - > /dev/null; then
+            echo "./interpreter $mode differs on $input"
+            status=1
+        fi
+    done
+done
+# the deep recursions of test 49 must also stop at a small --max-depth in
+# every mode, including where the VM calls back into itself through C
+input=interpreter-test.input.49
+./interpreter --max-depth 5000 < $input > $expected
+for mode in "--vm" "--no-jit" "--vm --no-jit" "--optimize" "--vm --optimize"; do
+    if ! ./interpreter $mode --max-depth 5000 < $input |
+            diff $expected - > /dev/null; then
+        echo "./interpreter $mode --max-depth 5000 differs on $input"
+        status=1
+    fi
+done
+rm $expected
+exit $status
@@ -0,0 +1,145 @@
+// Scheme strings: length-prefixed text that substrings share, and ropes
+// that make appending to a long string take constant time.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "text.h"
+#include "linkedlist.h"
+#include "talloc.h"
+
+Value *makeText(char *chars, long length) {
+    Value *value = makeNull();
+    value->type = STR_TYPE;
+    value->str.chars = chars;
+    value->str.length = length;
+    value->str.left = NULL;
+    value->str.right = NULL;
+    return value;
+}
+
+Value *makeString(char *text) {
+    return makeText(text, strlen(text));
+}
+
+// returns a rope of the strings left and right, whose characters are not
+// copied until they are needed
+Value *makeRope(Value *left, Value *right) {
+    Value *value = makeText(NULL, left->str.length + right->str.length);
+    value->str.left = left;
+    value->str.right = right;
+    return value;
+}
+
+// copies the characters of the rope into one buffer, walking its tree with
+// a stack of its own, since appending in a loop makes it as deep as it is
+// long
+void flatten(Value *rope) {
+    char *chars = talloc(rope->str.length);
+    long position = 0;
+    int capacity = 64;
+    int depth = 0;
+    Value **pending = malloc(capacity * sizeof(Value *));
+    pending[depth++] = rope;
+    while (depth > 0) {
+        Value *part = pending[--depth];
+        if (part->str.left == NULL) {
+            memcpy(chars + position, part->str.chars, part->str.length);
+            position += part->str.length;
+            continue;
+        }
+        if (depth + 2 > capacity) {
+            capacity *= 2;
+            pending = realloc(pending, capacity * sizeof(Value *));
+        }
+        pending[depth++] = part->str.right;
+        pending[depth++] = part->str.left;
+    }
+    free(pending);
+    rope->str.chars = chars;
+    rope->str.left = NULL;
+    rope->str.right = NULL;
+}
+
+char *stringChars(Value *string) {
+    if (string->str.left != NULL) {
+        flatten(string);
+    }
+    return string->str.chars;
+}
+
+char *stringToC(Value *string) {
+    char *text = talloc(string->str.length + 1);
+    memcpy(text, stringChars(string), string->str.length);
+    text[string->str.length] = '\0';
+    return text;
+}
+
+Value *stringAppend(int count, Value **strings) {
+    long length = 0;
+    for (int i = 0; i < count; i++) {
+        length += strings[i]->str.length;
+    }
+    if (length >= ROPE_THRESHOLD && count > 0) {
+        Value *rope = strings[0];
+        for (int i = 1; i < count; i++) {
+            if (strings[i]->str.length > 0) {
+                rope = rope->str.length > 0 ? makeRope(rope, strings[i])
+                                            : strings[i];
+            }
+        }
+        return rope;
+    }
+    char *chars = talloc(length);
+    long position = 0;
+    for (int i = 0; i < count; i++) {
+        memcpy(chars + position, stringChars(strings[i]),
+               strings[i]->str.length);
+        position += strings[i]->str.length;
+    }
+    return makeText(chars, length);
+}
+
+Value *substring(Value *string, long start, long end) {
+    return makeText(stringChars(string) + start, end - start);
+}
+
+int stringCompare(Value *a, Value *b) {
+    long length = a->str.length < b->str.length ? a->str.length
+                                                : b->str.length;
+    int order = memcmp(stringChars(a), stringChars(b), length);
+    if (order != 0) {
+        return order;
+    }
+    return (a->str.length > b->str.length) - (a->str.length < b->str.length);
+}
+
+// the characters that #\ spells by name
+char *charNames[] = {"space", "newline", "tab"};
+char namedChars[] = {' ', '\n', '\t'};
+
+void writeText(FILE *out, Value *value) {
+    if (value->type == STR_TYPE) {
+        fprintf(out, "\"%.*s\"", (int)value->str.length, stringChars(value));
+        return;
+    }
+    for (int i = 0; i < sizeof(namedChars); i++) {
+        if (value->i == namedChars[i]) {
+            fprintf(out, "#\\%s", charNames[i]);
+            return;
+        }
+    }
+    fprintf(out, "#\\%c", (int)value->i);
+}
+
+int namedChar(char *name) {
+    if (strlen(name) == 1) {
+        return (unsigned char)name[0];
+    }
+    for (int i = 0; i < sizeof(namedChars); i++) {
+        if (!strcmp(name, charNames[i])) {
+            return namedChars[i];
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,46 @@
+#include <stdio.h>
+#include "value.h"
+
+#ifndef _TEXT
+#define _TEXT
+
+// strings appended to one at least this long are joined lazily, as ropes
+#define ROPE_THRESHOLD 64
+
+// Strings are immutable, so a substring can always share the characters of
+// the string it is taken from, and those are not NUL-terminated. A rope, the
+// result of appending long strings, has NULL chars until something needs
+// them, and its two halves in left and right; it is then flattened once, in
+// time linear in its length.
+
+// Returns a new STR_TYPE value of the length characters at chars, which it
+// shares.
+Value *makeText(char *chars, long length);
+
+// Returns a new STR_TYPE value of the NUL-terminated text, which it shares.
+Value *makeString(char *text);
+
+// Returns the characters of string, flattening it if it is a rope.
+char *stringChars(Value *string);
+
+// Returns string as a NUL-terminated C string.
+char *stringToC(Value *string);
+
+// Returns the concatenation of the count strings.
+Value *stringAppend(int count, Value **strings);
+
+// Returns the characters of string from start up to end, sharing them.
+Value *substring(Value *string, long start, long end);
+
+// Returns a negative number, zero or a positive number as a sorts before,
+// the same as or after b.
+int stringCompare(Value *a, Value *b);
+
+// Writes a string or character as Scheme source would spell it.
+void writeText(FILE *out, Value *value);
+
+// Returns the character that follows #\ in name, such as a or space, or -1
+// if there is none.
+int namedChar(char *name);
+
+#endif
@@ -4,30 +4,53 @@
 #include "tokenizer.h"
 #include "talloc.h"
 #include "linkedlist.h"
+#include "bignum.h"
+#include "hashtable.h"
+#include "text.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <errno.h>
 
 char *init = "!$%&*/:<=>?~_^";
 char *subs = "!$%&*/:<=>?~_^0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ.+-";
 char *lett = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
 char *digi = "0123456789";
 
-// adds a character to a string using strcat
-void addCharToStr(char *string, char c) {
-    char charStr[2] = {c, '\0'};
-    strcat(string, charStr);
+// the bytes a port's token buffer starts out with
+#define TOKEN_CAPACITY 64
+
+// adds a character to the token being read from port, doubling its buffer
+// when it is full
+void addCharToToken(Port *port, char c) {
+    if (port->length + 1 == port->capacity) {
+        char *text = talloc(2 * port->capacity);
+        memcpy(text, port->text, port->length);
+        port->text = text;
+        port->capacity *= 2;
+    }
+    port->text[port->length++] = c;
+    port->text[port->length] = '\0';
 }
 
-// prints an error message then exits
+jmp_buf *syntaxErrorJump = NULL;
+
+// prints an error message then exits, or jumps to syntaxErrorJump if it is
+// set
 void handleError(int i) {
+    if (syntaxErrorJump != NULL) {
+        longjmp(*syntaxErrorJump, 1);
+    }
     if (i == CONS_TYPE) {
         printf("Problem with linked list.\n");
     } else {
         printf("Syntax error: untokenizable.\n");
     }
+    if (i == CHAR_TYPE) {
+        printf("Error in tokenizing character.\n");
+    }
     if (i == STR_TYPE) {
         printf("Error in tokenizing string.\n");
     }
@@ -47,32 +70,41 @@ void handleError(int i) {
         printf("Error in tokenizing number.\n");
     }
     tfree();
-    exit(0);
+    exit(1);
 }
 
-// Read all of the input from stdin, and return a linked list consisting of the
-// tokens.
-Value *tokenize() {
-    int canStartNewToken = 1; // this is just a boolean
-    char charRead;
-    Value *list = makeNull();
-    charRead = fgetc(stdin);
+Port *makePort(FILE *file) {
+    Port *port = talloc(sizeof(Port));
+    port->file = file;
+    port->next = fgetc(file);
+    port->canStartNewToken = 1;
+    port->text = talloc(TOKEN_CAPACITY);
+    port->length = 0;
+    port->capacity = TOKEN_CAPACITY;
+    return port;
+}
+
+Value *readToken(Port *port) {
+    int canStartNewToken = port->canStartNewToken; // this is just a boolean
+    int charRead = port->next;
+    FILE *in = port->file;
+    Value *token = NULL;
 
     // while loop that builds 1 token until end of file
-    while (charRead != EOF) {
+    while (token == NULL && charRead != EOF) {
         
         // skip over whitespace and newline chars
-        if (charRead == ' ' || charRead == '\n') {
+        if (charRead == ' ' || charRead == '\n' || charRead == '\t' ||
+            charRead == '\r') {
             canStartNewToken = 1;
-            charRead = fgetc(stdin);
+            charRead = fgetc(in);
         }
         else {           
-            //sets up a new node holding a string for the token
+            //sets up a new node for the token, whose text is built in the
+            //port's buffer and copied once it is complete
             Value *newNode = makeNull();
-            newNode->s = talloc(1000 * sizeof(char));
-            for (int i = 0; i < 999; i++) {
-                newNode->s[i] = '\0';
-            }
+            port->length = 0;
+            port->text[0] = '\0';
             
             // accounts for ' case
             char readString[2];
@@ -81,28 +113,50 @@ Value *tokenize() {
             if (!strcmp(readString, "'")) {
                 canStartNewToken = 1;
                 newNode->type = QUOTE_TYPE;
-                addCharToStr(newNode->s, charRead);
-                charRead = fgetc(stdin);
+                addCharToToken(port, charRead);
+                charRead = fgetc(in);
             }
         
-            // accounts for boolean case
+            // accounts for boolean case, characters, and the #( opening a
+            // vector
             else if (charRead == '#' && canStartNewToken) {
                 newNode->type = BOOL_TYPE;           
-                charRead = fgetc(stdin);
+                charRead = fgetc(in);
+                canStartNewToken = 0;
                 
-                if (charRead == 't'){
+                if (charRead == '(') {
+                    newNode->type = OPEN_TYPE;
+                    addCharToToken(port, '#');
+                    addCharToToken(port, charRead);
+                    charRead = fgetc(in);
+                    canStartNewToken = 1;
+                }
+                else if (charRead == '\\') {
+                    newNode->type = CHAR_TYPE;
+                    int first = fgetc(in);
+                    addCharToToken(port, first);
+                    charRead = fgetc(in);
+                    // names such as space are letters after the first
+                    while (isalpha(first) && isalpha(charRead)) {
+                        addCharToToken(port, charRead);
+                        charRead = fgetc(in);
+                    }
+                    if (first == EOF || namedChar(port->text) < 0) {
+                        handleError(CHAR_TYPE);
+                    }
+                    newNode->i = namedChar(port->text);
+                }
+                else if (charRead == 't'){
                     newNode->i = 1;
-                    charRead = fgetc(stdin);
+                    charRead = fgetc(in);
                 }
                 else if (charRead == 'f'){
                     newNode->i = 0;
-                    charRead = fgetc(stdin);
+                    charRead = fgetc(in);
                 }
                 else {
                     handleError(BOOL_TYPE);
                 }
-
-                canStartNewToken = 0;
             }
 
             // accounts for digit case (float and int)
@@ -111,24 +165,24 @@ Value *tokenize() {
                       charRead == '+' || charRead == '-')) {
 
                 if (charRead == '.') {
-                    addCharToStr(newNode->s, charRead);
+                    addCharToToken(port, charRead);
                     newNode->type = DOUBLE_TYPE;
-                    charRead = fgetc(stdin);
+                    charRead = fgetc(in);
                     if (!isdigit(charRead)) {
                         handleError(INT_TYPE);
                     }
                 }
                 else if (charRead == '+' || charRead == '-') {
-                    addCharToStr(newNode->s, charRead);
-                    charRead = fgetc(stdin);
+                    addCharToToken(port, charRead);
+                    charRead = fgetc(in);
                     //does next if statement work?
                     if (!isdigit(charRead) && charRead != '.') {
                         newNode->type = SYMBOL_TYPE;
                     }
                     else if (charRead == '.') {
                         newNode->type = DOUBLE_TYPE;
-                        addCharToStr(newNode->s, charRead);
-                        charRead = fgetc(stdin);
+                        addCharToToken(port, charRead);
+                        charRead = fgetc(in);
                         if (!isdigit(charRead)) {
                             handleError(INT_TYPE);
                         }
@@ -158,14 +212,23 @@ Value *tokenize() {
                         }
                     }
 
-                    addCharToStr(newNode->s, charRead);
-                    charRead = fgetc(stdin);
+                    addCharToToken(port, charRead);
+                    charRead = fgetc(in);
                 }
                 if (newNode->type == INT_TYPE) {
-                    newNode->i = atoi(newNode->s);
+                    errno = 0;
+                    long n = strtol(port->text, NULL, 10);
+                    if (errno == ERANGE) {
+                        // too big for a fixnum
+                        newNode->type = BIGNUM_TYPE;
+                        newNode->big = parseInteger(port->text)->big;
+                    }
+                    else {
+                        newNode->i = n;
+                    }
                 }
                 else if (newNode->type == DOUBLE_TYPE) {
-                    newNode->d = atof(newNode->s);
+                    newNode->d = atof(port->text);
                 }
 
                 canStartNewToken = 0;
@@ -175,11 +238,11 @@ Value *tokenize() {
             else if (canStartNewToken && (strchr(init, charRead) || 
                                           strchr(lett, charRead))) {
                 newNode->type = SYMBOL_TYPE;
-                addCharToStr(newNode->s, charRead);
-                charRead = fgetc(stdin);
+                addCharToToken(port, charRead);
+                charRead = fgetc(in);
                 while (strchr(subs, charRead)) {
-                    addCharToStr(newNode->s, charRead);
-                    charRead = fgetc(stdin);
+                    addCharToToken(port, charRead);
+                    charRead = fgetc(in);
                 }
                 canStartNewToken = 0;
             }
@@ -188,41 +251,48 @@ Value *tokenize() {
             else if (charRead == '(') {
                 canStartNewToken = 1;
                 newNode->type = OPEN_TYPE;
-                addCharToStr(newNode->s, charRead);
-                charRead = fgetc(stdin);
+                addCharToToken(port, charRead);
+                charRead = fgetc(in);
             }
 
             // accounts for closed paren case
             else if (charRead == ')') {
                 canStartNewToken = 1;
                 newNode->type = CLOSE_TYPE;
-                addCharToStr(newNode->s, charRead);
-                charRead = fgetc(stdin);
+                addCharToToken(port, charRead);
+                charRead = fgetc(in);
             }
             
             // accounts for string case
             else if (charRead == '"') {
                 canStartNewToken = 1;
                 newNode->type = STR_TYPE;
-                addCharToStr(newNode->s, charRead);
-                charRead = fgetc(stdin);
+                addCharToToken(port, charRead);
+                charRead = fgetc(in);
                 while (charRead != '"' && charRead != EOF && charRead != '\n') {
-                    addCharToStr(newNode->s, charRead);
-                    charRead = fgetc(stdin);
+                    addCharToToken(port, charRead);
+                    charRead = fgetc(in);
                 }
                 if (charRead != '"') {
                     handleError(STR_TYPE);
                 }
-                addCharToStr(newNode->s, charRead);
-                charRead = fgetc(stdin);
+                charRead = fgetc(in);
+                // the characters after the opening quote
+                long length = port->length - 1;
+                char *chars = talloc(length);
+                memcpy(chars, port->text + 1, length);
+                newNode->str.chars = chars;
+                newNode->str.length = length;
+                newNode->str.left = NULL;
+                newNode->str.right = NULL;
             }
 
             // accounts for comment case
             else if (charRead == ';'){
                 canStartNewToken = 1;
-                charRead = fgetc(stdin);
+                charRead = fgetc(in);
                 while (charRead != '\n' && charRead != EOF) {
-                    charRead = fgetc(stdin);
+                    charRead = fgetc(in);
                 }
                 // no error to handle here b/c no close syntax for comments
                 // this exits the loop if an EOF is read, you could also ungetc()
@@ -235,17 +305,39 @@ Value *tokenize() {
                 handleError(-1);
             }
 
+            if (newNode->type == SYMBOL_TYPE || newNode->type == OPEN_TYPE ||
+                newNode->type == CLOSE_TYPE || newNode->type == QUOTE_TYPE) {
+                char *text = talloc(port->length + 1);
+                newNode->s = strcpy(text, port->text);
+            }
+            if (newNode->type == SYMBOL_TYPE) {
+                newNode->s = intern(newNode->s);
+            }
             if (newNode->type != NULL_TYPE) {
-                Value *consCell = cons(newNode, list);
-                list = consCell;
+                token = newNode;
             }
         }
     }
 
+    port->next = charRead;
+    port->canStartNewToken = canStartNewToken;
+    return token;
+}
+
+// Read all of the input from stdin, and return a linked list consisting of the
+// tokens.
+Value *tokenize() {
+    Port *port = makePort(stdin);
+    Value *list = makeNull();
+    for (Value *token = readToken(port); token != NULL;
+         token = readToken(port)) {
+        list = cons(token, list);
+    }
     Value *revList = reverse(list);
     return revList;
 }
 
+
 // Displays the contents of the linked list as tokens, with type information
 void displayTokens(Value *list) {
     if (list->type != CONS_TYPE) {
@@ -253,17 +345,25 @@ void displayTokens(Value *list) {
     }
     while (list->type == CONS_TYPE) {
         if (car(list)->type == INT_TYPE) {
-            printf("%i", car(list)->i);
+            printf("%li", car(list)->i);
             printf(":integer\n");
         }
         else if (car(list)->type == DOUBLE_TYPE) {
             printf("%f", car(list)->d);
             printf(":float\n");
         }
+        else if (car(list)->type == BIGNUM_TYPE) {
+            printf("%s", integerToString(car(list)));
+            printf(":integer\n");
+        }
         else if (car(list)->type == STR_TYPE) {
-            printf("%s", car(list)->s);
+            writeText(stdout, car(list));
             printf(":string\n");
         }
+        else if (car(list)->type == CHAR_TYPE) {
+            writeText(stdout, car(list));
+            printf(":character\n");
+        }
         else if (car(list)->type == OPEN_TYPE) {
             printf("%s", car(list)->s);
             printf(":open\n");
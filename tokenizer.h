@@ -1,8 +1,33 @@
+#include <stdio.h>
+#include <setjmp.h>
 #include "value.h"
 
 #ifndef _TOKENIZER
 #define _TOKENIZER
 
+// where tokens are read from: the file, the character after the last token
+// read, not yet part of one, and whether a token can start with it
+typedef struct Port {
+    FILE *file;
+    int next;
+    int canStartNewToken;
+    // where the token being read is built, as a string of length
+    // characters in capacity bytes, which grow as the token does
+    char *text;
+    long length;
+    long capacity;
+} Port;
+
+// Where a syntax error goes instead of being reported and exiting, when it
+// is not NULL.
+extern jmp_buf *syntaxErrorJump;
+
+// Returns a new port reading tokens from file.
+Port *makePort(FILE *file);
+
+// Reads the next token from port, or returns NULL at the end of the file.
+Value *readToken(Port *port);
+
 // Read all of the input from stdin, and return a linked list consisting of the
 // tokens.
 Value *tokenize();
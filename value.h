@@ -1,12 +1,14 @@
 #ifndef _VALUE
 #define _VALUE
 
-typedef enum {INT_TYPE,DOUBLE_TYPE,STR_TYPE,CONS_TYPE,NULL_TYPE,PTR_TYPE,OPEN_TYPE,CLOSE_TYPE,BOOL_TYPE,SYMBOL_TYPE,VOID_TYPE,CLOSURE_TYPE,PRIMITIVE_TYPE,QUOTE_TYPE} valueType;
+typedef enum {INT_TYPE,DOUBLE_TYPE,STR_TYPE,CONS_TYPE,NULL_TYPE,PTR_TYPE,OPEN_TYPE,CLOSE_TYPE,BOOL_TYPE,SYMBOL_TYPE,VOID_TYPE,CLOSURE_TYPE,PRIMITIVE_TYPE,QUOTE_TYPE,BOX_TYPE,ERROR_TYPE,CONTINUATION_TYPE,BIGNUM_TYPE,VECTOR_TYPE,HASH_TABLE_TYPE,CHAR_TYPE,F64VECTOR_TYPE,S64VECTOR_TYPE,BYTEVECTOR_TYPE,PROMISE_TYPE,PORT_TYPE,EOF_TYPE} valueType;
 
 struct Value {
     valueType type;
     union {
-        int i;
+        // INT_TYPE values are 64-bit fixnums; CHAR_TYPE values keep their
+        // character code here too
+        long i;
         double d;
         char *s;
         void *p;
@@ -14,12 +16,75 @@ struct Value {
             struct Value *car;
             struct Value *cdr;
         } c;
+        // a box holds the value of a variable that closures capture and
+        // assign, so that they all share it
+        struct Value *box;
+        // the frame of a closure is the global one; the values of the free
+        // variables of its lambda are in freeVars
         struct Closure {
-            struct Value *paramNames;
-            struct Value *functionCode;
+            struct Node *lambda;
             struct Frame *frame;
+            struct Value **freeVars;
+            struct Code *code;
+            struct Value *(*compiled)(struct Value *closure, int argc,
+                                      struct Value **argv);
         } cl;
-        struct Value *(*pf)(struct Value *);
+        struct Value *(*pf)(int argc, struct Value **argv);
+        // an integer too big for a fixnum: its magnitude is length base 2^32
+        // digits, least significant first, and sign is -1 or 1
+        struct Bignum {
+            int sign;
+            int length;
+            unsigned int *digits;
+        } big;
+        // a vector keeps its elements in one array, so that indexing them
+        // takes constant time
+        struct Vector {
+            int length;
+            struct Value **items;
+        } vec;
+        struct HashTable *table;
+        // an input port, which read takes data from one at a time
+        struct Port *port;
+        // an f64vector keeps its elements unboxed in f64, an s64vector in
+        // s64
+        struct NumVector {
+            long length;
+            double *f64;
+            long *s64;
+        } nv;
+        // a bytevector, of length bytes; one read from a large file has them
+        // mapped from the file
+        struct Bytevector {
+            long length;
+            unsigned char *bytes;
+        } bv;
+        // a promise: once done, value is its result; until then, value is
+        // the procedure that computes it, to be called on the list args,
+        // and if lazy is set, what that returns is another promise whose
+        // result is this one's. The promises of a chain of delay-force come
+        // to share one state.
+        struct Promise {
+            int done;
+            int lazy;
+            struct Value *value;
+            struct Value *args;
+        } *promise;
+        // a string, of length characters at chars, or for a rope not yet
+        // flattened, the strings left and right joined
+        struct String {
+            char *chars;
+            long length;
+            struct Value *left;
+            struct Value *right;
+        } str;
+        // an error object; code is the number of an error of the
+        // interpreter's own, or 0 for one raised by error
+        struct ErrorObject {
+            int code;
+            struct Value *message;
+            struct Value *irritants;
+        } err;
     };
 };
 
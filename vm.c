@@ -0,0 +1,435 @@
+// The bytecode virtual machine. Compiled procedures call each other without
+// recursing in C: arguments and locals live on one value stack, and a call
+// only pushes a CallFrame recording where the caller resumes.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vm.h"
+#include "jit.h"
+#include "talloc.h"
+#include "linkedlist.h"
+
+// values on the value stack for each suspended call the VM has room for
+#define VALUES_PER_CALL 8
+
+// A call suspended while its callee runs.
+typedef struct CallFrame {
+    Code *code;
+    int *pc;
+    Value **fp;
+    Value **freeVars;
+} CallFrame;
+
+Value **vmStack = NULL;
+Value **vmSp;
+Value **vmStackEnd;
+CallFrame *vmFrames;
+CallFrame *vmFsp;
+CallFrame *vmFramesEnd;
+
+// the global frame, where compiled code looks up global variables
+Frame *vmGlobal;
+
+// allocates stacks deep enough for maxDepth calls; malloc maps memory that
+// big lazily, so the pages are only committed as the stacks grow into them
+void initStacks() {
+    size_t size = (size_t)maxDepth * VALUES_PER_CALL;
+    vmStack = malloc(size * sizeof(Value *));
+    vmFrames = malloc((size_t)maxDepth * sizeof(CallFrame));
+    if (vmStack == NULL || vmFrames == NULL) {
+        handleInterpError(184);
+    }
+    vmSp = vmStack;
+    vmStackEnd = vmStack + size;
+    vmFsp = vmFrames;
+    vmFramesEnd = vmFrames + maxDepth;
+}
+
+// returns how much of the stacks is in use; nothing is if they have not been
+// allocated yet
+VmMark vmMark() {
+    VmMark mark = {vmStack == NULL ? NULL : vmSp, vmFsp};
+    return mark;
+}
+
+void vmUnwind(VmMark mark) {
+    if (mark.sp == NULL) {
+        vmSp = vmStack;
+        vmFsp = vmFrames;
+        return;
+    }
+    vmSp = mark.sp;
+    vmFsp = mark.fsp;
+}
+
+// sets up the frame of code, whose argc arguments are at fp
+void enterCode(Code *code, int argc, Value **fp) {
+    if (argc != code->paramCount) {
+        handleInterpError(code->paramCount ? 5 : 6);
+    }
+    if (fp + code->frameSize + code->maxStack > vmStackEnd) {
+        handleInterpError(184);
+    }
+    for (int i = argc; i < code->frameSize; i++) {
+        fp[i] = NULL;
+    }
+}
+
+// returns a closure of compiled lambda code, capturing the variables that
+// the operands at pc name from the frame at fp and the free variables of the
+// running closure
+Value *makeVmClosure(Code *code, int *pc, Value **fp, Value **freeVars) {
+    Value *value = makeNull();
+    value->type = CLOSURE_TYPE;
+    value->cl.lambda = code->lambda;
+    value->cl.frame = vmGlobal;
+    value->cl.freeVars = talloc(code->lambda->lambda.freeCount *
+                                sizeof(Value *));
+    for (int i = 0; i < code->lambda->lambda.freeCount; i++) {
+        value->cl.freeVars[i] = pc[i] >= 0 ? fp[pc[i]] : freeVars[-1 - pc[i]];
+    }
+    value->cl.code = code;
+    value->cl.compiled = NULL;
+    return value;
+}
+
+// computes op on two fixnums as fixnumOp does, or returns NULL for a sum,
+// difference or product that overflows, for fixnumOp to make a bignum of
+Value *fixnumInPlace(arithOp op, long a, long b) {
+    long result;
+    switch (op) {
+     case ADD_OP: {
+        if (__builtin_add_overflow(a, b, &result)) {
+            return NULL;
+        }
+        return intResult(result);
+     }
+     case SUB_OP: {
+        if (__builtin_sub_overflow(a, b, &result)) {
+            return NULL;
+        }
+        return intResult(result);
+     }
+     case MULT_OP: {
+        if (__builtin_mul_overflow(a, b, &result)) {
+            return NULL;
+        }
+        return intResult(result);
+     }
+     case LESS_OP: {
+        return boolResult(a < b);
+     }
+     case GREATER_OP: {
+        return boolResult(a > b);
+     }
+     case LESS_EQ_OP: {
+        return boolResult(a <= b);
+     }
+     case GR_EQ_OP: {
+        return boolResult(a >= b);
+     }
+     default: {
+        return boolResult(a == b);
+     }
+    }
+}
+
+// runs code, already entered with its frame at fp, until it returns;
+// freeVars are the captured variables of the closure it belongs to
+Value *run(Code *code, Value **fp, Value **freeVars) {
+    // in the order of the opcode enum
+    static void *dispatch[] = {
+        &&op_const, &&op_local, &&op_set_local, &&op_boxed_local,
+        &&op_set_boxed_local, &&op_free, &&op_boxed_free, &&op_set_boxed_free,
+        &&op_box, &&op_global, &&op_set_global, &&op_define_global, &&op_pop,
+        &&op_jump, &&op_jump_if_false, &&op_and, &&op_or, &&op_closure,
+        &&op_call, &&op_tail_call, &&op_binary_call, &&op_return, &&op_error
+    };
+    // primitives such as force and call/ec call back into run through
+    // vmApply, so each entry needs the C stack check that evalNode makes
+    checkStack();
+    CallFrame *base = vmFsp;
+    int *pc = code->ops;
+    Value **consts = code->consts;
+    Value **sp = fp + code->frameSize;
+    Value *function;
+    Value *result;
+    int argc;
+
+#define NEXT goto *dispatch[*pc++]
+#define IS_FALSE(value) ((value)->type == BOOL_TYPE && !(value)->i)
+
+    NEXT;
+
+ op_const:
+    *sp++ = consts[*pc++];
+    NEXT;
+
+ op_local:
+    result = fp[pc[0]];
+    if (result == NULL) {
+        handleUnbound(consts[pc[1]]);
+    }
+    *sp++ = result;
+    pc += 2;
+    NEXT;
+
+ op_set_local:
+    fp[*pc++] = *--sp;
+    NEXT;
+
+ op_boxed_local:
+    result = fp[pc[0]]->box;
+    if (result == NULL) {
+        handleUnbound(consts[pc[1]]);
+    }
+    *sp++ = result;
+    pc += 2;
+    NEXT;
+
+ op_set_boxed_local:
+    fp[*pc++]->box = *--sp;
+    NEXT;
+
+ op_free:
+    *sp++ = freeVars[pc[0]];
+    pc += 2;
+    NEXT;
+
+ op_boxed_free:
+    result = freeVars[pc[0]]->box;
+    if (result == NULL) {
+        handleUnbound(consts[pc[1]]);
+    }
+    *sp++ = result;
+    pc += 2;
+    NEXT;
+
+ op_set_boxed_free:
+    freeVars[*pc++]->box = *--sp;
+    NEXT;
+
+ op_box:
+    fp[*pc] = makeBox(fp[*pc]);
+    pc++;
+    NEXT;
+
+ op_global: {
+    Node *var = code->globals[*pc++];
+    if (var->var.binding == NULL && resolveGlobal(var, vmGlobal) == NULL) {
+        handleUnbound(var->var.symbol);
+    }
+    *sp++ = var->var.binding->c.cdr;
+    NEXT;
+ }
+
+ op_set_global: {
+    Node *var = code->globals[*pc++];
+    if (var->var.binding == NULL && resolveGlobal(var, vmGlobal) == NULL) {
+        handleInterpError(172);
+    }
+    var->var.binding->c.cdr = *--sp;
+    NEXT;
+ }
+
+ op_define_global:
+    defineGlobal(code->globals[*pc++], *--sp, vmGlobal);
+    NEXT;
+
+ op_pop:
+    sp--;
+    NEXT;
+
+ op_jump:
+    pc = code->ops + *pc;
+    NEXT;
+
+ op_jump_if_false:
+    result = *--sp;
+    if (IS_FALSE(result)) {
+        pc = code->ops + *pc;
+    }
+    else {
+        pc++;
+    }
+    NEXT;
+
+ op_and:
+    if (IS_FALSE(sp[-1])) {
+        pc = code->ops + *pc;
+    }
+    else {
+        sp--;
+        pc++;
+    }
+    NEXT;
+
+ op_or:
+    if (!IS_FALSE(sp[-1])) {
+        pc = code->ops + *pc;
+    }
+    else {
+        sp--;
+        pc++;
+    }
+    NEXT;
+
+ op_closure: {
+    Code *lambda = code->lambdas[*pc++];
+    *sp++ = makeVmClosure(lambda, pc, fp, freeVars);
+    pc += lambda->lambda->lambda.freeCount;
+    NEXT;
+ }
+
+ op_call:
+    argc = *pc++;
+ call:
+    function = sp[-argc - 1];
+    if (function->type != CLOSURE_TYPE || function->cl.code == NULL) {
+        // primitives and closures of the tree walker run in C
+        vmSp = sp;
+        result = apply(function, argc, sp - argc);
+        sp -= argc + 1;
+        *sp++ = result;
+        NEXT;
+    }
+    if (vmFsp == vmFramesEnd) {
+        handleInterpError(184);
+    }
+    vmFsp->code = code;
+    vmFsp->pc = pc;
+    vmFsp->fp = fp;
+    vmFsp->freeVars = freeVars;
+    vmFsp++;
+    fp = sp - argc;
+    goto enter;
+
+ op_tail_call:
+    argc = *pc++;
+ tail_call:
+    function = sp[-argc - 1];
+    if (function->type != CLOSURE_TYPE || function->cl.code == NULL) {
+        vmSp = sp;
+        result = apply(function, argc, sp - argc);
+        sp -= argc + 1;
+        *sp++ = result;
+        goto op_return;
+    }
+    // slide the callee and its arguments down over the current frame
+    memmove(fp - 1, sp - argc - 1, (argc + 1) * sizeof(Value *));
+    goto enter;
+
+ op_binary_call: {
+    // the same type feedback as the tree walker's: a call node specialized
+    // to a primitive computes it here while the operands suit it, without
+    // the call or, for booleans and small fixnums, any allocation
+    Node *node = code->calls[pc[0]];
+    function = sp[-3];
+    if (node->kind != CALL_NODE) {
+        if (function == node->call.primitive) {
+            result = NULL;
+            if (sp[-2]->type == INT_TYPE && sp[-1]->type == INT_TYPE) {
+                result = fixnumInPlace(node->call.op, sp[-2]->i, sp[-1]->i);
+            }
+            if (result == NULL) {
+                result = specializedOp(node, sp[-2], sp[-1]);
+            }
+            if (result != NULL) {
+                sp -= 3;
+                *sp++ = result;
+                pc += 2;
+                NEXT;
+            }
+        }
+        deoptimizeCall(node);
+    }
+    else {
+        profileCall(node, function, 2, sp - 2);
+    }
+    argc = 2;
+    pc += 2;
+    if (pc[-1]) {
+        goto tail_call;
+    }
+    goto call;
+ }
+
+ enter:
+    // function is at fp[-1], followed by its argc arguments
+    code = function->cl.code;
+    result = jitCall(code->lambda, argc, fp);
+    if (result != NULL) {
+        fp[-1] = result;
+        sp = fp;
+        goto op_return;
+    }
+    enterCode(code, argc, fp);
+    freeVars = function->cl.freeVars;
+    sp = fp + code->frameSize;
+    pc = code->ops;
+    consts = code->consts;
+    NEXT;
+
+ op_return:
+    result = sp[-1];
+    sp = fp - 1;
+    if (vmFsp == base) {
+        vmSp = sp;
+        return result;
+    }
+    vmFsp--;
+    code = vmFsp->code;
+    pc = vmFsp->pc;
+    fp = vmFsp->fp;
+    freeVars = vmFsp->freeVars;
+    consts = code->consts;
+    *sp++ = result;
+    NEXT;
+
+ op_error:
+    handleInterpError(*pc);
+    return NULL;
+
+#undef NEXT
+#undef IS_FALSE
+}
+
+// Runs compiled top-level code in the global frame and returns its value.
+Value *runCode(Code *code, Frame *global) {
+    if (vmStack == NULL) {
+        initStacks();
+    }
+    // top-level code has no procedure below its frame
+    vmGlobal = global;
+    Value **fp = vmSp + 1;
+    enterCode(code, 0, fp);
+    return run(code, fp, NULL);
+}
+
+// Calls a closure created by the VM on the argc arguments in argv.
+Value *vmApply(Value *function, int argc, Value **argv) {
+    if (vmStack == NULL) {
+        initStacks();
+    }
+    Value **fp = vmSp + 1;
+    if (fp + argc > vmStackEnd) {
+        handleInterpError(184);
+    }
+    fp[-1] = function;
+    memmove(fp, argv, argc * sizeof(Value *));
+    Code *code = function->cl.code;
+    Value *result = jitCall(code->lambda, argc, fp);
+    if (result != NULL) {
+        vmSp = fp - 1;
+        return result;
+    }
+    vmGlobal = function->cl.frame;
+    enterCode(code, argc, fp);
+    return run(code, fp, function->cl.freeVars);
+}
+
+// Analyzes, compiles and runs a top-level expression in the global frame.
+Value *vmEval(Value *expr, Frame *global) {
+    return runCode(compile(analyze(expr)), global);
+}
@@ -0,0 +1,83 @@
+#include "value.h"
+#include "analyzer.h"
+#include "interpreter.h"
+
+#ifndef _VM
+#define _VM
+
+// Instructions of the bytecode virtual machine. Operands follow the opcode in
+// the instruction stream; jump targets are offsets into it.
+typedef enum {
+    OP_CONST,           // k: push constant k
+    OP_LOCAL,           // i, k: push stack slot i of the frame, constant k
+                        //       being its name for unbound errors
+    OP_SET_LOCAL,       // i: pop into stack slot i
+    OP_BOXED_LOCAL,     // i, k: push the value in the box in stack slot i
+    OP_SET_BOXED_LOCAL, // i: pop into the box in stack slot i
+    OP_FREE,            // i, k: push free variable i of the running closure
+    OP_BOXED_FREE,      // i, k: push the value in the box in free variable i
+    OP_SET_BOXED_FREE,  // i: pop into the box in free variable i
+    OP_BOX,             // i: put the value in stack slot i in a new box
+    OP_GLOBAL,          // g: push the value of global g
+    OP_SET_GLOBAL,      // g: pop into global g
+    OP_DEFINE_GLOBAL,   // g: pop into global g, binding it if needed
+    OP_POP,
+    OP_JUMP,            // t
+    OP_JUMP_IF_FALSE,   // t: pop, and jump if the value was #f
+    OP_AND,             // t: jump if the top is #f, otherwise pop it
+    OP_OR,              // t: jump if the top is not #f, otherwise pop it
+    OP_CLOSURE,         // c, ...: push a closure of lambda c, followed by one
+                        //         operand per variable it captures: a
+                        //         stack slot i as i, free variable i as -1-i
+    OP_CALL,            // n: call the procedure below the top n values
+    OP_TAIL_CALL,       // n: the same, replacing the current frame
+    OP_BINARY_CALL,     // c, t: a call of two arguments, a tail call if t is
+                        //       set, by call node c, whose type feedback
+                        //       lets it compute an arithmetic primitive in
+                        //       place
+    OP_RETURN,
+    OP_ERROR            // e: report error e
+} opcode;
+
+typedef struct Code Code;
+
+// The compiled form of a lambda, or of a top-level expression. The slots of a
+// frame are its parameters followed by every let and internal define in the
+// body, so lets need no frames of their own. They are kept on the VM stack;
+// closures copy the values of the variables they capture, or share a box
+// with the frame if the variable is assigned.
+struct Code {
+    int *ops;
+    int length;
+    Value **consts;
+    Node **globals;
+    Code **lambdas;
+    Node **calls;
+    Node *lambda;
+    int paramCount;
+    int frameSize;
+    int maxStack;
+};
+
+// How much of the VM's stacks is in use, for an error to unwind them to.
+typedef struct VmMark {
+    Value **sp;
+    struct CallFrame *fsp;
+} VmMark;
+
+VmMark vmMark();
+void vmUnwind(VmMark mark);
+
+// Compiles an analyzed top-level expression into bytecode.
+Code *compile(Node *node);
+
+// Runs compiled top-level code in the global frame and returns its value.
+Value *runCode(Code *code, Frame *global);
+
+// Calls a closure created by the VM on the argc arguments in argv.
+Value *vmApply(Value *function, int argc, Value **argv);
+
+// Analyzes, compiles and runs a top-level expression in the global frame.
+Value *vmEval(Value *expr, Frame *global);
+
+#endif